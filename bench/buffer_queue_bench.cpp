@@ -0,0 +1,150 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// SPSC throughput of BufferQueue against the original modulo ring it replaced.
+// One producer thread, one consumer thread, pointer sized items, both sides spin.
+// Usage: buffer_queue_bench [items]
+
+#include <buffer_queue.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// The ring as it was: template capacity, '%' wrap, head and tail side by side.
+template <typename T, size_t Capacity>
+class LegacyBufferQueue {
+public:
+    LegacyBufferQueue() : m_head(0), m_tail(0) { m_buffer.resize(Capacity); }
+
+    bool push(T&& item) {
+        auto currentTail = m_tail.load(std::memory_order_relaxed);
+        auto nextTail = (currentTail + 1) % Capacity;
+        if (nextTail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        m_buffer[currentTail] = std::move(item);
+        m_tail.store(nextTail, std::memory_order_release);
+        return true;
+    }
+
+    std::optional<T> pop() {
+        auto currentHead = m_head.load(std::memory_order_relaxed);
+        if (currentHead == m_tail.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        T item = std::move(m_buffer[currentHead]);
+        m_head.store((currentHead + 1) % Capacity, std::memory_order_release);
+        return item;
+    }
+
+private:
+    std::vector<T> m_buffer;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+};
+
+struct Item {
+    void*   ptr = nullptr;
+    int64_t pts = 0;
+};
+
+template <typename Fn>
+double timeIt(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const char* name, size_t items, double secs, int64_t checksum) {
+    std::printf("%-28s %8.2f Mitems/s  (%.3f s, checksum %lld)\n",
+                name, items / secs / 1e6, secs, static_cast<long long>(checksum));
+}
+
+template <typename Queue>
+void benchSingle(const char* name, Queue& q, size_t items) {
+    int64_t sum = 0;
+    double secs = timeIt([&] {
+        std::thread consumer([&] {
+            for (size_t got = 0; got < items;) {
+                if (auto v = q.pop()) {
+                    sum += v->pts;
+                    ++got;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        for (size_t i = 0; i < items; ++i) {
+            Item it{nullptr, static_cast<int64_t>(i)};
+            while (!q.push(std::move(it))) {
+                std::this_thread::yield();
+            }
+        }
+        consumer.join();
+    });
+    report(name, items, secs, sum);
+}
+
+void benchBatch(const char* name, BufferQueue<Item>& q, size_t items, size_t batch) {
+    int64_t sum = 0;
+    double secs = timeIt([&] {
+        std::thread consumer([&] {
+            std::vector<Item> out(batch);
+            for (size_t got = 0; got < items;) {
+                size_t n = q.popBatch(out.data(), batch);
+                if (n == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (size_t i = 0; i < n; ++i) sum += out[i].pts;
+                got += n;
+            }
+        });
+        std::vector<Item> in(batch);
+        for (size_t i = 0; i < items;) {
+            size_t want = std::min(batch, items - i);
+            for (size_t k = 0; k < want; ++k) in[k] = Item{nullptr, static_cast<int64_t>(i + k)};
+            size_t off = 0;
+            while (off < want) {
+                size_t n = q.pushBatch(in.data() + off, want - off);
+                if (n == 0) std::this_thread::yield();
+                off += n;
+            }
+            i += want;
+        }
+        consumer.join();
+    });
+    report(name, items, secs, sum);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t items = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+    std::printf("SPSC, %zu items, capacity 128, %u hw threads\n", items, std::thread::hardware_concurrency());
+
+    {
+        LegacyBufferQueue<Item, 128> q;
+        benchSingle("legacy push/pop", q, items);
+    }
+    {
+        BufferQueue<Item> q(128);
+        benchSingle("BufferQueue push/pop", q, items);
+    }
+    {
+        BufferQueue<Item> q(128);
+        benchBatch("BufferQueue batch x8", q, items, 8);
+    }
+    {
+        BufferQueue<Item> q(128);
+        benchBatch("BufferQueue batch x32", q, items, 32);
+    }
+    return 0;
+}
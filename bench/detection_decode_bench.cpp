@@ -0,0 +1,179 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// AIDetector's output decoding on synthetic 640x640 YOLOv8 ([84, 8400]) and
+// YOLOv5 ([25200, 85]) tensors: a straightforward per-anchor loop + greedy NMS
+// against DetectionDecoder (dispatched argmax/filter, grouped per-class NMS).
+// Also checks both keep the same number of boxes.
+// Usage: detection_decode_bench [iterations]
+
+#include <detection_decoder.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int kClasses = 80;
+constexpr int kInput   = 640;
+constexpr int kObjects = 30;  // real objects in the scene
+constexpr int kHits    = 25;  // anchors firing on each of them
+
+float iou(const DetectionBox& a, const DetectionBox& b) {
+    const float x1 = std::max(a.x, b.x), y1 = std::max(a.y, b.y);
+    const float x2 = std::min(a.x + a.width, b.x + b.width), y2 = std::min(a.y + a.height, b.y + b.height);
+    const float inter = std::max(0.f, x2 - x1) * std::max(0.f, y2 - y1);
+    return inter / (a.width * a.height + b.width * b.height - inter);
+}
+
+// Greedy NMS over all boxes, checking the class per pair
+void naiveNms(std::vector<DetectionBox>& boxes, float thr) {
+    std::sort(boxes.begin(), boxes.end(), [](const DetectionBox& a, const DetectionBox& b) {
+        return a.confidence > b.confidence;
+    });
+    std::vector<DetectionBox> kept;
+    std::vector<bool> dead(boxes.size(), false);
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (dead[i]) continue;
+        kept.push_back(boxes[i]);
+        for (size_t j = i + 1; j < boxes.size(); ++j) {
+            if (boxes[j].classId == boxes[i].classId && iou(boxes[i], boxes[j]) > thr) dead[j] = true;
+        }
+    }
+    boxes.swap(kept);
+}
+
+// One anchor at a time, walking the class rows with an 8400-float stride
+void naiveYoloV8(const float* data, int anchors, float conf, std::vector<DetectionBox>& out) {
+    out.clear();
+    for (int a = 0; a < anchors; ++a) {
+        int best = 0;
+        float bestScore = data[4 * anchors + a];
+        for (int c = 1; c < kClasses; ++c) {
+            const float s = data[(4 + c) * anchors + a];
+            if (s > bestScore) { bestScore = s; best = c; }
+        }
+        if (bestScore < conf) continue;
+        const float w = data[2 * anchors + a], h = data[3 * anchors + a];
+        out.push_back({data[a] - w / 2, data[anchors + a] - h / 2, w, h, bestScore, best});
+    }
+    naiveNms(out, 0.45f);
+}
+
+void naiveYoloV5(const float* data, int rows, int cols, float conf, std::vector<DetectionBox>& out) {
+    out.clear();
+    for (int r = 0; r < rows; ++r) {
+        const float* row = data + static_cast<size_t>(r) * cols;
+        int best = 0;
+        float bestScore = row[5];
+        for (int c = 1; c < kClasses; ++c) {
+            if (row[5 + c] > bestScore) { bestScore = row[5 + c]; best = c; }
+        }
+        const float score = row[4] * bestScore;
+        if (score < conf) continue;
+        out.push_back({row[0] - row[2] / 2, row[1] - row[3] / 2, row[2], row[3], score, best});
+    }
+    naiveNms(out, 0.45f);
+}
+
+struct Object { float cx, cy, w, h; int cls; };
+
+std::vector<Object> makeScene(std::mt19937& rng) {
+    std::uniform_real_distribution<float> pos(40.f, 600.f), size(20.f, 160.f);
+    std::uniform_int_distribution<int> cls(0, kClasses - 1);
+    std::vector<Object> objects;
+    for (int i = 0; i < kObjects; ++i) objects.push_back({pos(rng), pos(rng), size(rng), size(rng), cls(rng)});
+    return objects;
+}
+
+// [4 + C, anchors], background scores well under the threshold
+std::vector<float> makeYoloV8(std::mt19937& rng, const std::vector<Object>& objects, int anchors) {
+    std::uniform_real_distribution<float> noise(0.f, 0.02f), jitter(-4.f, 4.f), strong(0.4f, 0.95f), coord(0.f, kInput);
+    std::uniform_int_distribution<int> anchor(0, anchors - 1);
+    std::vector<float> t(static_cast<size_t>(4 + kClasses) * anchors);
+    for (int a = 0; a < anchors; ++a) {
+        t[a] = coord(rng); t[anchors + a] = coord(rng); t[2 * anchors + a] = 32.f; t[3 * anchors + a] = 32.f;
+    }
+    for (size_t i = static_cast<size_t>(4) * anchors; i < t.size(); ++i) t[i] = noise(rng);
+    for (const auto& o : objects) {
+        for (int k = 0; k < kHits; ++k) {
+            const int a = anchor(rng);
+            t[a] = o.cx + jitter(rng); t[anchors + a] = o.cy + jitter(rng);
+            t[2 * anchors + a] = o.w + jitter(rng); t[3 * anchors + a] = o.h + jitter(rng);
+            t[static_cast<size_t>(4 + o.cls) * anchors + a] = strong(rng);
+        }
+    }
+    return t;
+}
+
+// [rows, 5 + C]
+std::vector<float> makeYoloV5(std::mt19937& rng, const std::vector<Object>& objects, int rows) {
+    const int cols = 5 + kClasses;
+    std::uniform_real_distribution<float> noise(0.f, 0.02f), jitter(-4.f, 4.f), strong(0.6f, 0.98f), coord(0.f, kInput);
+    std::uniform_int_distribution<int> pick(0, rows - 1);
+    std::vector<float> t(static_cast<size_t>(rows) * cols);
+    for (int r = 0; r < rows; ++r) {
+        float* row = &t[static_cast<size_t>(r) * cols];
+        row[0] = coord(rng); row[1] = coord(rng); row[2] = 32.f; row[3] = 32.f;
+        for (int c = 4; c < cols; ++c) row[c] = noise(rng);
+    }
+    for (const auto& o : objects) {
+        for (int k = 0; k < kHits; ++k) {
+            float* row = &t[static_cast<size_t>(pick(rng)) * cols];
+            row[0] = o.cx + jitter(rng); row[1] = o.cy + jitter(rng);
+            row[2] = o.w + jitter(rng); row[3] = o.h + jitter(rng);
+            row[4] = strong(rng); row[5 + o.cls] = strong(rng);
+        }
+    }
+    return t;
+}
+
+template <typename Fn>
+double usPerCall(int iterations, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) fn();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int iterations = (argc > 1) ? std::atoi(argv[1]) : 200;
+    std::mt19937 rng(7);
+    const auto scene = makeScene(rng);
+
+    std::printf("decoder kernel: %s, %d iterations, %d objects x %d anchors each\n",
+                DetectionDecoder::kernelName(), iterations, kObjects, kHits);
+    std::printf("%-8s %12s %12s %9s %12s\n", "layout", "naive us", "decoder us", "speedup", "boxes");
+
+    std::vector<DetectionBox> naiveOut, out;
+    {
+        const int anchors = 8400;
+        const auto t = makeYoloV8(rng, scene, anchors);
+        DecoderOptions opt;
+        opt.layout = DetectionLayout::YoloV8;
+        DetectionDecoder decoder(opt);
+        const double naive = usPerCall(iterations, [&] { naiveYoloV8(t.data(), anchors, opt.confThreshold, naiveOut); });
+        const double fast  = usPerCall(iterations, [&] {
+            decoder.decode(t.data(), 4 + kClasses, anchors, 0, kInput, kInput, kInput, kInput, out);
+        });
+        std::printf("%-8s %12.1f %12.1f %8.1fx %6zu/%-5zu\n", "yolov8", naive, fast, naive / fast, out.size(), naiveOut.size());
+    }
+    {
+        const int rows = 25200, cols = 5 + kClasses;
+        const auto t = makeYoloV5(rng, scene, rows);
+        DecoderOptions opt;
+        opt.layout = DetectionLayout::YoloV5;
+        DetectionDecoder decoder(opt);
+        const double naive = usPerCall(iterations, [&] { naiveYoloV5(t.data(), rows, cols, opt.confThreshold, naiveOut); });
+        const double fast  = usPerCall(iterations, [&] {
+            decoder.decode(t.data(), rows, cols, 0, kInput, kInput, kInput, kInput, out);
+        });
+        std::printf("%-8s %12.1f %12.1f %8.1fx %6zu/%-5zu\n", "yolov5", naive, fast, naive / fast, out.size(), naiveOut.size());
+    }
+    return 0;
+}
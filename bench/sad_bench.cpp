@@ -0,0 +1,87 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// MotionDetector's luma difference: the original per-pixel double loop against
+// sumAbsDiff() (dispatched SIMD) and the scalar fallback, at 720p/1080p/4K.
+// Also checks the averages come out bit-identical.
+// Usage: sad_bench [iterations]
+
+#include <sad_kernel.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+// The loop as it was in MotionDetector::detectionLoop()
+double legacyAvgDiff(const uint8_t* currData, int strideCur,
+                     const uint8_t* prevData, int stridePrev,
+                     int width, int height) {
+    double sumDiff = 0.0;
+    int totalPixels = width * height;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int idxCur = y * strideCur + x;
+            int idxPrev = y * stridePrev + x;
+            double diff = std::abs((double)currData[idxCur] - (double)prevData[idxPrev]);
+            sumDiff += diff;
+        }
+    }
+    return sumDiff / totalPixels;
+}
+
+template <typename Fn>
+double msPerCall(int iterations, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int iterations = (argc > 1) ? std::atoi(argv[1]) : 50;
+    struct Res { const char* name; int w, h; } sizes[] = {
+        {"720p", 1280, 720}, {"1080p", 1920, 1080}, {"4K", 3840, 2160}
+    };
+
+    std::printf("dispatched kernel: %s, %d iterations\n", sumAbsDiffKernelName(), iterations);
+    std::printf("%-6s %12s %12s %12s %9s %s\n", "size", "legacy ms", "scalar ms", "simd ms", "speedup", "identical");
+
+    std::mt19937 rng(42);
+    for (const auto& r : sizes) {
+        // Decoder-like strides: padded past the visible width
+        const int stride = (r.w + 63) & ~63;
+        std::vector<uint8_t> cur(static_cast<size_t>(stride) * r.h), prev(cur.size());
+        for (auto& v : cur) v = static_cast<uint8_t>(rng());
+        for (size_t i = 0; i < prev.size(); ++i) prev[i] = static_cast<uint8_t>(cur[i] + (rng() % 16) - 8);
+
+        const double total = static_cast<double>(r.w) * r.h;
+        volatile double sink = 0;
+        double legacy = 0, scalar = 0, simd = 0;
+        double legacyMs = msPerCall(iterations, [&] {
+            legacy = legacyAvgDiff(cur.data(), stride, prev.data(), stride, r.w, r.h);
+            sink = legacy;
+        });
+        double scalarMs = msPerCall(iterations, [&] {
+            scalar = sumAbsDiffScalar(cur.data(), stride, prev.data(), stride, r.w, r.h) / total;
+            sink = scalar;
+        });
+        double simdMs = msPerCall(iterations, [&] {
+            simd = sumAbsDiff(cur.data(), stride, prev.data(), stride, r.w, r.h) / total;
+            sink = simd;
+        });
+        (void)sink;
+
+        bool identical = std::memcmp(&legacy, &simd, sizeof(double)) == 0 &&
+                         std::memcmp(&legacy, &scalar, sizeof(double)) == 0;
+        std::printf("%-6s %12.3f %12.3f %12.3f %8.1fx %s\n", r.name, legacyMs, scalarMs, simdMs,
+                    legacyMs / simdMs, identical ? "yes" : "NO");
+    }
+    return 0;
+}
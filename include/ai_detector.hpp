@@ -2,50 +2,158 @@
 
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <mutex>
 #include <string>
-#include <opencv2/opencv.hpp>
-#include <opencv2/dnn.hpp>
+
+#include <memory>
+#include <utility>
 #include <buffer_queue.hpp>
+#include <vector>
 #include <video_capture.hpp>  // for DecodedFrame
+#include <detection.hpp>
+#include <detection_bus.hpp>
+#include <detection_decoder.hpp>
+#include <frame_inference.hpp>
+#include <inference_backend.hpp>
+#include <pipeline_stage.hpp>
 #include "logger.hpp"
 
-// we create a simple struct to hold detection information.
-struct DetectionBox {
-    float x, y, width, height;
-    float confidence;
-    int classId;
+// When to skip the forward pass based on the verdict MotionDetector stamped on the frame.
+struct AIGateOptions {
+    bool motionGated = true;                         // false: infer on every frame
+    std::chrono::milliseconds recheckInterval{2000}; // infer at least this often, even on static scenes
+    std::chrono::milliseconds keepAlive{1000};       // keep inferring this long after motion ends
+    int detectionStride = 1;                         // of the frames that pass, infer every Nth (ObjectTracker covers the rest)
 };
 
-class AIDetector {
+// The gate and the stride with their state. The workers of an ai pool share one,
+// so the stride and recheck interval count the stage's frames, not each worker's.
+class AIGate {
 public:
-    AIDetector(BufferQueue<DecodedFrame, 128>& inQueue,
-               BufferQueue<DecodedFrame, 128>& outQueue,
-               const std::string& modelPath,
-               const std::string& modelConfig,
-               bool useGPU);
+    enum class Verdict { Infer, Static, Strided };
+
+    explicit AIGate(const AIGateOptions& options);
+
+    void reset();
+    // Thread-safe. Infer also counts as an inference for the recheck interval.
+    Verdict decide(const DecodedFrame& df, std::chrono::steady_clock::time_point now);
+
+private:
+    bool passes(const DecodedFrame& df, std::chrono::steady_clock::time_point now); // under m_mutex
+
+    AIGateOptions m_options;
+    std::mutex m_mutex;
+    std::chrono::steady_clock::time_point m_lastMotion;
+    std::chrono::steady_clock::time_point m_lastInference;
+    bool m_inferredOnce = false;
+    uint64_t m_passed = 0; // frames through the gate, for the stride
+};
+
+// How many frames go through the net per forward() call. A batch is closed
+// when it is full or maxWait after its first frame arrived, whichever is first.
+// In a pool ("ai:8x3") every worker batches what it takes off the shared link.
+// With a shared InferenceBatcher these apply to it, across every camera, and
+// the detector hands on what it has without waiting.
+struct AIBatchOptions {
+    int maxBatch = 1;
+    std::chrono::milliseconds maxWait{10};
+};
+
+// Async mode: frames go to the out queue straight away and a pool of workers
+// runs inference on a reference (av_frame_clone, no pixel copy) of the frames
+// the gate lets through. Results only reach the DetectionBus, not the frame.
+// When the workers fall behind, pending jobs are dropped, never the video.
+struct AIAsyncOptions {
+    bool enabled = false;
+    int workers = 1;        // each loads its own copy of the model, unless there is a shared batcher
+    size_t queueDepth = 8;  // frames waiting for a worker
+};
+
+class InferenceBatcher;
+
+class AIDetector : public PipelineStage {
+public:
+    // 'batcher': the model shared by every camera; null loads one of our own per inference thread.
+    // 'sharedGate': one gate for every worker of a pool; null makes our own from 'gate'.
+    AIDetector(QueueInterface<DecodedFrame>& inQueue,
+               QueueInterface<DecodedFrame>& outQueue,
+               const InferenceOptions& inference,
+               const AIGateOptions& gate = AIGateOptions(),
+               const AIBatchOptions& batch = AIBatchOptions(),
+               const DecoderOptions& decode = DecoderOptions(),
+               const AIAsyncOptions& async = AIAsyncOptions(),
+               DetectionBus* bus = nullptr,
+               InferenceBatcher* batcher = nullptr,
+               std::shared_ptr<AIGate> sharedGate = nullptr);
     ~AIDetector();
 
-    void start();
-    void stop();
-    bool isRunning() const { return m_running.load(); }
+    void start() override;
+    void startPolled() override;
+    void stop() override;
+    bool isRunning() const override { return m_running.load(); }
+    size_t poll(size_t budget) override;
+
+    uint64_t framesInferred() const { return m_framesInferred.load(std::memory_order_relaxed); }
+    uint64_t framesSkipped() const { return m_framesSkipped.load(std::memory_order_relaxed); }
+    uint64_t framesStrided() const { return m_framesStrided.load(std::memory_order_relaxed); }
+    uint64_t jobsDropped() const { return m_jobs ? m_jobs->stats().dropped() : 0; }
 
 private:
-    void detectionLoop();
-    bool loadModel(const std::string& modelPath, const std::string& modelConfig);
+    // Everything one inference thread owns; engines and scalers aren't thread-safe
+    struct InferenceContext {
+        std::unique_ptr<FrameInference> inference;   // null with a shared batcher
+        std::vector<DecodedFrame> batch;
+        std::vector<uint8_t> wanted;                 // per batch entry: passed the gate
+        std::vector<const AVFrame*> frames;          // the wanted ones, as handed to the net
+        std::vector<size_t> frameOwner;              // index into the batch for each of 'frames'
+        std::vector<std::vector<DetectionBox>> results;
+
+        ~InferenceContext();
+    };
 
-    // Convert AVFrame (YUV) to OpenCV Mat (BGR)
-    cv::Mat avFrameToMat(AVFrame* frame);
+    void detectionLoop();      // sync: batch, infer, forward
+    void forwardLoop();        // async: gate, hand a reference to the workers, forward
+    void workerLoop(InferenceContext& ctx);
+    void processBatch(InferenceContext& ctx); // gate, infer, forward
+    void dispatch(const DecodedFrame& df);    // async: gate and queue a job for the workers
 
-    // Inference & post-processing
-    std::vector<DetectionBox> runInference(const cv::Mat& bgr);
+    bool shouldInfer(const DecodedFrame& df, std::chrono::steady_clock::time_point now);
+    std::unique_ptr<InferenceContext> makeContext();
+
+    // Pulls up to 'limit' frames (0 = maxBatch) into ctx.batch, the first one blocking.
+    // stampTicket: store the dequeue ticket in seq (input queue only).
+    // wait = false: only what is queued already, for poll().
+    size_t collectBatch(QueueInterface<DecodedFrame>& queue, InferenceContext& ctx, bool stampTicket, bool wait,
+                        size_t limit = 0);
+
+    // Runs the net (ours or the shared one) on the wanted frames of ctx.batch,
+    // stores detections on them and publishes to the bus
+    void inferBatch(InferenceContext& ctx);
+
+    void forward(DecodedFrame& df);
 
 private:
-    BufferQueue<DecodedFrame, 128>& m_inQueue;
-    BufferQueue<DecodedFrame, 128>& m_outQueue;
+    QueueInterface<DecodedFrame>& m_inQueue;
+    QueueInterface<DecodedFrame>& m_outQueue;
 
     std::atomic<bool> m_running{false};
     std::thread m_thread;
 
-    cv::dnn::Net m_net;
-    bool m_useGPU;
+    InferenceOptions m_inference;
+    std::shared_ptr<AIGate> m_gate;
+    AIBatchOptions m_batch;
+    DecoderOptions m_decode;
+    AIAsyncOptions m_async;
+    DetectionBus* m_bus;
+    InferenceBatcher* m_batcher;
+
+    // One per inference thread: [0] is the detection loop's in sync mode
+    std::vector<std::unique_ptr<InferenceContext>> m_contexts;
+    std::vector<std::thread> m_workers;
+    std::unique_ptr<QueueInterface<DecodedFrame>> m_jobs; // async only: frame references for the workers
+
+    std::atomic<uint64_t> m_framesInferred{0};
+    std::atomic<uint64_t> m_framesSkipped{0};
+    std::atomic<uint64_t> m_framesStrided{0};
 };
@@ -4,57 +4,416 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <optional>
+#include <utility>
 
-// @dev_notes: lock ring buffer for concurrency
-template <typename T, size_t Capacity>
-class BufferQueue {
+#include <queue_interface.hpp>
+#include <utilities.hpp>
+
+// @dev_notes: lock ring buffer for concurrency (single producer, single consumer)
+// push()/pop() never block. pushBlocking()/popBlocking() park the calling thread
+// on a futex until the other side makes progress, the timeout expires or
+// shutdown() is called, so idle stages cost no CPU and hand-offs wake in microseconds.
+// enqueue() is the producer entry point that honours the configured OverflowPolicy.
+//
+// m_head/m_tail are free-running counters wrapped with a mask. Each sits on its
+// own cache line next to its owner's cached copy of the other index, so the
+// other side's line is only read when the cached view says full/empty.
+// pushBatch()/popBatch() move several items per index publish.
+template <typename T>
+class BufferQueue final : public QueueInterface<T> {
 public:
-    BufferQueue()
-        : m_head(0)
-        , m_tail(0) 
+    using typename QueueInterface<T>::DropHandler;
+    using typename QueueInterface<T>::KeyPredicate;
+
+    explicit BufferQueue(size_t capacity = kDefaultQueueCapacity)
+        : m_buffer(roundUpPow2(capacity))
+        , m_mask(m_buffer.size() - 1)
     {
-        m_buffer.resize(Capacity);
     }
 
+    BufferQueue(const BufferQueue&) = delete;
+    BufferQueue& operator=(const BufferQueue&) = delete;
+
+    size_t capacity() const override { return m_buffer.size(); }
+
+    // Approximate, only exact when both sides are idle.
+    size_t size() const override {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    // Copies straight into the slot, and only once there is room for it
     bool push(const T& item) {
-        auto currentTail = m_tail.load(std::memory_order_relaxed);
-        auto nextTail = (currentTail + 1) % Capacity;
-        if (nextTail == m_head.load(std::memory_order_acquire)) {
-            // Full
-            return false;
+        return pushImpl(item);
+    }
+
+    bool push(T&& item) override {
+        return pushImpl(std::move(item));
+    }
+
+    // Moves up to 'count' items from 'items' in with one tail publish.
+    // Returns how many went in; the rest are left untouched.
+    size_t pushBatch(T* items, size_t count) {
+        const size_t currentTail = m_tail.load(std::memory_order_relaxed);
+        const size_t n = freeSlots(currentTail, count);
+        if (n == 0) {
+            return 0;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            m_buffer[(currentTail + i) & m_mask] = std::move(items[i]);
+        }
+        m_tail.store(currentTail + n, std::memory_order_release);
+        notify(m_pushSeq, m_popWaiters);
+        return n;
+    }
+
+    std::optional<T> pop() override {
+        return popImpl(nullptr);
+    }
+
+    // Moves up to 'maxCount' items into 'out' with one head publish.
+    size_t popBatch(T* out, size_t maxCount) {
+        const bool evicting = evicts();
+        if (evicting) lockHead();
+        const size_t currentHead = m_head.load(evicting ? std::memory_order_acquire : std::memory_order_relaxed);
+        const size_t n = usedSlots(currentHead, maxCount);
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = std::move(m_buffer[(currentHead + i) & m_mask]);
+        }
+        if (n != 0) {
+            m_head.store(currentHead + n, std::memory_order_release);
+        }
+        if (evicting) unlockHead();
+        if (n != 0) {
+            notify(m_popSeq, m_pushWaiters);
+        }
+        return n;
+    }
+
+    // Must be called before the producer and consumer threads start.
+    // onDrop releases whatever the queue discards (frames, packets); isKey is
+    // required for KeepGop and tells keyframe items apart.
+    void setOverflowPolicy(OverflowPolicy policy, DropHandler onDrop, KeyPredicate isKey = nullptr) override {
+        m_policy = policy;
+        m_onDrop = std::move(onDrop);
+        m_isKey  = std::move(isKey);
+        if (m_policy == OverflowPolicy::KeepGop && !m_isKey) {
+            m_policy = OverflowPolicy::DropOldest;
+        }
+    }
+
+    OverflowPolicy overflowPolicy() const override { return m_policy; }
+
+    bool enqueue(T&& item, std::chrono::milliseconds timeout) override {
+        if (m_policy == OverflowPolicy::Block) {
+            if (!pushBlocking(std::move(item), timeout)) {
+                return false;
+            }
+            m_enqueued.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        if (m_shutdown.load(std::memory_order_acquire)) {
+            drop(item, m_droppedNewest);
+            return true;
+        }
+
+        if (m_policy == OverflowPolicy::KeepGop && m_awaitKey) {
+            // A GOP was cut short, skip until the next one starts
+            if (!m_isKey(item)) {
+                drop(item, m_droppedNewest);
+                return true;
+            }
+            m_awaitKey = false;
         }
-        m_buffer[currentTail] = item;
-        m_tail.store(nextTail, std::memory_order_release);
+
+        while (!push(std::move(item))) {
+            bool evicted = false;
+            if (m_policy == OverflowPolicy::DropOldest) {
+                // If the consumer emptied the ring meanwhile there is room anyway
+                evictOldest(1);
+                evicted = true;
+            } else if (m_policy == OverflowPolicy::KeepGop) {
+                evicted = evictOldestGop();
+                if (!evicted && m_isKey(item)) {
+                    // The ring holds one GOP and a new one starts here, so all of it can go
+                    evicted = evictOldest(capacity());
+                } else if (!evicted) {
+                    // The whole ring is one GOP: cut it here and resync on the next keyframe
+                    m_awaitKey = true;
+                }
+            }
+            if (!evicted) {
+                drop(item, m_droppedNewest);
+                return true;
+            }
+        }
+        m_enqueued.fetch_add(1, std::memory_order_relaxed);
         return true;
     }
 
-    bool push(T&& item) {
-        auto currentTail = m_tail.load(std::memory_order_relaxed);
-        auto nextTail = (currentTail + 1) % Capacity;
-        if (nextTail == m_head.load(std::memory_order_acquire)) {
+    QueueStats stats() const override {
+        QueueStats s;
+        s.enqueued      = m_enqueued.load(std::memory_order_relaxed);
+        s.droppedNewest = m_droppedNewest.load(std::memory_order_relaxed);
+        s.droppedOldest = m_droppedOldest.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    bool pushBlocking(T&& item, std::chrono::milliseconds timeout) override {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            if (m_shutdown.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (push(std::move(item))) {
+                return true;
+            }
+            if (!park(m_popSeq, m_pushWaiters, deadline, [this] { return isFull(); })) {
+                return false;
+            }
+        }
+    }
+
+    // After shutdown() the remaining items are still drained, then nullopt
+    // is returned straight away. Tickets skip over evicted items.
+    std::optional<T> popBlocking(std::chrono::milliseconds timeout, uint64_t* ticket = nullptr) override {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            auto item = popImpl(ticket);
+            if (item.has_value() || m_shutdown.load(std::memory_order_acquire)) {
+                return item;
+            }
+            if (!park(m_pushSeq, m_popWaiters, deadline, [this] { return isEmpty(); })) {
+                return std::nullopt;
+            }
+        }
+    }
+
+    // Waits until at least one item is available, then drains up to 'maxCount'.
+    size_t popBatchBlocking(T* out, size_t maxCount, std::chrono::milliseconds timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            const size_t n = popBatch(out, maxCount);
+            if (n != 0 || m_shutdown.load(std::memory_order_acquire)) {
+                return n;
+            }
+            if (!park(m_pushSeq, m_popWaiters, deadline, [this] { return isEmpty(); })) {
+                return 0;
+            }
+        }
+    }
+
+    void shutdown() override {
+        m_shutdown.store(true, std::memory_order_release);
+        m_pushSeq.fetch_add(1, std::memory_order_seq_cst);
+        m_popSeq.fetch_add(1, std::memory_order_seq_cst);
+        futexWakeAll(m_pushSeq);
+        futexWakeAll(m_popSeq);
+    }
+
+    bool isShutdown() const override { return m_shutdown.load(std::memory_order_acquire); }
+
+private:
+    // Both push() overloads
+    template <typename U>
+    bool pushImpl(U&& item) {
+        const size_t currentTail = m_tail.load(std::memory_order_relaxed);
+        if (freeSlots(currentTail, 1) == 0) {
             // Full
             return false;
         }
-        m_buffer[currentTail] = std::move(item);
-        m_tail.store(nextTail, std::memory_order_release);
+        m_buffer[currentTail & m_mask] = std::forward<U>(item);
+        m_tail.store(currentTail + 1, std::memory_order_release);
+        notify(m_pushSeq, m_popWaiters);
         return true;
     }
 
-    std::optional<T> pop() {
-        auto currentHead = m_head.load(std::memory_order_relaxed);
-        if (currentHead == m_tail.load(std::memory_order_acquire)) {
-            // Empty
-            return std::nullopt;
+    // pop() that also reports the item's absolute position, for popBlocking()'s ticket.
+    std::optional<T> popImpl(uint64_t* ticket) {
+        std::optional<T> item;
+        // The producer may evict from the head under the drop-oldest policies
+        const bool evicting = evicts();
+        if (evicting) lockHead();
+        const size_t currentHead = m_head.load(evicting ? std::memory_order_acquire : std::memory_order_relaxed);
+        if (usedSlots(currentHead, 1) != 0) {
+            item.emplace(std::move(m_buffer[currentHead & m_mask]));
+            m_head.store(currentHead + 1, std::memory_order_release);
+            if (ticket) *ticket = currentHead;
+        }
+        if (evicting) unlockHead();
+        if (item.has_value()) {
+            notify(m_popSeq, m_pushWaiters);
         }
-        T item = std::move(m_buffer[currentHead]);
-        m_head.store((currentHead + 1) % Capacity, std::memory_order_release);
         return item;
     }
 
-private:
+    static size_t roundUpPow2(size_t n) {
+        size_t cap = 2;
+        while (cap < n) cap <<= 1;
+        return cap;
+    }
+
+    // Producer side: how many of 'wanted' slots are free. Only reloads the
+    // consumer's index when the cached copy says there isn't enough room.
+    size_t freeSlots(size_t currentTail, size_t wanted) {
+        size_t available = capacity() - (currentTail - m_cachedHead);
+        if (available < wanted) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            available = capacity() - (currentTail - m_cachedHead);
+        }
+        return available < wanted ? available : wanted;
+    }
+
+    // Consumer side mirror of freeSlots(). An eviction can move the head past
+    // the cached tail, which shows up as a wrapped (huge) count and forces a reload.
+    size_t usedSlots(size_t currentHead, size_t wanted) {
+        size_t available = m_cachedTail - currentHead;
+        if (available < wanted || available > capacity()) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            available = m_cachedTail - currentHead;
+        }
+        return available < wanted ? available : wanted;
+    }
+
+    bool evicts() const {
+        return m_policy == OverflowPolicy::DropOldest || m_policy == OverflowPolicy::KeepGop;
+    }
+
+    void lockHead() {
+        while (m_headLock.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlockHead() { m_headLock.clear(std::memory_order_release); }
+
+    void drop(T& item, std::atomic<uint64_t>& counter) {
+        if (m_onDrop) m_onDrop(item);
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Producer side: take up to 'count' items off the head. Each one is moved out
+    // under the head lock, so it never races with pop() taking the same slot.
+    bool evictOldest(size_t count) {
+        bool evicted = false;
+        while (count-- > 0) {
+            lockHead();
+            const size_t currentHead = m_head.load(std::memory_order_acquire);
+            if (currentHead == m_tail.load(std::memory_order_relaxed)) {
+                unlockHead();
+                break;
+            }
+            T victim = std::move(m_buffer[currentHead & m_mask]);
+            m_head.store(currentHead + 1, std::memory_order_release);
+            unlockHead();
+
+            drop(victim, m_droppedOldest);
+            evicted = true;
+        }
+        return evicted;
+    }
+
+    // Evict everything in front of the second keyframe in the ring, so the
+    // consumer resumes on a clean GOP. Fails if the ring holds a single GOP.
+    bool evictOldestGop() {
+        lockHead();
+        size_t currentHead = m_head.load(std::memory_order_acquire);
+        const size_t currentTail = m_tail.load(std::memory_order_relaxed);
+        size_t keyPos = currentTail;
+        for (size_t i = currentHead + 1; i < currentTail; ++i) {
+            if (m_isKey(m_buffer[i & m_mask])) {
+                keyPos = i;
+                break;
+            }
+        }
+        if (keyPos == currentTail) {
+            unlockHead();
+            return false;
+        }
+        // m_victims keeps its capacity, so this doesn't allocate in steady state
+        for (; currentHead != keyPos; ++currentHead) {
+            m_victims.push_back(std::move(m_buffer[currentHead & m_mask]));
+        }
+        m_head.store(currentHead, std::memory_order_release);
+        unlockHead();
+
+        for (auto& victim : m_victims) {
+            drop(victim, m_droppedOldest);
+        }
+        m_victims.clear();
+        return true;
+    }
+
+    bool isEmpty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    bool isFull() const {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire) >= capacity();
+    }
+
+    // Bump the sequence word and only pay for the syscall if someone sleeps on it.
+    // The fence pairs with the one in park(): either the sleeper sees our index
+    // update before it sleeps, or we see its waiter count and wake it. This runs on
+    // every push/pop, so it takes the light side; park() pays for the heavy one.
+    static void notify(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters) {
+        lightFence();
+        if (waiters.load(std::memory_order_relaxed) != 0) {
+            seq.fetch_add(1, std::memory_order_release);
+            futexWakeAll(seq);
+        }
+    }
+
+    // Sleeps on 'seq' while 'blocked' holds. Returns false once the deadline passed.
+    template <typename Pred>
+    bool park(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters,
+              std::chrono::steady_clock::time_point deadline, Pred blocked) {
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::steady_clock::duration::zero()) {
+            return false;
+        }
+        const uint32_t observed = seq.load(std::memory_order_acquire);
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        heavyFence();
+        if (blocked() && !m_shutdown.load(std::memory_order_acquire)) {
+            futexWait(seq, observed, remaining);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Shared, read-mostly
     std::vector<T> m_buffer;
-    std::atomic<size_t> m_head;
-    std::atomic<size_t> m_tail;
+    const size_t m_mask;
+    OverflowPolicy m_policy{OverflowPolicy::Block};
+    DropHandler  m_onDrop;
+    KeyPredicate m_isKey;
+
+    // Consumer owned
+    alignas(kCacheLineSize) std::atomic<size_t> m_head{0};
+    size_t m_cachedTail{0};
+    std::atomic_flag m_headLock = ATOMIC_FLAG_INIT;
+
+    // Producer owned
+    alignas(kCacheLineSize) std::atomic<size_t> m_tail{0};
+    size_t m_cachedHead{0};
+    bool m_awaitKey{false};   // KeepGop resync state
+    std::vector<T> m_victims; // KeepGop eviction scratch
+
+    // Wait/notify words, only written when somebody actually sleeps
+    alignas(kCacheLineSize) std::atomic<uint32_t> m_pushSeq{0};
+    std::atomic<uint32_t> m_pushWaiters{0};
+    alignas(kCacheLineSize) std::atomic<uint32_t> m_popSeq{0};
+    std::atomic<uint32_t> m_popWaiters{0};
+    std::atomic<bool> m_shutdown{false};
+
+    // Stats
+    alignas(kCacheLineSize) std::atomic<uint64_t> m_enqueued{0};
+    std::atomic<uint64_t> m_droppedNewest{0};
+    std::atomic<uint64_t> m_droppedOldest{0};
 };
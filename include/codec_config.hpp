@@ -0,0 +1,45 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Encoder tuning, independent of the codec: rate control, GOP, B-frames,
+// threading and lookahead. VideoEncoder maps it onto libx264, libx265 and
+// libsvtav1 (other encoders get the generic AVCodecContext fields only).
+// Start from a named profile and override what the camera needs:
+//   live    - low latency: CBR with a short VBV, no B-frames, no lookahead, slice threads
+//   archive - storage: constant quality, B-frames, long lookahead, slower preset
+//   edge    - low CPU: constant quality on the fastest preset, few threads, short lookahead
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class RateControl {
+    Crf,    // constant quality; maxBitrateKbps > 0 caps it (capped CRF)
+    Cbr,    // constant bitrate, VBV buffer of bufferKbits
+    Vbr     // average bitrateKbps, peaks up to maxBitrateKbps
+};
+
+struct CodecConfig {
+    std::string profile = "live";
+    RateControl rateControl = RateControl::Cbr;
+    int crf = 23;
+    int bitrateKbps = 0;        // 0 = from the resolution and frame rate
+    int maxBitrateKbps = 0;     // 0 = bitrateKbps for CBR, uncapped otherwise
+    int bufferKbits = 0;        // VBV buffer, 0 = half a second at the max rate
+    double gopSeconds = 2.0;    // keyframe interval
+    int bFrames = 0;
+    int threads = 0;            // 0 = the codec's choice
+    bool sliceThreads = true;   // slice threading adds no frames of delay, frame threading scales better
+    int lookahead = 0;          // frames, -1 = the codec's default
+    std::string preset = "veryfast"; // x264 names; mapped to SVT-AV1's numbers
+    std::string tune = "zerolatency";
+    // Passed as is to the encoder's private options, after everything above
+    std::vector<std::pair<std::string, std::string>> options;
+};
+
+// Named starting points: live, archive or edge. Throws on an unknown name.
+CodecConfig codecProfile(const std::string& name);
+
+RateControl parseRateControl(const std::string& name);
@@ -5,6 +5,36 @@
 
 #include <string>
 #include <memory>
+#include <utility>
+#include <vector>
+#include <buffer_queue.hpp> // for OverflowPolicy
+#include <codec_config.hpp>
+#include <detection_decoder.hpp>
+#include <inference_backend.hpp>
+
+// One analysis stage between capture and the encoder, in pipeline order
+struct StageConfig {
+    std::string name;       // motion, ai, tracker or overlay
+    size_t queueCapacity;   // ring size of the link feeding this stage
+    int workers = 1;        // > 1: a pool sharing one MpmcQueue, put back in order by a FrameReorderer
+};
+
+// One camera of a multi-camera process; everything else comes from the shared settings
+struct CameraConfig {
+    std::string name;
+    std::string inputUrl;
+    std::string outputUrl;
+    std::string standbyUrl; // optional
+};
+
+// One step of an ABR ladder: the decoded stream encoded again at this size, to its own output
+struct RenditionConfig {
+    std::string name;
+    int width;
+    int height;
+    std::string outputUrl;  // "{camera}" is replaced by the camera's name
+    int bitrateKbps;        // optional, 0 = the encoder settings'; caps the rate under crf
+};
 
 struct Config {
     // Input stream (e.g., RTSP URL)
@@ -13,15 +43,146 @@ struct Config {
     // Output (e.g., RTMP URL or local file path)
     std::string outputUrl;
 
+    // Backup URL of the same camera (or its substream), kept open as a warm standby
+    std::string standbyUrl;
+
+    // Several cameras, one "camera <name> <inputUrl> <outputUrl> [standbyUrl]" line each.
+    // When present these replace inputUrl/outputUrl.
+    std::vector<CameraConfig> cameras;
+
+    // Input tuning, mostly for RTSP. 0/empty/-1 keeps FFmpeg's default.
+    std::string rtspTransport;      // tcp, udp, udp_multicast or http
+    long long inputProbeSize;       // bytes
+    int inputAnalyzeDurationMs;
+    bool inputNoBuffer;             // fflags nobuffer
+    int inputBufferSize;            // UDP receive buffer, bytes
+    int inputMaxDelayMs;            // -1 = default
+    int inputReorderQueueSize;      // RTP packets, -1 = default
+    int inputTimeoutMs;             // 0 = wait forever on a silent camera
+    bool cacheStreamInfo;           // reconnects skip the stream probe
+    int jitterBufferMs;             // reorder window on the packets, 0 = off
+    int jitterBufferPackets;
+
+    // Shared executor running the analysis stages of every camera
+    int executorThreads;      // 0 = one per hardware thread
+    bool executorPinCores;
+    int executorSliceFrames;  // frames a stage handles per turn before the next camera gets the core
+
     // Video encoding parameters
     int width;
     int height;
     int fps;
     std::string codecName; // e.g., "libx264", "h264_nvenc", etc.
 
+    // Encoder tuning: a named profile (live, archive or edge, see codec_config.hpp),
+    // then these overrides on top; -1/empty keeps the profile's value.
+    std::string encoderProfile;
+    std::string encoderRateControl;     // crf, cbr or vbr
+    int encoderCrf;
+    int encoderBitrateKbps;
+    int encoderMaxBitrateKbps;
+    int encoderBufferKbits;
+    double encoderGopSeconds;
+    int encoderBFrames;
+    int encoderThreads;                 // 0 = the codec's choice; unset, several cameras share the cores
+    int encoderSliceThreads;            // 1 = slice, 0 = frame threading
+    int encoderLookahead;               // frames
+    std::string encoderPreset;
+    std::string encoderTune;            // "none" clears the profile's tune
+    // Private encoder options, one "encoderOption <name> <value>" line each,
+    // e.g. "encoderOption x265-params aq-mode=3"
+    std::vector<std::pair<std::string, std::string>> encoderOptions;
+    // Another profile for some cameras, one "cameraEncoderProfile <camera> <profile>" line each
+    std::vector<std::pair<std::string, std::string>> cameraEncoderProfiles;
+
+    // ABR ladder, one "rendition <name> <width> <height> <outputUrl> [bitrateKbps]" line each.
+    // When present these replace the single encoder and outputUrl: the stream is
+    // decoded once and encoded once per rendition, each on its own thread.
+    std::vector<RenditionConfig> renditions;
+
+    // Relay the camera's own bitstream instead of decoding and re-encoding it
+    bool passthrough;
+    std::string analysisDecode; // passthrough only, what the stages get: all, keyframes or none
+    // Cheaper analysis decodes, passthrough only (transcoded frames must stay intact)
+    double analysisFps;         // 0 = every decoded frame
+    int decodeLowres;           // 0..3, decode at 1/2^n size where the decoder supports it
+    bool decodeSkipLoopFilter;
+
+    // Decoder
+    int decoderThreads;             // 0 = one per core, -1 = that shared out between the cameras
+    std::string decoderThreadType;  // frame, slice or auto (both)
+    std::string hwDecode;           // none, auto, vaapi or qsv; empty = auto with enableHardwareAccel, else none
+    std::string hwDecodeDevice;     // e.g. /dev/dri/renderD128, empty = the default device
+    bool hwDecodeMap;               // zero-copy surface mapping, 0 copies frames out instead
+    int hwDecodeExtraFrames;        // extra surfaces for mapped frames still in the pipeline
+
+    // Encoder on the GPU. Without a usable device or encoder it falls back to codecName in software.
+    std::string hwEncode;           // none, auto, vaapi or qsv; empty = auto with enableHardwareAccel, else none
+    std::string hwEncodeDevice;     // empty = the default device
+
     // Motion detection parameters
     double motionThreshold;
     int motionFrameInterval;
+    int motionDownscale;            // analyse luma averaged over NxN blocks: 1, 2, 4 or 8
+    int motionZoneRows;             // zone grid scored separately
+    int motionZoneCols;
+    std::string motionZoneMask;     // row-major 0/1 per zone, e.g. "110111"; empty = all zones
+    // Areas ignored by the detector, normalized x,y points. One polygon per
+    // "motionExcludePolygon x,y x,y x,y ..." line, the key may repeat.
+    std::vector<std::vector<std::pair<float, float>>> motionExcludePolygons;
+
+    // AI model and inference engine
+    std::string aiEngine;      // opencv, openvino or onnxruntime
+    std::string aiModelPath;
+    std::string aiModelConfig; // optional: prototxt/pbtxt, or the .bin of an OpenVINO IR
+    bool aiUseGPU;
+    int aiInputWidth;
+    int aiInputHeight;
+    int aiIntraOpThreads;      // 0 = engine default
+    int aiInterOpThreads;      // 0 = engine default; ONNX Runtime only
+    bool aiInt8;               // model is INT8-quantized
+
+    // AI detection gating on the motion verdict
+    bool aiMotionGated;
+    int aiRecheckIntervalMs;   // infer on static scenes at least this often
+    int aiMotionKeepAliveMs;   // keep inferring this long after motion stops
+
+    // AI output decoding
+    std::string aiModelLayout; // yolov5, yolov8 or ssd
+    float aiConfThreshold;
+    float aiNmsThreshold;
+
+    // AI batching: frames per forward pass and how long to wait to fill a batch
+    int aiBatchSize;
+    int aiBatchMaxWaitMs;
+    bool aiSharedBatch;        // one model for every camera, batches mix their frames
+
+    // Async AI: forward frames at once, infer on a worker pool, publish results on the DetectionBus
+    bool aiAsync;
+    int aiAsyncWorkers;
+    int aiAsyncQueueDepth;
+
+    // Object tracking: run the detector on every Nth frame, the tracker fills in the rest
+    int aiDetectionStride;
+    int trackerMaxAge;         // frames a track coasts without a detection before it is dropped
+    int trackerMinHits;        // detections before a track is reported
+    float trackerIouThreshold;
+
+    // Box outlines burned in by the overlay stage
+    int overlayThickness;
+
+    // Pipeline topology: "pipelineStages motion:64 ai:8 tracker overlay" runs the
+    // stages in that order, ':N' sizes the link into a stage. "none" feeds the encoder directly.
+    // 'xN' runs N instances of the ai stage on one shared link, e.g. "ai:8x3". Sync
+    // ai, single or pooled, keeps its own threads even with the executor, inference blocks.
+    std::vector<StageConfig> pipelineStages;
+    size_t encoderQueueCapacity;        // last stage -> encoder
+    size_t streamerQueueCapacity;       // encoder -> streamer
+
+    // What each pipeline link does when its consumer falls behind
+    OverflowPolicy captureQueuePolicy;  // capture -> first stage
+    OverflowPolicy encoderQueuePolicy;  // last stage -> encoder
+    OverflowPolicy streamerQueuePolicy; // encoder -> streamer (packets)
 
     // Logging
     std::string logFilePath;
@@ -30,9 +191,17 @@ struct Config {
     // Other
     bool enableHardwareAccel;
     bool reconnectOnFailure;
+    int reconnectInitialMs;   // first retry delay, doubling up to reconnectDelaySecs
     int reconnectDelaySecs;
 
     void validate() const;
+
+    // encoderProfile with the overrides applied; throws on unknown names
+    CodecConfig codecConfig() const;
+
+    // The ai* settings for the net and its output decoding; throw on unknown names
+    InferenceOptions inferenceOptions() const;
+    DecoderOptions detectionDecoderOptions() const;
 };
 
 std::shared_ptr<Config> loadConfig(const std::string& filename);
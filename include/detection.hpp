@@ -0,0 +1,13 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#pragma once
+
+// we create a simple struct to hold detection information.
+// Lives on its own so DecodedFrame can carry results without pulling in OpenCV.
+struct DetectionBox {
+    float x, y, width, height;
+    float confidence;
+    int classId;
+    int trackId = -1; // set by the tracker, -1 for raw detections
+};
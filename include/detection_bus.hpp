@@ -0,0 +1,66 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Where AIDetector publishes its results, decoupled from the frame path.
+// Event consumers (alerts, recording triggers...) subscribe and get every
+// result; the encoder overlay looks up the latest result at or before the pts
+// it is about to encode, so boxes can lag the video by the inference time
+// without the video waiting for them.
+
+#pragma once
+
+extern "C" {
+#include <libavutil/mathematics.h>
+}
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <detection.hpp>
+
+struct DetectionEvent {
+    int64_t pts = 0;       // of the frame the detections belong to
+    AVRational timeBase{0, 1}; // what 'pts' counts in; {0, 1} = unknown
+    uint64_t seq = 0;
+    int frameWidth = 0;
+    int frameHeight = 0;
+    std::vector<DetectionBox> detections;
+};
+
+class DetectionBus {
+public:
+    using Subscriber = std::function<void(const DetectionEvent&)>;
+
+    explicit DetectionBus(size_t historySize = 64);
+
+    // Subscribers run on the publishing (inference) thread, keep them short.
+    // Returns an id for unsubscribe().
+    int subscribe(Subscriber subscriber);
+    void unsubscribe(int id);
+
+    // A pts far behind the newest one means the input restarted (reconnect,
+    // standby failover) and the history from before it is dropped.
+    void publish(DetectionEvent event);
+
+    // Latest event with pts <= 'pts' from the recent history. False if there is none.
+    bool latestAtOrBefore(int64_t pts, DetectionEvent& out) const;
+
+    uint64_t published() const;
+
+private:
+    bool isRestart(const DetectionEvent& event) const; // under m_mutex
+
+    size_t m_historySize;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::pair<int, Subscriber>> m_subscribers;
+    int m_nextId = 1;
+    std::deque<DetectionEvent> m_history; // in arrival order, the oldest goes first
+    int64_t m_newestPts = 0;              // highest pts in m_history
+    uint64_t m_published = 0;
+};
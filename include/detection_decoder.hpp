@@ -0,0 +1,70 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Turns a detector's raw output tensor into DetectionBoxes: confidence filter,
+// class argmax and per-class NMS. Plain C++ on float buffers (no OpenCV) so it
+// can be benchmarked on its own. The hot loops (YOLOv8 class argmax, YOLOv5
+// objectness filter) have AVX2 versions picked at runtime like sumAbsDiff().
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <detection.hpp>
+
+enum class DetectionLayout {
+    YoloV5, // [rows, 5 + C]: cx, cy, w, h, objectness, class scores. Input pixels.
+    YoloV8, // [4 + C, anchors]: cx, cy, w, h rows then one row per class. Input pixels.
+            // Exports transposed to [anchors, 4 + C] are recognised too.
+    Ssd     // [N, 7]: imageId, label, conf, x1, y1, x2, y2, normalized. NMS already done by the net.
+};
+
+struct DecoderOptions {
+    DetectionLayout layout = DetectionLayout::YoloV5;
+    float confThreshold    = 0.25f;
+    float nmsThreshold     = 0.45f; // IoU above which the weaker box of a class is dropped
+    int maxDetections      = 300;   // per image, highest scores win
+    bool classAgnosticNms  = false;
+};
+
+// Throws std::runtime_error on anything but "yolov5", "yolov8" or "ssd".
+DetectionLayout parseDetectionLayout(const std::string& name);
+
+class DetectionDecoder {
+public:
+    explicit DetectionDecoder(const DecoderOptions& options = DecoderOptions());
+
+    // Decode one image's output into 'out' (cleared first), in frame pixel coordinates.
+    // For the YOLO layouts 'data' points at this image's [dim1, dim2] slice; SSD
+    // has one [dim1, 7] table for the whole batch, 'imageIndex' picks the rows.
+    // inputWidth/Height is what the frame was scaled to for the net.
+    void decode(const float* data, int dim1, int dim2, int imageIndex,
+                int inputWidth, int inputHeight, int frameWidth, int frameHeight,
+                std::vector<DetectionBox>& out);
+
+    const DecoderOptions& options() const { return m_options; }
+
+    // Name of the argmax/filter implementation in use ("avx2" or "scalar").
+    static const char* kernelName();
+
+private:
+    void decodeYoloRows(const float* data, int rows, int cols, bool hasObjectness,
+                        float sx, float sy, std::vector<DetectionBox>& out);
+    void decodeYoloV8(const float* data, int channels, int anchors,
+                      float sx, float sy, std::vector<DetectionBox>& out);
+    void decodeSsd(const float* data, int rows, int cols, int imageIndex,
+                   int frameWidth, int frameHeight, std::vector<DetectionBox>& out);
+    void nms(std::vector<DetectionBox>& boxes);
+
+    DecoderOptions m_options;
+
+    // Scratch, kept between calls
+    std::vector<float> m_bestScore;
+    std::vector<int32_t> m_bestClass;
+    std::vector<int32_t> m_candidates;
+    std::vector<uint32_t> m_order;
+    std::vector<uint8_t> m_suppressed;
+    std::vector<DetectionBox> m_kept;
+};
@@ -0,0 +1,13 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#pragma once
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// Encoded packet container: from the encoder, or straight from VideoCapture in passthrough
+struct EncodedPacket {
+    AVPacket* packet = nullptr;
+};
@@ -0,0 +1,87 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Shared work-stealing thread pool for the analysis stages of many cameras
+// (see Supervisor). One worker per core, optionally pinned to it. Each worker
+// runs its own deque front to back; an idle worker steals from the back of
+// the others'. A task that resubmits itself from a worker lands at the back
+// of that worker's deque, so a stream keeps its core (and its cache) and
+// every other stream queued there gets a turn first.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ExecutorStats {
+    uint64_t tasksRun = 0;
+    uint64_t tasksStolen = 0;
+    std::vector<double> workerBusy; // fraction of wall time each worker spent in tasks since start
+};
+
+class Executor {
+public:
+    using Task = std::function<void()>;
+
+    // threads <= 0: one per hardware thread
+    explicit Executor(int threads = 0, bool pinCores = true);
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    // From a worker: onto its own deque. From anywhere else: round-robin.
+    void submit(Task task);
+    // Same, once 'delay' has passed. For polling idle streams without spinning.
+    void submitAfter(std::chrono::microseconds delay, Task task);
+
+    // Drops whatever is still queued and joins the workers
+    void shutdown();
+
+    int threads() const { return static_cast<int>(m_workers.size()); }
+    ExecutorStats stats() const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+        std::atomic<uint64_t> run{0};
+        std::atomic<uint64_t> stolen{0};
+        std::atomic<uint64_t> busyNs{0};
+    };
+
+    struct Timed {
+        std::chrono::steady_clock::time_point due;
+        int worker;
+        Task task;
+    };
+
+    void workerLoop(int index);
+    bool takeTask(int index, Task& out);
+    void pushTo(int index, Task task);
+    void timerLoop();
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<bool> m_running{true};
+    std::atomic<uint32_t> m_nextWorker{0};
+    std::chrono::steady_clock::time_point m_started;
+
+    // Idle workers park on this futex word, bumped on every submit
+    std::atomic<uint32_t> m_wakeSeq{0};
+    std::atomic<int> m_sleepers{0};
+
+    // Delayed tasks, soonest first
+    std::mutex m_timerMutex;
+    std::condition_variable m_timerCv;
+    std::vector<Timed> m_timed;
+    std::thread m_timerThread;
+};
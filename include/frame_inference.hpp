@@ -0,0 +1,63 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// One copy of the model and everything needed to feed it: decoded frames go in,
+// boxes in frame pixel coordinates come out, up to maxBatch frames per forward
+// pass. Each frame is scaled and converted by one sws pass straight into its
+// slot of the NCHW blob. Not thread-safe (engines and scalers aren't): AIDetector
+// keeps one per inference thread, InferenceBatcher one for every camera.
+
+#pragma once
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <detection.hpp>
+#include <detection_decoder.hpp>
+#include <inference_backend.hpp>
+
+class FrameInference {
+public:
+    FrameInference(const InferenceOptions& inference, const DecoderOptions& decode, int maxBatch);
+    ~FrameInference();
+
+    FrameInference(const FrameInference&) = delete;
+    FrameInference& operator=(const FrameInference&) = delete;
+
+    // Errors are logged; without a model infer() does nothing
+    bool load();
+    bool loaded() const { return m_backend != nullptr; }
+
+    // results[i] gets the boxes of frames[i]; more than maxBatch frames take several
+    // forward passes. False if nothing went through the net (no model, engine error).
+    bool infer(const std::vector<const AVFrame*>& frames, std::vector<std::vector<DetectionBox>>& results);
+
+    int maxBatch() const { return m_maxBatch; }
+
+private:
+    // Scale + convert an AVFrame (YUV) straight into one NCHW RGB float slot of the net input
+    bool frameToBlob(const AVFrame* frame, float* dst);
+    // Forward pass on the first m_slotOwner.size() slots, boxes into results[m_slotOwner[n]]
+    bool runInference(std::vector<std::vector<DetectionBox>>& results);
+
+    InferenceOptions m_inference;
+    int m_maxBatch;
+    int m_inputWidth;
+    int m_inputHeight;
+
+    std::unique_ptr<InferenceBackend> m_backend; // null until load() succeeds
+    DetectionDecoder m_decoder;
+    SwsContext* m_swsCtx = nullptr;              // sws_getCachedContext rebuilds it on size/format changes
+    std::vector<uint8_t> m_rgbPlanes;            // R, G, B planes at net size, sws writes here
+    std::vector<float> m_blob;                   // [maxBatch, 3, H, W], allocated once
+    std::vector<std::pair<int, int>> m_imageSizes; // source frame width/height of each blob slot
+    std::vector<size_t> m_slotOwner;             // index into 'frames' for each blob slot
+};
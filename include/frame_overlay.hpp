@@ -0,0 +1,55 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Burns DecodedFrame::detections into the picture as box outlines before the
+// encoder, one colour per track (or per class for untracked boxes). Draws
+// straight into the YUV planes, no RGB round trip. Handles the 4:2:0 formats
+// the decoders give us (yuv420p/yuvj420p and nv12); other frames pass untouched.
+// Behind an async AIDetector with no tracker in between the results never reach
+// the frame; the overlay then draws the latest one published at or before it.
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include <detection_bus.hpp>
+#include <logger.hpp>
+#include <pipeline_stage.hpp>
+#include <queue_interface.hpp>
+#include <video_capture.hpp> // for DecodedFrame
+
+class FrameOverlay : public PipelineStage {
+public:
+    // 'bus': AIDetector's in async mode when no ObjectTracker fills the frames' boxes
+    FrameOverlay(QueueInterface<DecodedFrame>& inQueue,
+                 QueueInterface<DecodedFrame>& outQueue,
+                 int thickness = 2,
+                 DetectionBus* bus = nullptr);
+    ~FrameOverlay();
+
+    void start() override;
+    void startPolled() override;
+    void stop() override;
+    bool isRunning() const override { return m_running.load(); }
+    size_t poll(size_t budget) override;
+
+private:
+    struct Yuv { uint8_t y, u, v; };
+
+    void overlayLoop();
+    void process(DecodedFrame& df);
+    void draw(AVFrame* frame, const DetectionBox& box);
+    void fillRect(AVFrame* frame, int x0, int y0, int x1, int y1, const Yuv& color);
+    void forward(DecodedFrame& df);
+
+    QueueInterface<DecodedFrame>& m_inQueue;
+    QueueInterface<DecodedFrame>& m_outQueue;
+    int m_thickness;
+    DetectionBus* m_bus;
+    DetectionEvent m_event;      // scratch for the bus lookup
+    bool m_warnedFormat = false;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+};
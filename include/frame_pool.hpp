@@ -0,0 +1,93 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Per-stream frame allocator for the capture path. It recycles AVFrame shells
+// through a free list and serves decoder picture planes from AVBufferPools via
+// a custom get_buffer2, so a steady-state stream stops hitting malloc/free
+// (and page faults) for every 1080p/4K picture.
+
+#pragma once
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+}
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct FramePoolStats {
+    uint64_t shellHits    = 0; // acquireFrame() served from the free list
+    uint64_t shellMisses  = 0; // acquireFrame() had to av_frame_alloc()
+    uint64_t bufferHits   = 0; // plane buffers recycled by the AVBufferPools
+    uint64_t bufferMisses = 0; // plane buffers the pools had to allocate
+};
+
+class FramePool {
+public:
+    explicit FramePool(size_t maxIdleShells = 256);
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // Route the decoder's picture allocations through this pool. Call before
+    // avcodec_open2(); decoders without AV_CODEC_CAP_DR1 keep the default allocator.
+    void attach(AVCodecContext* codecCtx);
+
+    // Empty frame shell, ready for avcodec_receive_frame().
+    AVFrame* acquireFrame();
+
+    // Planes for frame->format/width/height from the same pools, for frames we
+    // fill ourselves (e.g. the encoder's scaler output). False for formats the
+    // pools don't do (hardware, palette).
+    bool allocBuffers(AVFrame* frame);
+
+    // Unrefs the planes (they go back to their AVBufferPool) and keeps the shell.
+    // Safe from any thread.
+    void releaseFrame(AVFrame*& frame);
+
+    FramePoolStats stats() const;
+
+private:
+    static int getBuffer2(AVCodecContext* codecCtx, AVFrame* frame, int flags);
+    bool allocPlanes(AVCodecContext* codecCtx, AVFrame* frame); // codecCtx may be null
+    void resetPools();
+
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+    static AVBufferRef* allocBuffer(void* opaque, size_t size);
+#else
+    static AVBufferRef* allocBuffer(void* opaque, int size);
+#endif
+
+    size_t m_maxIdleShells;
+    std::mutex m_shellMutex;
+    std::vector<AVFrame*> m_idleShells;
+
+    // Plane pools for the current format/geometry, rebuilt when the stream changes.
+    // Buffers still in flight keep an old pool alive until they come back.
+    std::mutex m_poolMutex;
+    AVBufferPool* m_pools[4] = {nullptr, nullptr, nullptr, nullptr};
+    int m_poolFormat = -1;
+    int m_poolWidth  = 0;
+    int m_poolHeight = 0;
+
+    std::atomic<uint64_t> m_shellHits{0};
+    std::atomic<uint64_t> m_shellMisses{0};
+    std::atomic<uint64_t> m_bufferGets{0};
+    std::atomic<uint64_t> m_bufferMisses{0};
+};
+
+// Returns a decoded frame to its pool, or frees it if it never came from one.
+inline void releaseFrame(const std::shared_ptr<FramePool>& pool, AVFrame*& frame) {
+    if (!frame) return;
+    if (pool) {
+        pool->releaseFrame(frame);
+    } else {
+        av_frame_free(&frame);
+    }
+}
@@ -0,0 +1,60 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Puts frames back in order after a pool of workers (pipelineStages "ai:8x3":
+// three AIDetectors sharing one MpmcQueue) finished them out of order. Frames
+// are released by DecodedFrame::seq, which the workers copy from their dequeue
+// ticket, so the output follows the pts order the frames had when they entered the pool.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <logger.hpp>
+#include <pipeline_stage.hpp>
+#include <queue_interface.hpp>
+#include <video_capture.hpp> // for DecodedFrame
+
+class FrameReorderer : public PipelineStage {
+public:
+    // 'window' bounds how far ahead of the next expected frame we buffer;
+    // 'maxHold' is how long a gap may stall the output before we skip it.
+    FrameReorderer(QueueInterface<DecodedFrame>& inQueue,
+                   QueueInterface<DecodedFrame>& outQueue,
+                   size_t window = kDefaultQueueCapacity,
+                   std::chrono::milliseconds maxHold = std::chrono::milliseconds(500));
+    ~FrameReorderer();
+
+    void start() override;
+    void startPolled() override;
+    void stop() override;
+    bool isRunning() const override { return m_running.load(); }
+    size_t poll(size_t budget) override;
+
+private:
+    void reorderLoop();
+    void accept(DecodedFrame&& df);
+    // Polled mode stops once the out queue is full, the rest waits for the next poll
+    void releaseInOrder();
+    void skipStalledGap();
+    bool outFull() const { return m_polled && m_outQueue.size() >= m_outQueue.capacity(); }
+    void forward(DecodedFrame&& df);
+
+    QueueInterface<DecodedFrame>& m_inQueue;
+    QueueInterface<DecodedFrame>& m_outQueue;
+
+    // Slot seq % window holds the frame with that ticket until its turn
+    std::vector<std::optional<DecodedFrame>> m_pending;
+    size_t   m_pendingCount = 0;
+    uint64_t m_nextSeq = 0;
+    std::chrono::milliseconds m_maxHold;
+    std::chrono::steady_clock::time_point m_lastRelease; // or when the oldest pending frame arrived
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    bool m_polled = false;
+};
@@ -0,0 +1,38 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// End of the analysis chain when nothing encodes the frames (passthrough):
+// takes whatever the last stage forwards and hands it back to the frame pool.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include <pipeline_stage.hpp>
+#include <queue_interface.hpp>
+#include <video_capture.hpp> // for DecodedFrame
+
+class FrameSink : public PipelineStage {
+public:
+    explicit FrameSink(QueueInterface<DecodedFrame>& inQueue);
+    ~FrameSink();
+
+    void start() override;
+    void startPolled() override;
+    void stop() override;
+    bool isRunning() const override { return m_running.load(); }
+    size_t poll(size_t budget) override;
+
+    uint64_t framesConsumed() const { return m_consumed.load(std::memory_order_relaxed); }
+
+private:
+    void sinkLoop();
+
+    QueueInterface<DecodedFrame>& m_inQueue;
+    std::atomic<uint64_t> m_consumed{0};
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+};
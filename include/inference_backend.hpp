@@ -0,0 +1,62 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// What AIDetector runs its net on. The detector fills an NCHW float blob and
+// hands it over; each backend owns its engine's model/session objects and
+// returns the raw output tensor for DetectionDecoder.
+//
+// OpenCV DNN is always built. OpenVINO and ONNX Runtime are compiled in with
+// -DARITHA_WITH_OPENVINO=ON / -DARITHA_WITH_ONNXRUNTIME=ON.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class InferenceEngine {
+    OpenCv,
+    OpenVino,
+    OnnxRuntime
+};
+
+struct InferenceOptions {
+    InferenceEngine engine = InferenceEngine::OpenCv;
+    std::string modelPath;
+    std::string modelConfig;  // prototxt/pbtxt for OpenCV, .bin weights for an OpenVINO .xml
+    bool useGPU = false;
+
+    int inputWidth  = 640;    // frames are scaled to this
+    int inputHeight = 640;
+
+    int intraOpThreads = 0;   // threads inside one op (GEMM/conv), 0 = engine default
+    int interOpThreads = 0;   // ops run in parallel (ONNX Runtime only), 0 = engine default
+    bool int8 = false;        // model is INT8-quantized, let the engine use its low-precision kernels
+};
+
+// Raw output of the last infer() call, valid until the next one
+struct InferenceOutput {
+    const float* data = nullptr;
+    std::vector<int64_t> shape;
+};
+
+class InferenceBackend {
+public:
+    virtual ~InferenceBackend() = default;
+
+    // Errors are logged, false means the backend can't be used
+    virtual bool load(const InferenceOptions& options) = 0;
+
+    // 'input' is [batch, channels, height, width] float
+    virtual bool infer(const float* input, int batch, int channels, int height, int width,
+                       InferenceOutput& output) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// Throws std::runtime_error on anything but "opencv", "openvino" or "onnxruntime".
+InferenceEngine parseInferenceEngine(const std::string& name);
+
+// Falls back to OpenCV DNN (with a warning) when the requested engine wasn't compiled in.
+std::unique_ptr<InferenceBackend> createInferenceBackend(InferenceEngine engine);
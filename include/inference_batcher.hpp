@@ -0,0 +1,91 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// One model and one batching scheduler shared by the ai stages of every camera
+// (aiSharedBatch). Each AIDetector still gates its own frames; the ones it
+// wants inferred are handed here, and the batcher thread packs frames from all
+// cameras into forward passes of up to maxBatch, closing a batch when it is
+// full or maxWait after its oldest frame arrived. The boxes go back to each
+// caller, which puts them on its own frames and its own DetectionBus.
+
+#pragma once
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <ai_detector.hpp> // for AIBatchOptions
+#include <detection.hpp>
+#include <detection_decoder.hpp>
+#include <frame_inference.hpp>
+#include <inference_backend.hpp>
+
+class InferenceBatcher {
+public:
+    InferenceBatcher(const InferenceOptions& inference,
+                     const AIBatchOptions& batch,
+                     const DecoderOptions& decode);
+    ~InferenceBatcher();
+
+    void start();
+    // Callers still waiting get false back
+    void stop();
+
+    // Blocks until every frame has been through the net, then results[i] holds
+    // the boxes of frames[i]. The frames must stay alive until it returns.
+    // False if the batcher stopped first or the forward pass failed.
+    bool infer(const std::vector<const AVFrame*>& frames, std::vector<std::vector<DetectionBox>>& results);
+
+    uint64_t batches() const { return m_batches.load(std::memory_order_relaxed); }
+    uint64_t framesInferred() const { return m_framesInferred.load(std::memory_order_relaxed); }
+
+private:
+    // One infer() call, on the caller's stack while it waits
+    struct Request {
+        const std::vector<const AVFrame*>* frames;
+        std::vector<std::vector<DetectionBox>>* results;
+        std::chrono::steady_clock::time_point arrived;
+        size_t next = 0;        // first frame not taken into a batch yet
+        size_t remaining = 0;   // frames not inferred yet
+        bool ok = true;
+        bool done = false;
+    };
+    // Where a frame of the current batch came from
+    struct Slot {
+        Request* request;
+        size_t index;
+    };
+
+    void batchLoop();
+    // Under m_mutex: takes up to maxBatch frames from the oldest requests into m_frames/m_slots
+    void takeBatch();
+    void finish(Request& request); // under m_mutex
+
+    FrameInference m_inference;
+    AIBatchOptions m_batch;
+
+    std::mutex m_mutex;
+    std::condition_variable m_pending;  // batcher: frames arrived, or stop
+    std::condition_variable m_finished; // callers: a request is done
+    std::deque<Request*> m_requests;    // oldest first, still holding frames to take
+    size_t m_queuedFrames = 0;
+    bool m_running = false;
+
+    // The batch in flight, batcher thread only
+    std::vector<const AVFrame*> m_frames;
+    std::vector<Slot> m_slots;
+    std::vector<std::vector<DetectionBox>> m_results;
+
+    std::atomic<uint64_t> m_batches{0};
+    std::atomic<uint64_t> m_framesInferred{0};
+    std::thread m_thread;
+};
@@ -0,0 +1,71 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Small reorder buffer between av_read_frame() and the decoder/muxer. Packets
+// are held by dts for 'window' of stream time, so one that arrives a little
+// late over UDP still goes out in order; one that comes after its successors
+// were already released is dropped (decoder and muxer would both choke on it).
+// Also keeps the RFC 3550 interarrival jitter of the stream, i.e. how unevenly
+// the packets arrive compared to their timestamps.
+
+#pragma once
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+struct JitterStats {
+    uint64_t reordered = 0;  // arrived before a packet with a lower dts
+    uint64_t late      = 0;  // arrived after its place was gone, dropped
+    uint64_t overflow  = 0;  // released before the window was up, buffer full
+    double jitterMs    = 0.0;
+};
+
+class JitterBuffer {
+public:
+    explicit JitterBuffer(size_t capacity = 64);
+    ~JitterBuffer();
+
+    JitterBuffer(const JitterBuffer&) = delete;
+    JitterBuffer& operator=(const JitterBuffer&) = delete;
+
+    // New stream: drops what is buffered. 'window' is in 'timeBase' units.
+    void reset(AVRational timeBase, int64_t window);
+
+    // Takes ownership of 'packet'
+    void push(AVPacket* packet, std::chrono::steady_clock::time_point arrival);
+
+    // Next packet whose window is up, null if none; the caller owns it.
+    // 'flush' releases everything regardless, e.g. when the stream ended.
+    AVPacket* pop(bool flush = false);
+
+    size_t size() const { return m_packets.size(); }
+    const JitterStats& stats() const { return m_stats; }
+
+private:
+    struct Entry {
+        int64_t ts;
+        AVPacket* packet;
+    };
+
+    void clear();
+    void updateJitter(int64_t ts, std::chrono::steady_clock::time_point arrival);
+
+    size_t m_capacity;
+    std::deque<Entry> m_packets; // dts order
+    AVRational m_timeBase{1, 90000};
+    int64_t m_window = 0;
+    int64_t m_newest = AV_NOPTS_VALUE;    // highest dts buffered so far
+    int64_t m_released = AV_NOPTS_VALUE;  // dts of the last packet out
+
+    // Interarrival jitter, previous in-order packet
+    int64_t m_prevTs = AV_NOPTS_VALUE;
+    std::chrono::steady_clock::time_point m_prevArrival;
+    double m_jitterSecs = 0.0;
+
+    JitterStats m_stats;
+};
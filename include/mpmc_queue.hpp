@@ -0,0 +1,257 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include <queue_interface.hpp>
+#include <utilities.hpp>
+
+// @dev_notes: bounded multi-producer / multi-consumer ring (Dmitry Vyukov's design).
+// Every cell carries a sequence number that says whether it is ready to be
+// written (seq == pos) or read (seq == pos + 1) for a given lap, so producers
+// and consumers only contend on their own position counter with one CAS each.
+// Use it where several workers share a link, e.g. N AIDetectors on one input.
+//
+// Dequeue positions are handed out one by one, which makes them the ticket of
+// popBlocking(). Since an eviction would burn a ticket, DropOldest/KeepGop fall
+// back to DropNewest here so a reorderer downstream never waits for a hole.
+// A queue built with ticketed = false has nobody ordering by ticket and does
+// evict the oldest under DropOldest (KeepGop still drops the newest).
+template <typename T>
+class MpmcQueue final : public QueueInterface<T> {
+public:
+    using typename QueueInterface<T>::DropHandler;
+    using typename QueueInterface<T>::KeyPredicate;
+
+    explicit MpmcQueue(size_t capacity = kDefaultQueueCapacity, bool ticketed = true)
+        : m_ticketed(ticketed)
+        , m_capacity(roundUpPow2(capacity))
+        , m_mask(m_capacity - 1)
+        , m_cells(new Cell[m_capacity])
+    {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    size_t capacity() const override { return m_capacity; }
+
+    size_t size() const override {
+        const size_t enq = m_enqueuePos.load(std::memory_order_acquire);
+        const size_t deq = m_dequeuePos.load(std::memory_order_acquire);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    bool push(T&& item) override {
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            const size_t seq = cell->seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // Full: the consumer of the previous lap hasn't freed this cell yet
+                return false;
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        notify(m_pushSeq, m_popWaiters);
+        return true;
+    }
+
+    std::optional<T> pop() override {
+        return popImpl(nullptr);
+    }
+
+    bool pushBlocking(T&& item, std::chrono::milliseconds timeout) override {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            if (m_shutdown.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (push(std::move(item))) {
+                return true;
+            }
+            if (!park(m_popSeq, m_pushWaiters, deadline, [this] { return isFull(); })) {
+                return false;
+            }
+        }
+    }
+
+    std::optional<T> popBlocking(std::chrono::milliseconds timeout, uint64_t* ticket = nullptr) override {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            auto item = popImpl(ticket);
+            if (item.has_value() || m_shutdown.load(std::memory_order_acquire)) {
+                return item;
+            }
+            if (!park(m_pushSeq, m_popWaiters, deadline, [this] { return isEmpty(); })) {
+                return std::nullopt;
+            }
+        }
+    }
+
+    // Must be called before the producer and consumer threads start.
+    void setOverflowPolicy(OverflowPolicy policy, DropHandler onDrop, KeyPredicate isKey = nullptr) override {
+        (void)isKey;
+        if (policy == OverflowPolicy::Block || (policy == OverflowPolicy::DropOldest && !m_ticketed)) {
+            m_policy = policy;
+        } else {
+            m_policy = OverflowPolicy::DropNewest;
+        }
+        m_onDrop = std::move(onDrop);
+    }
+
+    OverflowPolicy overflowPolicy() const override { return m_policy; }
+
+    bool enqueue(T&& item, std::chrono::milliseconds timeout) override {
+        if (m_policy == OverflowPolicy::Block) {
+            if (!pushBlocking(std::move(item), timeout)) {
+                return false;
+            }
+        } else if (m_policy == OverflowPolicy::DropOldest && !m_shutdown.load(std::memory_order_acquire)) {
+            // Take the oldest out until there is room; other producers may refill it first
+            while (!push(std::move(item))) {
+                auto evicted = popImpl(nullptr);
+                if (evicted.has_value()) {
+                    if (m_onDrop) m_onDrop(evicted.value());
+                    m_droppedOldest.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        } else if (m_shutdown.load(std::memory_order_acquire) || !push(std::move(item))) {
+            if (m_onDrop) m_onDrop(item);
+            m_droppedNewest.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        m_enqueued.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    QueueStats stats() const override {
+        QueueStats s;
+        s.enqueued      = m_enqueued.load(std::memory_order_relaxed);
+        s.droppedNewest = m_droppedNewest.load(std::memory_order_relaxed);
+        s.droppedOldest = m_droppedOldest.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void shutdown() override {
+        m_shutdown.store(true, std::memory_order_release);
+        m_pushSeq.fetch_add(1, std::memory_order_seq_cst);
+        m_popSeq.fetch_add(1, std::memory_order_seq_cst);
+        futexWakeAll(m_pushSeq);
+        futexWakeAll(m_popSeq);
+    }
+
+    bool isShutdown() const override { return m_shutdown.load(std::memory_order_acquire); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq{0};
+        T data{};
+    };
+
+    static size_t roundUpPow2(size_t n) {
+        size_t cap = 2;
+        while (cap < n) cap <<= 1;
+        return cap;
+    }
+
+    std::optional<T> popImpl(uint64_t* ticket) {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            const size_t seq = cell->seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // Empty: nobody has written this lap's cell yet
+                return std::nullopt;
+            } else {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        std::optional<T> item(std::move(cell->data));
+        cell->seq.store(pos + m_capacity, std::memory_order_release);
+        if (ticket) *ticket = pos;
+        notify(m_popSeq, m_pushWaiters);
+        return item;
+    }
+
+    bool isEmpty() const {
+        const size_t pos = m_dequeuePos.load(std::memory_order_acquire);
+        return m_cells[pos & m_mask].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    bool isFull() const {
+        const size_t pos = m_enqueuePos.load(std::memory_order_acquire);
+        return m_cells[pos & m_mask].seq.load(std::memory_order_acquire) != pos;
+    }
+
+    // Same wait/notify scheme as BufferQueue: the syscall is only made when somebody sleeps.
+    static void notify(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters) {
+        lightFence();
+        if (waiters.load(std::memory_order_relaxed) != 0) {
+            seq.fetch_add(1, std::memory_order_release);
+            futexWakeAll(seq);
+        }
+    }
+
+    template <typename Pred>
+    bool park(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters,
+              std::chrono::steady_clock::time_point deadline, Pred blocked) {
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::steady_clock::duration::zero()) {
+            return false;
+        }
+        const uint32_t observed = seq.load(std::memory_order_acquire);
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        heavyFence();
+        if (blocked() && !m_shutdown.load(std::memory_order_acquire)) {
+            futexWait(seq, observed, remaining);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    const bool m_ticketed;      // someone orders by ticket, evicting would leave a hole
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+    OverflowPolicy m_policy{OverflowPolicy::Block};
+    DropHandler m_onDrop;
+
+    alignas(kCacheLineSize) std::atomic<size_t> m_enqueuePos{0};
+    alignas(kCacheLineSize) std::atomic<size_t> m_dequeuePos{0};
+
+    alignas(kCacheLineSize) std::atomic<uint32_t> m_pushSeq{0};
+    std::atomic<uint32_t> m_pushWaiters{0};
+    alignas(kCacheLineSize) std::atomic<uint32_t> m_popSeq{0};
+    std::atomic<uint32_t> m_popWaiters{0};
+    std::atomic<bool> m_shutdown{false};
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> m_enqueued{0};
+    std::atomic<uint64_t> m_droppedNewest{0};
+    std::atomic<uint64_t> m_droppedOldest{0};
+};
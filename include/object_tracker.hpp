@@ -0,0 +1,54 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Pipeline stage after AIDetector. Every frame leaves with the tracker's boxes
+// in DecodedFrame::detections (trackId set), whether or not the detector ran
+// on it, so AIDetector can run with a detection stride and the overlay and
+// event code still see a box per object on every frame.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include <detection_bus.hpp>
+#include <logger.hpp>
+#include <pipeline_stage.hpp>
+#include <queue_interface.hpp>
+#include <sort_tracker.hpp>
+#include <video_capture.hpp> // for DecodedFrame
+
+class ObjectTracker : public PipelineStage {
+public:
+    // 'bus' is for AIDetector in async mode, where results never reach the
+    // frame: the newest published result is fed to the tracker instead.
+    ObjectTracker(QueueInterface<DecodedFrame>& inQueue,
+                  QueueInterface<DecodedFrame>& outQueue,
+                  const SortOptions& options = SortOptions(),
+                  DetectionBus* bus = nullptr);
+    ~ObjectTracker();
+
+    void start() override;
+    void startPolled() override;
+    void stop() override;
+    bool isRunning() const override { return m_running.load(); }
+    size_t poll(size_t budget) override;
+
+private:
+    void trackLoop();
+    void track(DecodedFrame& df);
+    void forward(DecodedFrame& df);
+
+    QueueInterface<DecodedFrame>& m_inQueue;
+    QueueInterface<DecodedFrame>& m_outQueue;
+    DetectionBus* m_bus;
+
+    SortTracker m_tracker;
+    DetectionEvent m_event;      // scratch for the bus lookup
+    bool m_haveEvent = false;
+    uint64_t m_lastEventSeq = 0; // last bus result fed to the tracker
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+};
@@ -0,0 +1,35 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#pragma once
+
+#ifdef ARITHA_WITH_ONNXRUNTIME
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+
+#include <inference_backend.hpp>
+
+// ONNX Runtime with the default CPU execution provider.
+class OnnxRuntimeBackend final : public InferenceBackend {
+public:
+    OnnxRuntimeBackend();
+
+    bool load(const InferenceOptions& options) override;
+    bool infer(const float* input, int batch, int channels, int height, int width,
+               InferenceOutput& output) override;
+    const char* name() const override { return "onnxruntime"; }
+
+private:
+    Ort::Env m_env;
+    Ort::MemoryInfo m_memoryInfo;
+    std::unique_ptr<Ort::Session> m_session;
+    std::string m_inputName;
+    std::string m_outputName;
+    std::vector<Ort::Value> m_outputs; // keeps the output buffer alive until the next infer()
+};
+
+#endif // ARITHA_WITH_ONNXRUNTIME
@@ -0,0 +1,22 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+
+#include <inference_backend.hpp>
+
+// cv::dnn::Net, what AIDetector used directly before. Caffe/TensorFlow/ONNX/Darknet models.
+class OpenCvBackend final : public InferenceBackend {
+public:
+    bool load(const InferenceOptions& options) override;
+    bool infer(const float* input, int batch, int channels, int height, int width,
+               InferenceOutput& output) override;
+    const char* name() const override { return "opencv"; }
+
+private:
+    cv::dnn::Net m_net;
+    cv::Mat m_output;
+};
@@ -0,0 +1,28 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#pragma once
+
+#ifdef ARITHA_WITH_OPENVINO
+
+#include <openvino/openvino.hpp>
+
+#include <inference_backend.hpp>
+
+// OpenVINO runtime on the CPU plugin. Reads IR (.xml + .bin) or ONNX directly;
+// the batch dimension is made dynamic so AIDetector's batches go through as is.
+class OpenVinoBackend final : public InferenceBackend {
+public:
+    bool load(const InferenceOptions& options) override;
+    bool infer(const float* input, int batch, int channels, int height, int width,
+               InferenceOutput& output) override;
+    const char* name() const override { return "openvino"; }
+
+private:
+    ov::Core m_core;
+    ov::CompiledModel m_compiled;
+    ov::InferRequest m_request;
+    ov::Tensor m_output; // keeps the output buffer alive until the next infer()
+};
+
+#endif // ARITHA_WITH_OPENVINO
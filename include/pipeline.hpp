@@ -0,0 +1,124 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// One camera's chain, built from Config:
+//   capture -> [pipelineStages, in order] -> encoder -> streamer
+// Every link is its own BufferQueue, sized from the config. The capture link
+// and the encoder link take the configured overflow policies; links between
+// analysis stages block, so a slow stage pushes back onto the capture queue,
+// which is where frames get dropped.
+//
+// Given an Executor, the analysis stages run without threads of their own: one
+// recurring task per pipeline polls them in order, a few frames per stage per
+// turn, then goes to the back of the queue so other cameras get the core.
+// Capture, encoder and streamer keep their threads; they block on the network
+// and inside the codecs. So does a sync ai stage, which runs the forward pass
+// and waits to fill its batches, and so do the workers of an ai pool
+// ("ai:8x3"): they share an MpmcQueue, finish out of order, and a
+// FrameReorderer after them (polled like any stage) puts the frames back in
+// order. Async ai only gates and hands off, it polls like the rest.
+//
+// ABR ladder: the last link feeds a RenditionScaler instead, which hands one
+// frame per rendition to that rendition's own encoder -> streamer pair.
+//
+// Passthrough: no encoder, capture hands the camera's packets straight to the
+// streamer. Stages, if any, see only what analysisDecode decodes and end in a FrameSink.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <buffer_queue.hpp>
+#include <config.hpp>
+#include <detection_bus.hpp>
+#include <executor.hpp>
+#include <inference_batcher.hpp>
+#include <pipeline_stage.hpp>
+#include <video_capture.hpp>
+#include <video_encoder.hpp>
+#include <video_streamer.hpp>
+
+class Pipeline {
+public:
+    // 'name' tags the log lines; 'executor' null gives every stage its own thread.
+    // 'batcher': the ai stage infers on this model, shared with other cameras, instead of its own.
+    Pipeline(const Config& config, const std::string& name = "camera", Executor* executor = nullptr,
+             InferenceBatcher* batcher = nullptr);
+    ~Pipeline();
+
+    void start();
+    // Front to back, shutting each link down behind its producer so the next stage wakes at once
+    void stop();
+
+    // False as soon as any module has stopped
+    bool isRunning() const;
+
+    const std::string& name() const { return m_name; }
+
+    // Frames the capture put into the pipeline so far
+    uint64_t framesCaptured() const;
+    // Connects, startup/outage times and packet jitter of the input
+    CaptureStats captureStats() const;
+    // Items dropped so far over all links
+    uint64_t droppedItems() const;
+    void logQueueStats() const;
+
+    // Null unless the ai stage is configured
+    DetectionBus* detectionBus() { return m_bus.get(); }
+
+private:
+    struct Stage {
+        std::string name;
+        std::unique_ptr<PipelineStage> module;
+        QueueInterface<DecodedFrame>* out = nullptr; // shut down once every stage writing it stopped
+        bool ownThread = false;                      // pool worker or sync ai, started threaded even with an executor
+    };
+
+    // One step of the ABR ladder
+    struct Rendition {
+        std::string name;
+        std::unique_ptr<BufferQueue<DecodedFrame>> frames;  // ladder -> encoder
+        std::unique_ptr<BufferQueue<EncodedPacket>> packets; // encoder -> streamer
+        std::unique_ptr<VideoEncoder> encoder;
+        std::unique_ptr<VideoStreamer> streamer;
+    };
+
+    // Executor mode. The control block outlives the pipeline in tasks still
+    // queued; the mutex keeps stop() from pulling the stages out from under a slice.
+    struct SliceControl {
+        std::mutex mutex;
+        bool active = true;
+    };
+    void scheduleSlice(std::chrono::microseconds delay);
+    void runSlice();
+
+    std::unique_ptr<PipelineStage> makeStage(const std::string& name,
+                                             QueueInterface<DecodedFrame>& in,
+                                             QueueInterface<DecodedFrame>& out,
+                                             std::shared_ptr<AIGate> poolGate = nullptr);
+    AIGateOptions aiGateOptions() const;
+
+    const Config& m_config;
+    std::string m_name;
+    Executor* m_executor;
+    InferenceBatcher* m_batcher;
+    std::shared_ptr<SliceControl> m_slice;
+    std::chrono::microseconds m_idleDelay{0};
+
+    // In pipeline order: one into each stage (a pool adds its workers -> reorderer
+    // link), the last one feeds the encoder (or the sink, or the ladder)
+    std::vector<std::unique_ptr<QueueInterface<DecodedFrame>>> m_frameLinks;
+    std::vector<std::string> m_linkNames;
+    BufferQueue<EncodedPacket> m_packetQueue;
+
+    std::unique_ptr<DetectionBus> m_bus;
+    std::unique_ptr<VideoCapture> m_capture;
+    std::vector<Stage> m_stages;
+    std::unique_ptr<VideoEncoder> m_encoder;        // null in passthrough and with renditions
+    std::unique_ptr<VideoStreamer> m_streamer;      // null with renditions
+    std::vector<Rendition> m_renditions;
+};
@@ -0,0 +1,27 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// What Pipeline needs from an analysis stage between capture and the encoder
+// (motion, ai, tracker, overlay). A stage either owns a thread that pops
+// DecodedFrames from its input queue and forwards every one of them to its
+// output queue (start), or runs without one and is driven through poll() by
+// a shared Executor (startPolled).
+
+#pragma once
+
+#include <cstddef>
+
+class PipelineStage {
+public:
+    virtual ~PipelineStage() = default;
+
+    virtual void start() = 0;
+    virtual void startPolled() = 0;
+    virtual void stop() = 0;
+    virtual bool isRunning() const = 0;
+
+    // Polled mode: handle up to 'budget' frames that are already queued, never
+    // blocking. Stops early when the output queue has no room left, so a full
+    // link parks the stage instead of the executor thread. Returns frames handled.
+    virtual size_t poll(size_t budget) = 0;
+};
@@ -0,0 +1,78 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+// How long a stage parks on a queue before it re-checks its own running flag.
+constexpr std::chrono::milliseconds kQueueWait{100};
+
+// Default ring size for a pipeline link, rounded up to a power of two.
+constexpr size_t kDefaultQueueCapacity = 128;
+
+// Keeps producer-owned and consumer-owned fields off each other's cache line.
+constexpr size_t kCacheLineSize = 64;
+
+// What enqueue() does when the consumer has fallen behind and the ring is full.
+enum class OverflowPolicy {
+    Block,       // wait for space (the old behaviour), back-pressure the producer
+    DropNewest,  // discard the incoming item
+    DropOldest,  // evict the oldest queued item to make room
+    KeepGop      // packet links: evict whole GOPs, never hand out a GOP without its keyframe
+};
+
+struct QueueStats {
+    uint64_t enqueued      = 0;
+    uint64_t droppedNewest = 0;
+    uint64_t droppedOldest = 0;
+
+    uint64_t dropped() const { return droppedNewest + droppedOldest; }
+};
+
+// Common face of the pipeline links, so a stage doesn't care whether it sits
+// on a single-producer/single-consumer BufferQueue or on an MpmcQueue shared
+// by a pool of workers. One virtual call per frame is noise next to a decode.
+template <typename T>
+class QueueInterface {
+public:
+    using DropHandler  = std::function<void(T&)>;
+    using KeyPredicate = std::function<bool(const T&)>;
+
+    virtual ~QueueInterface() = default;
+
+    virtual size_t capacity() const = 0;
+    virtual size_t size() const = 0;
+
+    virtual bool push(T&& item) = 0;
+    virtual std::optional<T> pop() = 0;
+
+    // Returns false on timeout or shutdown, 'item' then stays with the caller.
+    virtual bool pushBlocking(T&& item, std::chrono::milliseconds timeout) = 0;
+
+    // 'ticket', if given, receives the item's position in dequeue order. Only a
+    // ticketed MpmcQueue under Block or DropNewest hands them out densely (one
+    // per item, no holes), which is what FrameReorderer needs to put a worker
+    // pool's results back in order. Evicting queues (BufferQueue with DropOldest
+    // or KeepGop, an unticketed MpmcQueue with DropOldest) skip the tickets of
+    // evicted items: don't put a reorderer behind one.
+    virtual std::optional<T> popBlocking(std::chrono::milliseconds timeout, uint64_t* ticket = nullptr) = 0;
+
+    virtual void setOverflowPolicy(OverflowPolicy policy, DropHandler onDrop, KeyPredicate isKey = nullptr) = 0;
+    virtual OverflowPolicy overflowPolicy() const = 0;
+
+    // Producer side push that applies the overflow policy. Returns true once the
+    // queue has taken ownership of 'item', whether it was stored or dropped.
+    // Only Block can return false (timeout or shutdown), leaving 'item' with the caller.
+    virtual bool enqueue(T&& item, std::chrono::milliseconds timeout) = 0;
+
+    virtual QueueStats stats() const = 0;
+
+    // Wakes every blocked caller and makes the blocking calls return immediately.
+    virtual void shutdown() = 0;
+    virtual bool isShutdown() const = 0;
+};
@@ -0,0 +1,70 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Last stage of an ABR ladder: one decoded frame in, one frame per rendition
+// out, each to its own encoder. The renditions are scaled as a cascade, the
+// largest from the decoded picture and every smaller one from the rendition
+// above it, so 360p is a cheap pass over 720p instead of another pass over
+// the 4K source. A rendition that already matches its input is shared by
+// reference, not copied. The encoders (one thread each) do the rest in parallel.
+
+#pragma once
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <frame_pool.hpp>
+#include <logger.hpp>
+#include <pipeline_stage.hpp>
+#include <queue_interface.hpp>
+#include <video_capture.hpp> // for DecodedFrame
+
+struct RenditionTarget {
+    int width;
+    int height;
+    QueueInterface<DecodedFrame>* queue; // into this rendition's encoder
+};
+
+class RenditionScaler : public PipelineStage {
+public:
+    RenditionScaler(QueueInterface<DecodedFrame>& inQueue,
+                    const std::vector<RenditionTarget>& targets,
+                    AVPixelFormat format = AV_PIX_FMT_YUV420P);
+    ~RenditionScaler();
+
+    void start() override;
+    void startPolled() override;
+    void stop() override;
+    bool isRunning() const override { return m_running.load(); }
+    size_t poll(size_t budget) override;
+
+private:
+    struct Level {
+        RenditionTarget target;
+        SwsContext* swsCtx = nullptr;       // sws_getCachedContext rebuilds it on input changes
+        std::shared_ptr<FramePool> pool;    // one per size, a pool only holds one geometry
+        AVFrame* out = nullptr;             // this frame's output, until forwarded
+    };
+
+    void scalerLoop();
+    void process(DecodedFrame& df);
+    AVFrame* scale(const AVFrame* src, Level& level);
+    bool roomLeft() const;
+    void forward(QueueInterface<DecodedFrame>& out, DecodedFrame& df);
+
+    QueueInterface<DecodedFrame>& m_inQueue;
+    std::vector<Level> m_levels;            // largest first
+    AVPixelFormat m_format;
+    uint64_t m_framesShared = 0;
+    uint64_t m_framesScaled = 0;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+};
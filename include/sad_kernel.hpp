@@ -0,0 +1,26 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Sum of absolute differences between two 8-bit planes, the core of motion
+// detection. The x86 builds carry SSE2, AVX2 and AVX-512BW (psadbw) versions
+// and pick the widest one the CPU supports the first time it is called;
+// everything else uses the scalar loop.
+
+#pragma once
+
+#include <cstdint>
+
+// Sum of |a - b| over a width x height plane. Strides are in bytes.
+// Exact integer result, so callers can divide once and get the same value
+// the old per-pixel double loop produced.
+uint64_t sumAbsDiff(const uint8_t* a, int strideA,
+                    const uint8_t* b, int strideB,
+                    int width, int height);
+
+// Portable reference, also used for row tails by the SIMD versions.
+uint64_t sumAbsDiffScalar(const uint8_t* a, int strideA,
+                          const uint8_t* b, int strideB,
+                          int width, int height);
+
+// Name of the implementation sumAbsDiff() dispatches to ("avx512bw", "avx2", "sse2" or "scalar").
+const char* sumAbsDiffKernelName();
@@ -0,0 +1,71 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// SORT (Bewley et al. 2016): one constant-velocity Kalman filter per object
+// over [cx, cy, area, aspect, vcx, vcy, varea], detections matched to the
+// predicted boxes by IoU. Between detections the tracks simply coast on their
+// prediction, which is what lets the detector run on every Nth frame only.
+// Matching is greedy on the best IoU pairs (same class only) rather than the
+// Hungarian solve, there are only ever a handful of objects per camera.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include <detection.hpp>
+
+struct SortOptions {
+    int maxAge = 30;            // frames a track survives without a matching detection
+    int minHits = 3;            // detections before a track is reported
+    float iouThreshold = 0.3f;  // minimum IoU to match a detection to a track
+};
+
+class SortTracker {
+public:
+    explicit SortTracker(const SortOptions& options = SortOptions());
+
+    // Advance one frame. With 'detections' (a frame the detector ran on) the
+    // tracks are corrected and new ones started; without, they only predict.
+    // Returns the confirmed live tracks, trackId set, in frame coordinates.
+    const std::vector<DetectionBox>& step(const std::vector<DetectionBox>* detections);
+
+    size_t liveTracks() const { return m_tracks.size(); }
+
+private:
+    static constexpr int kState = 7;
+    static constexpr int kMeas  = 4;
+    using State = std::array<float, kState>;
+    using Cov   = std::array<std::array<float, kState>, kState>;
+
+    struct Track {
+        int id;
+        int classId;
+        float confidence;
+        State x;
+        Cov P;
+        int hits = 1;
+        int timeSinceUpdate = 0;
+    };
+
+    Track startTrack(const DetectionBox& det);
+    void predict(Track& t) const;
+    void correct(Track& t, const DetectionBox& det) const;
+    static DetectionBox toBox(const Track& t);
+    static std::array<float, kMeas> toMeasurement(const DetectionBox& det);
+    static float iou(const DetectionBox& a, const DetectionBox& b);
+
+    SortOptions m_options;
+    std::vector<Track> m_tracks;
+    int m_nextId = 1;
+    int m_frameCount = 0;
+
+    // Scratch, kept between frames
+    struct Pair { float iou; int track; int det; };
+    std::vector<Pair> m_pairs;
+    std::vector<DetectionBox> m_predicted;
+    std::vector<char> m_trackMatched;
+    std::vector<char> m_detMatched;
+    std::vector<DetectionBox> m_output;
+};
@@ -0,0 +1,78 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Warm standby for VideoCapture: a second connection (the camera's backup URL,
+// or its substream) opened, probed and read on a thread of its own while the
+// capture runs on the first. When the active connection drops, the capture
+// takes this one over as is, along with the packets since its last keyframe,
+// so the decoder has a picture right away instead of after a reconnect plus
+// a GOP. The standby then goes on warming up the URL that just failed.
+// It costs a second stream's worth of bandwidth per camera.
+
+#pragma once
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct StandbyConnection {
+    std::string url;
+    AVFormatContext* fmtCtx = nullptr;
+    int videoStreamIndex = -1;
+    std::vector<AVPacket*> gop; // video packets since the last keyframe, oldest first; owned
+};
+
+class StandbyInput {
+public:
+    // Opens and probes a URL, null on failure
+    using Opener = std::function<AVFormatContext*(const std::string& url)>;
+
+    // 'running' is the capture's flag; the standby winds down with it
+    StandbyInput(const std::string& url, Opener opener, const std::atomic<bool>& running,
+                 std::chrono::milliseconds retryDelay, size_t maxGopPackets = 300);
+    ~StandbyInput();
+
+    StandbyInput(const StandbyInput&) = delete;
+    StandbyInput& operator=(const StandbyInput&) = delete;
+
+    void start();
+    void stop();
+
+    // Hands over the live connection if there is one, waiting up to 'wait' for
+    // the reader to finish its current packet. The standby then warms up 'nextUrl'.
+    bool take(StandbyConnection& out, const std::string& nextUrl, std::chrono::milliseconds wait);
+
+    bool ready() const;
+
+private:
+    void run();
+    bool active() const;
+    void closeConnection();
+    void cachePacket(const AVPacket* packet);
+
+    Opener m_opener;
+    const std::atomic<bool>& m_running;
+    std::chrono::milliseconds m_retryDelay;
+    size_t m_maxGopPackets;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::string m_url;
+    std::string m_nextUrl;
+    StandbyConnection m_conn;     // only the reader touches m_conn.fmtCtx while it is ready
+    bool m_ready = false;
+    bool m_wantHandover = false;  // take() is waiting
+    bool m_handedOver = false;    // reader let go of m_conn, take() may move it
+    std::atomic<bool> m_stop{false};
+
+    std::thread m_thread;
+};
@@ -0,0 +1,44 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Codec parameters and time base of the packets a VideoStreamer gets, published
+// by whoever makes them: VideoCapture for passthrough (the camera's stream), or
+// VideoEncoder once it has opened. The output stream is a copy of these. Capture
+// republishes on every (re)connect; the generation tells the streamer when the
+// parameters may have changed under it, and that the timestamps start over.
+
+#pragma once
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <cstdint>
+#include <mutex>
+
+// Same codec, size, pixel format and extradata: a decoder or muxer set up for
+// one takes the other's packets as they are
+bool sameCodecParameters(const AVCodecParameters* a, const AVCodecParameters* b);
+
+class StreamInfo {
+public:
+    StreamInfo();
+    ~StreamInfo();
+
+    StreamInfo(const StreamInfo&) = delete;
+    StreamInfo& operator=(const StreamInfo&) = delete;
+
+    void publish(const AVCodecParameters* codecpar, AVRational timeBase);
+
+    // Copies the parameters into 'codecpar'. False until the first publish().
+    bool get(AVCodecParameters* codecpar, AVRational& timeBase, uint64_t& generation) const;
+
+    // 0 until the first publish()
+    uint64_t generation() const;
+
+private:
+    mutable std::mutex m_mutex;
+    AVCodecParameters* m_codecpar = nullptr;
+    AVRational m_timeBase{0, 1};
+    uint64_t m_generation = 0;
+};
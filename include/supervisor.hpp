@@ -0,0 +1,73 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+// Runs every camera of the config in one process: one Pipeline per camera,
+// all of their analysis stages on one shared Executor, instead of a process
+// and a handful of threads per camera. Also the one place to read the health
+// and throughput of all of them.
+//
+// Capture, encoders and streamers still have their own threads per camera, and
+// the codecs' own thread pools come on top. With more than one camera, decoder
+// and encoder threads the config leaves unset are shared out (cores / cameras,
+// at least one) instead of every codec starting one per core.
+//
+// With aiSharedBatch the ai stages of all cameras infer on one InferenceBatcher:
+// one copy of the model, and forward passes that batch frames across cameras.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <config.hpp>
+#include <executor.hpp>
+#include <inference_batcher.hpp>
+#include <pipeline.hpp>
+
+struct StreamMetrics {
+    std::string name;
+    bool running = false;
+    uint64_t framesCaptured = 0;
+    uint64_t dropped = 0;
+    CaptureStats capture;
+};
+
+struct SupervisorMetrics {
+    std::vector<StreamMetrics> streams;
+    ExecutorStats executor;
+};
+
+class Supervisor {
+public:
+    // Without camera lines the config's own inputUrl/outputUrl make the only camera
+    explicit Supervisor(const Config& config);
+    ~Supervisor();
+
+    void start();
+    void stop();
+
+    size_t streams() const { return m_pipelines.size(); }
+    // Logs cameras that went down since the last call, returns how many are still up
+    size_t checkStreams();
+
+    uint64_t droppedItems() const;
+    SupervisorMetrics metrics() const;
+    // Per camera fps since the last call, executor load
+    void logMetrics();
+    void logQueueStats() const;
+
+private:
+    // Unset decoder/encoder thread counts -> this camera's share of the cores
+    static void shareCodecThreads(Config& cfg, size_t cameras);
+
+    std::vector<std::unique_ptr<Config>> m_configs; // one per camera, the pipelines keep references
+    std::unique_ptr<Executor> m_executor;           // declared before the pipelines, so it outlives them
+    std::unique_ptr<InferenceBatcher> m_batcher;    // aiSharedBatch only; outlives them too
+    std::vector<std::unique_ptr<Pipeline>> m_pipelines;
+
+    std::vector<bool> m_reportedDown;
+    std::vector<uint64_t> m_lastFrames;
+    std::chrono::steady_clock::time_point m_lastMetrics;
+};
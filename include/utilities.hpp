@@ -3,12 +3,89 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <thread>
 
+#ifdef __linux__
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 
 inline void sleepMs(int ms) {
     std::this_thread::sleep_for(std::chrono::milliseconds(ms));
 }
 
+// Sleep until 'word' no longer holds 'expected', someone calls wakeAll() on it,
+// or the timeout runs out. Spurious returns are allowed, so callers must re-check
+// their own condition. On Linux this is a private futex, elsewhere a short nap.
+inline void futexWait(std::atomic<uint32_t>& word, uint32_t expected,
+                      std::chrono::nanoseconds timeout) {
+    if (timeout.count() <= 0) return;
+#ifdef __linux__
+    timespec ts;
+    ts.tv_sec  = static_cast<time_t>(timeout.count() / 1000000000LL);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000LL);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE,
+            expected, &ts, nullptr, 0);
+#else
+    if (word.load(std::memory_order_acquire) == expected) {
+        std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(
+            timeout, std::chrono::microseconds(200)));
+    }
+#endif
+}
+
+inline void futexWakeAll(std::atomic<uint32_t>& word) {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE,
+            INT_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+// Store-then-load fence pair for a fast path that runs all the time and a slow
+// path that rarely does (a queue's notify vs. a thread going to sleep). The light
+// side is only a compiler barrier; the heavy side uses membarrier(2) to run a full
+// fence on every thread of the process, which makes up for it. Without membarrier
+// both sides are plain seq_cst fences.
+inline bool membarrierReady() {
+#ifdef __linux__
+    static const bool ready = [] {
+        const long cmds = syscall(SYS_membarrier, MEMBARRIER_CMD_QUERY, 0, 0);
+        return cmds > 0 && (cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED) != 0 &&
+               syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+    }();
+    return ready;
+#else
+    return false;
+#endif
+}
+
+inline void lightFence() {
+    if (membarrierReady()) {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    } else {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+inline void heavyFence() {
+#ifdef __linux__
+    if (membarrierReady()) {
+        syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+        return;
+    }
+#endif
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
 // We can add more utility helpers here if needed and dependant of the problem we are solving.
@@ -6,47 +6,251 @@
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
 }
 
 #include <string>
 #include <thread>
 #include <atomic>
-#include <logger.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
 #include <buffer_queue.hpp>
+#include <detection.hpp>
+#include <encoded_packet.hpp>
+#include <jitter_buffer.hpp>
+#include <logger.hpp>
+#include <queue_interface.hpp>
+#include <frame_pool.hpp>
+#include <standby_input.hpp>
+#include <stream_info.hpp>
 
 // IE. A container to pass decoded frames
 struct DecodedFrame {
     AVFrame* frame = nullptr;
     int64_t pts    = 0;
+    AVRational timeBase{0, 1}; // what 'pts' counts in, the input stream's; {0, 1} = unknown
+    uint64_t seq   = 0; // dequeue ticket, lets FrameReorderer restore order after a worker pool
+    std::shared_ptr<FramePool> pool; // where 'frame' goes back to, empty if it was av_frame_alloc'd
+
+    // Stamped by MotionDetector with its latest verdict. Frames it didn't
+    // analyse carry the previous one; motionEvaluated stays false until the first.
+    bool motionEvaluated = false;
+    bool motion          = false;
+    double motionScore   = 0.0;
+    std::vector<double> motionZoneScores; // per zone, row-major; empty with a single zone (= motionScore)
+
+    // Filled by AIDetector, in frame pixel coordinates; 'inferred' says the detector
+    // ran on this frame. ObjectTracker replaces them with its tracks on every frame.
+    bool inferred = false;
+    std::vector<DetectionBox> detections;
+
+    // Decoder surface behind 'frame', kept for a hardware encoder to take as is.
+    // Only good while frame->data[0] is still 'hwPixels': a stage that draws
+    // makes the frame writable, which copies it off the read-only mapping.
+    AVFrame* hwFrame = nullptr;
+    const uint8_t* hwPixels = nullptr;
+};
+
+// Whoever consumes a frame last hands it back through here instead of av_frame_free().
+inline void releaseDecodedFrame(DecodedFrame& df) {
+    releaseFrame(df.pool, df.frame);
+    df.frame = nullptr;
+    av_frame_free(&df.hwFrame);
+    df.hwPixels = nullptr;
+}
+
+// Which packets get decoded into the capture queue
+enum class DecodeMode {
+    All,        // every frame, what the encoder needs
+    Keyframes,  // keyframes only, for analysis next to a passthrough
+    None        // nothing: pure passthrough, no decoder is even opened
+};
+
+DecodeMode parseDecodeMode(const std::string& name);
+
+// Where the decoder runs
+enum class HwDecode {
+    None,   // software, on decoderThreads threads
+    Auto,   // VAAPI, then QSV, then software
+    Vaapi,
+    Qsv
+};
+
+HwDecode parseHwDecode(const std::string& name);
+// frame, slice or auto (both) -> FF_THREAD_* flags
+int parseDecoderThreadType(const std::string& name);
+
+// Demuxer/network settings for avformat_open_input. Zero, empty or -1 keeps FFmpeg's default.
+struct InputOptions {
+    std::string rtspTransport;        // tcp, udp, udp_multicast or http
+    int64_t probeSize = 0;            // bytes avformat_find_stream_info may read
+    int64_t analyzeDurationUs = 0;    // stream time it may read
+    bool noBuffer = false;            // fflags nobuffer: don't hold packets back while probing
+    int bufferSize = 0;               // UDP receive buffer, bytes
+    int64_t maxDelayUs = -1;          // demuxer reorder delay (RTP)
+    int reorderQueueSize = -1;        // RTP packets held for reordering
+    int64_t timeoutUs = 0;            // socket timeout: a dead camera errors out instead of hanging
+    bool cacheStreamInfo = true;      // reconnects reuse the first probe instead of probing again
+
+    // Our own reorder window on top of the demuxer's, 0 = off
+    int jitterBufferMs = 0;
+    size_t jitterBufferPackets = 64;
+};
+
+// Connection health, for the metrics
+struct CaptureStats {
+    uint64_t connects = 0;            // successful opens, the first one included
+    uint64_t probesSkipped = 0;       // opens served from the cached stream info
+    uint64_t failovers = 0;           // switches to the warm standby
+    double lastOpenMs = 0.0;          // avformat_open_input to decoder ready
+    double lastFirstFrameMs = 0.0;    // start of the open to the first picture out
+    double lastOutageMs = 0.0;        // stream lost to the first picture after reconnecting
+    JitterStats jitter;
+};
+
+struct CaptureOptions {
+    DecodeMode decode = DecodeMode::All;
+    InputOptions input;
+
+    // Reconnects back off exponentially from here up to reconnectDelaySecs, with jitter
+    int reconnectInitialMs = 250;
+    // Second URL for the same camera, kept open and streaming on the side; empty = none
+    std::string standbyUrl;
+
+    // Analysis-only decodes (nothing gets encoded from these frames), all off by default:
+    double analysisFps = 0.0;    // > 0: pictures wanted per second, packets that can go are dropped before decode
+    int lowres = 0;              // decode at 1/2^n size, if the decoder supports it
+    bool skipLoopFilter = false; // skip deblocking: blockier pictures, noticeably cheaper decode
+
+    // Software decoder threading. Frame threads scale on the single-slice streams most
+    // cameras send but delay every picture by one frame per thread; slice threads don't.
+    // Keyframe-only and analysisFps decodes always use slice threads.
+    int decoderThreads = 0;      // 0 = one per core
+    int decoderThreadType = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+    // Hardware decode. Anything that doesn't work out (no device, no hw decoder for the
+    // codec, a failure on the first frames) drops back to software for good.
+    HwDecode hwDecode = HwDecode::None;
+    std::string hwDevice;        // e.g. /dev/dri/renderD129, empty = the default one
+    bool hwMap = true;           // map surfaces instead of copying them out; keeps a surface per frame in flight
+    int hwExtraFrames = 8;       // surfaces on top of what the decoder needs; at most this many mapped frames in flight, the rest is copied
+    AVPixelFormat outputFormat = AV_PIX_FMT_NONE; // what hw frames come out as, NONE = the surface's own (nv12 mostly)
+    bool keepHwFrames = false;   // also hand on the surface itself (DecodedFrame::hwFrame), for zero-copy encode
+
+    // Passthrough: every video packet also goes here untouched, and the stream's
+    // codec parameters are published to 'streamInfo' for the muxer
+    BufferQueue<EncodedPacket>* packetQueue = nullptr;
+    std::shared_ptr<StreamInfo> streamInfo;
 };
 
 class VideoCapture {
 public:
     VideoCapture(const std::string& inputUrl,
-                 BufferQueue<DecodedFrame, 128>& captureQueue,
+                 QueueInterface<DecodedFrame>& captureQueue,
                  bool reconnectOnFailure,
-                 int reconnectDelaySecs);
+                 int reconnectDelaySecs,
+                 const CaptureOptions& options = CaptureOptions());
     ~VideoCapture();
 
     void start();
     void stop();
     bool isRunning() const { return m_running.load(); }
 
+    FramePoolStats framePoolStats() const { return m_framePool->stats(); }
+    CaptureStats stats() const;
+
 private:
     void captureLoop();
+    static int interruptCallback(void* opaque);
+    AVDictionary* inputOptions(const std::string& url) const;
+    AVFormatContext* openInput(const std::string& url);
     bool openStream();
+    bool setupStream(bool fromCache);
+    bool takeStandby(AVFrame*& frame);
+    std::chrono::milliseconds nextBackoff();
+    bool waitForRetry(std::chrono::milliseconds delay);
+    bool openDecoder(const AVCodecParameters* codecPar);
+    bool setupHwDecode(const AVCodec*& codec);
+    bool ensureHwDevice(AVHWDeviceType type);
+    // 'token' is set when the frame maps the surface, it counts it in m_surfacesOut while alive
+    AVFrame* downloadFrame(const AVFrame* hwFrame, AVBufferRef*& token);
+    void fallBackToSoftware(const std::string& reason);
     void closeStream();
+    void closeInput();
+    void closeDecoder();
+    void handlePacket(const AVPacket* packet, AVFrame*& frame);
+    void drainJitterBuffer(AVFrame*& frame, bool flush);
+    void markOpened(bool fromCache);
+    void markFirstOutput();
+    void markStreamLost();
+    void forwardPacket(const AVPacket* packet);
+    bool shouldDecode(const AVPacket* packet);
+    bool frameDue(const AVFrame* frame);
+    void decodePacket(const AVPacket* packet, AVFrame*& frame);
 
 private:
     std::string m_inputUrl;
+    std::string m_currentUrl;       // m_inputUrl, or the standby URL after a failover
     bool m_reconnectOnFailure;
-    int m_reconnectDelaySecs;
+    int m_reconnectDelaySecs;       // backoff cap
 
-    BufferQueue<DecodedFrame, 128>& m_captureQueue;
+    // Reconnect backoff, interruptible by stop()
+    int m_reconnectAttempts = 0;    // since the stream last delivered
+    std::mt19937 m_rng;
+    std::mutex m_waitMutex;
+    std::condition_variable m_waitCv;
+    std::unique_ptr<StandbyInput> m_standby;
+
+    QueueInterface<DecodedFrame>& m_captureQueue;
+    CaptureOptions m_options;
 
     AVFormatContext* m_fmtCtx = nullptr;
     AVCodecContext*  m_codecCtx = nullptr;
     int m_videoStreamIndex = -1;
+    AVRational m_timeBase{0, 1};    // the open video stream's, stamped on every frame
+
+    // The first full probe of the video stream, so reconnects can skip avformat_find_stream_info
+    AVCodecParameters* m_cachedPar = nullptr;
+    std::string m_cachedUrl;
+    // What the open decoder was set up for; a reconnect with the same parameters keeps it
+    AVCodecParameters* m_decoderPar = nullptr;
+    JitterBuffer m_jitter;
+
+    // Startup/outage timing
+    std::chrono::steady_clock::time_point m_openStart;
+    std::chrono::steady_clock::time_point m_lostAt;
+    bool m_awaitingFirst = false;   // opened, nothing came out yet
+    bool m_lost = false;            // was up, went down, not back yet
+    mutable std::mutex m_statsMutex;
+    CaptureStats m_stats;
+
+    // Kept across reconnects, opening a device isn't free
+    AVBufferRef* m_hwDevice = nullptr;
+    bool m_hwActive = false;       // current decoder was opened on m_hwDevice
+    bool m_hwDisabled = false;     // hw decode failed once, software from now on
+    uint64_t m_hwFramesOut = 0;    // surfaces handed on since the decoder was opened
+    // Decoder surfaces pinned downstream by mapped frames (and their hwFrame). The
+    // decoder pool only has hwExtraFrames to spare; at that count frames are copied out.
+    // Shared, the last frame can come back after we're gone.
+    std::shared_ptr<std::atomic<int>> m_surfacesOut = std::make_shared<std::atomic<int>>(0);
+    bool m_copyingOut = false;
+
+    // Reduced-rate decode, in stream time base. Dropping a reference frame breaks
+    // the chain until the next keyframe, so that is only done when the keyframes
+    // alone come often enough for analysisFps.
+    int64_t m_analysisInterval = 0;           // 0: every frame
+    int64_t m_nextDue = AV_NOPTS_VALUE;       // earliest pts of the next picture we pass on
+    int64_t m_lastKeyPts = AV_NOPTS_VALUE;
+    int64_t m_gopDuration = 0;                // keyframe spacing seen so far, 0 = unknown
+    bool m_chainBroken = false;               // dropped a reference since the last keyframe
+    uint64_t m_packetsSkipped = 0;
+
+    // Outlives reconnects, frames in flight keep it alive after we're gone
+    std::shared_ptr<FramePool> m_framePool;
 
     std::thread m_thread;
     std::atomic<bool> m_running{false};
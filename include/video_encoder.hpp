@@ -3,37 +3,56 @@
 
 // Encodes raw frames using configurable codec settings for H.264, H.265, and AV1.
 // Parameters like bitrate, GOP size, and resolution were abstracted into reusable CodecConfig structures,
-// allowing easy tuning for different environments.
+// allowing easy tuning for different environments (codec_config.hpp).
+//
+// Hardware encode (VAAPI or QSV) opens on the first frame. If that frame comes
+// with its decoder surface and the right size, the encoder shares the decoder's
+// surfaces and encodes them where they are; otherwise frames are converted to
+// the surface format and uploaded once each. No device or encoder, or a failure
+// opening it, falls back to the software encoder.
 
 #pragma once
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavutil/frame.h>
+#include <libavutil/hwcontext.h>
 #include <libswscale/swscale.h>
 }
 
-#include <thread>§
+#include <thread>
 #include <atomic>
+#include <memory>
 #include <string>
 #include <buffer_queue.hpp>
+#include <codec_config.hpp>
+#include <encoded_packet.hpp>
+#include <frame_pool.hpp>
 #include <logger.hpp>
 #include <motion_detector.hpp> // for DecodedFrame
+#include <stream_info.hpp>
 
-// Encoded packet container
-struct EncodedPacket {
-    AVPacket* packet = §nullptr;
+enum class HwEncode { None, Auto, Vaapi, Qsv };
+
+// none, auto, vaapi or qsv; throws on anything else
+HwEncode parseHwEncode(const std::string& name);
+
+struct HwEncodeOptions {
+    HwEncode mode = HwEncode::None;
+    std::string device;     // e.g. /dev/dri/renderD128, empty = the default one
 };
 
 class VideoEncoder {
 public:
-    VideoEncoder(BufferQueue<DecodedFrame, 128>& inQueue,
-                 BufferQueue<EncodedPacket, 128>& outQueue,
+    VideoEncoder(QueueInterface<DecodedFrame>& inQueue,
+                 BufferQueue<EncodedPacket>& outQueue,
                  int width,
                  int height,
                  int fps,
                  const std::string& codecName,
-                 bool hwAccel);
+                 const HwEncodeOptions& hw = HwEncodeOptions(),
+                 const CodecConfig& codec = CodecConfig(),
+                 std::shared_ptr<StreamInfo> streamInfo = nullptr); // gets the codec parameters once open
     ~VideoEncoder();
 
     void start();
@@ -42,20 +61,61 @@ public:
 
 private:
     void encodingLoop();
-    bool initEncoder();
+    // 'hwInput': the first frame's decoder surface, if any, for a hardware encoder to share
+    bool initEncoder(const AVFrame* hwInput = nullptr);
+    bool initHwEncoder(const AVFrame* hwInput);
+    bool openHwEncoder(const AVCodec* codec, AVHWDeviceType type, const AVFrame* hwInput);
+    // A pool of m_width x m_height surfaces on m_hwDevice, null on failure
+    AVBufferRef* allocSurfaces(AVPixelFormat hwFormat, AVPixelFormat swFormat);
+    // The frame as the hardware encoder takes it: the decoder surface, or an upload. Null on failure.
+    AVFrame* hwInputFrame(DecodedFrame& df);
+    // Rate control, GOP, threads and the codec's private options from m_codec
+    void applyCodecConfig(const AVCodec* codec);
+    // Hands the open encoder's parameters (extradata included) to the streamer
+    void publishStreamInfo();
     void closeEncoder();
+    // Frame in the encoder's size and pixel format: 'src' itself when it already
+    // is, else a scaled/converted copy from m_scalePool. Null on failure.
+    AVFrame* convertFrame(AVFrame* src);
+    // df.pts in the encoder's time base, kept increasing across input timestamp resets
+    int64_t encoderPts(const DecodedFrame& df);
 
-    BufferQueue<DecodedFrame, 128>& m_inQueue;
-    BufferQueue<EncodedPacket, 128>& m_outQueue;
+    QueueInterface<DecodedFrame>& m_inQueue;
+    BufferQueue<EncodedPacket>& m_outQueue;
 
     int m_width;
     int m_height;
     int m_fps;
     std::string m_codecName;
-    bool m_hwAccel;
+    HwEncodeOptions m_hw;
+    CodecConfig m_codec;
+    std::shared_ptr<StreamInfo> m_streamInfo;
 
     AVCodecContext* m_codecCtx = nullptr;
-    SwsContext*     m_swsCtx   = nullptr;
+    SwsContext*     m_swsCtx   = nullptr;   // sws_getCachedContext rebuilds it when the input changes
+    AVPixelFormat   m_swFormat = AV_PIX_FMT_YUV420P; // what convertFrame() produces
+
+    // Hardware encode
+    AVBufferRef* m_hwDevice = nullptr;
+    AVBufferRef* m_hwFrames = nullptr;      // the encoder's input surfaces, possibly the decoder's
+    AVBufferRef* m_uploadFrames = nullptr;  // where uploads go, never the decoder's fixed pool
+    AVPixelFormat m_hwFormat = AV_PIX_FMT_NONE;
+    bool m_hwActive = false;
+    uint64_t m_framesDirect   = 0;          // decoder surfaces encoded in place
+    uint64_t m_framesUploaded = 0;
+
+    // Scaler output. The encoder keeps references to frames it still looks at,
+    // so every frame gets its own planes, recycled through the pool.
+    std::shared_ptr<FramePool> m_scalePool;
+    int m_srcFormat = -1;                   // last input geometry, to log changes
+    int m_srcWidth  = 0;
+    int m_srcHeight = 0;
+    uint64_t m_framesConverted = 0;
+    uint64_t m_framesPassed    = 0;
+
+    // Input timestamps are the camera's; a reconnect can send them back to zero
+    int64_t m_lastPts   = AV_NOPTS_VALUE;   // last pts sent, encoder time base
+    int64_t m_ptsOffset = 0;                // added to every rescaled pts since the last reset
 
     std::thread m_thread;
     std::atomic<bool> m_running{false};
@@ -11,14 +11,21 @@ extern "C" {
 #include <string>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <memory>
 #include <buffer_queue.hpp>
 #include <logger.hpp>
+#include <stream_info.hpp>
 #include <video_encoder.hpp> // this is for EncodedPacket
 
 class VideoStreamer {
 public:
-    VideoStreamer(BufferQueue<EncodedPacket, 128>& inQueue, 
-                  const std::string& outputUrl);
+    // 'source' set: the output stream copies the codec parameters published there,
+    // the camera's for passthrough or the encoder's, so the output is only opened
+    // once they are known. Without it the stream goes out without parameters.
+    VideoStreamer(BufferQueue<EncodedPacket>& inQueue,
+                  const std::string& outputUrl,
+                  std::shared_ptr<StreamInfo> source = nullptr);
     ~VideoStreamer();
 
     void start();
@@ -29,13 +36,30 @@ private:
     void streamingLoop();
     bool initOutput();
     void closeOutput();
+    bool syncWithSource(); // (re)open the output when the source parameters change
+    // Shifts the packet's timestamps (output time base) past the last one written
+    // when the source started over, so a reconnect doesn't send the muxer backwards
+    void keepMonotonic(AVPacket* pkt);
 
-    BufferQueue<EncodedPacket, 128>& m_inQueue;
+    BufferQueue<EncodedPacket>& m_inQueue;
     std::string m_outputUrl;
 
     AVFormatContext* m_fmtCtx = nullptr;
     AVStream* m_videoStream = nullptr;
 
+    std::shared_ptr<StreamInfo> m_source;
+    AVCodecParameters* m_sourcePar = nullptr;
+    AVRational m_sourceTimeBase{0, 1};
+    uint64_t m_sourceGeneration = 0;
+    std::chrono::steady_clock::time_point m_lastInitAttempt;
+    bool m_needKeyframe = false;
+
+    // Output timestamps across source restarts that kept the muxer open
+    bool m_discontinuity = false;           // the source restarted, rebase on the next packet
+    int64_t m_tsOffset = 0;                 // added to pts/dts, output time base
+    int64_t m_lastDts = AV_NOPTS_VALUE;     // last written, offset included
+    int64_t m_lastDelta = 0;                // last spacing between written dts
+
     std::thread m_thread;
     std::atomic<bool> m_running{false};
     bool m_initialized{false};
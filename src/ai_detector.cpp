@@ -1,68 +1,147 @@
 // Author: Lerato Mokoena
 // Company: Arithaoptix pty Ltd.
-// The parsing logic in runInference() depends on your model’s architecture. 
-// If you have a different model (like SSD, Faster R-CNN, or a custom ONNX), adjust accordingly. 
 
 #include <ai_detector.hpp>
+#include <inference_batcher.hpp>
+#include <mpmc_queue.hpp>
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
-AIDetector::AIDetector(BufferQueue<DecodedFrame, 128>& inQueue,
-                       BufferQueue<DecodedFrame, 128>& outQueue,
-                       const std::string& modelPath,
-                       const std::string& modelConfig,
-                       bool useGPU)
-    : m_inQueue(inQueue)
-    , m_outQueue(outQueue)
-    , m_useGPU(useGPU)
+AIDetector::InferenceContext::~InferenceContext() {
+    for (DecodedFrame& df : batch) {
+        releaseDecodedFrame(df);
+    }
+}
+
+AIGate::AIGate(const AIGateOptions& options)
+    : m_options(options)
 {
-    if (!loadModel(modelPath, modelConfig)) {
-        LOG_ERROR("AIDetector: Failed to load model!");
+    m_options.detectionStride = std::max(1, m_options.detectionStride);
+}
+
+void AIGate::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_inferredOnce = false;
+    m_passed = 0;
+}
+
+AIGate::Verdict AIGate::decide(const DecodedFrame& df, std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!passes(df, now)) {
+        return Verdict::Static;
+    }
+    // The first frame through always runs, so the tracker has something to start from
+    if (m_passed++ % static_cast<uint64_t>(m_options.detectionStride) != 0) {
+        return Verdict::Strided;
     }
+    m_lastInference = now;
+    m_inferredOnce = true;
+    return Verdict::Infer;
 }
 
-AIDetector::~AIDetector() {
-    stop();
+bool AIGate::passes(const DecodedFrame& df, std::chrono::steady_clock::time_point now) {
+    // No verdict yet (or motion detection isn't in the pipeline): can't tell, so infer
+    if (!m_options.motionGated || !df.motionEvaluated || !m_inferredOnce) {
+        return true;
+    }
+    if (df.motion) {
+        m_lastMotion = now;
+        return true;
+    }
+    // Objects that stop moving are still worth tracking for a little while
+    if (now - m_lastMotion < m_options.keepAlive) {
+        return true;
+    }
+    // Static scene, but look again now and then for whatever MotionDetector can't see
+    return now - m_lastInference >= m_options.recheckInterval;
 }
 
-bool AIDetector::loadModel(const std::string& modelPath, const std::string& modelConfig) {
-    try {
-        if (!modelConfig.empty()) {
-            // For frameworks like Caffe (prototxt + caffemodel) or TensorFlow (pb + pbtxt)
-            m_net = cv::dnn::readNet(modelPath, modelConfig);
-        } else {
-            // For ONNX or single-file models
-            m_net = cv::dnn::readNet(modelPath);
-        }
-
-        if (m_useGPU) {
-#ifdef CV_CUDNN
-            m_net.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
-            m_net.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
-            LOG_INFO("AIDetector: Using GPU inference (CUDA).");
-#else
-            LOG_WARNING("AIDetector: GPU requested but OpenCV built without CUDA. Falling back to CPU.");
-            m_net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-            m_net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
-#endif
+AIDetector::AIDetector(QueueInterface<DecodedFrame>& inQueue,
+                       QueueInterface<DecodedFrame>& outQueue,
+                       const InferenceOptions& inference,
+                       const AIGateOptions& gate,
+                       const AIBatchOptions& batch,
+                       const DecoderOptions& decode,
+                       const AIAsyncOptions& async,
+                       DetectionBus* bus,
+                       InferenceBatcher* batcher,
+                       std::shared_ptr<AIGate> sharedGate)
+    : m_inQueue(inQueue)
+    , m_outQueue(outQueue)
+    , m_inference(inference)
+    , m_gate(sharedGate ? std::move(sharedGate) : std::make_shared<AIGate>(gate))
+    , m_batch(batch)
+    , m_decode(decode)
+    , m_async(async)
+    , m_bus(bus)
+    , m_batcher(batcher)
+{
+    m_batch.maxBatch = std::max(1, m_batch.maxBatch);
+    m_async.workers = std::max(1, m_async.workers);
+
+    const int contexts = m_async.enabled ? m_async.workers : 1;
+    bool loaded = true;
+    for (int i = 0; i < contexts; ++i) {
+        m_contexts.push_back(makeContext());
+        // With a shared batcher the model is its, not ours
+        if (!m_batcher && loaded) {
+            m_contexts.back()->inference = std::make_unique<FrameInference>(m_inference, m_decode, m_batch.maxBatch);
+            if (!m_contexts.back()->inference->load()) {
+                LOG_ERROR("AIDetector: Failed to load model!");
+                loaded = false; // the others would fail the same way
+            }
+        }
+    }
+
+    if (m_async.enabled) {
+        // Frame references are cheap to drop and stale ones aren't worth inferring:
+        // one worker gets an SPSC ring that evicts the oldest, a pool shares an MPMC
+        // one that does the same. Jobs carry the frame's own seq, not a dequeue ticket.
+        const auto freeJob = [](DecodedFrame& df) { releaseDecodedFrame(df); };
+        if (m_async.workers == 1) {
+            m_jobs = std::make_unique<BufferQueue<DecodedFrame>>(m_async.queueDepth);
         } else {
-            m_net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-            m_net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
-            LOG_INFO("AIDetector: Using CPU inference.");
+            m_jobs = std::make_unique<MpmcQueue<DecodedFrame>>(m_async.queueDepth, /*ticketed=*/false);
         }
-    } catch (const cv::Exception& e) {
-        LOG_ERROR(std::string("AIDetector: Exception loading model: ") + e.what());
-        return false;
+        m_jobs->setOverflowPolicy(OverflowPolicy::DropOldest, freeJob);
     }
+}
 
-    LOG_INFO("AIDetector: Model loaded successfully.");
-    return true;
+AIDetector::~AIDetector() {
+    stop();
+}
+
+std::unique_ptr<AIDetector::InferenceContext> AIDetector::makeContext() {
+    auto ctx = std::make_unique<InferenceContext>();
+    const size_t maxBatch = static_cast<size_t>(m_batch.maxBatch);
+    ctx->batch.reserve(maxBatch);
+    ctx->wanted.reserve(maxBatch);
+    ctx->frames.reserve(maxBatch);
+    ctx->frameOwner.reserve(maxBatch);
+    return ctx;
 }
 
 void AIDetector::start() {
     if (m_running.load()) return;
+    startPolled();
+    if (m_async.enabled) {
+        m_thread = std::thread(&AIDetector::forwardLoop, this);
+    } else {
+        m_thread = std::thread(&AIDetector::detectionLoop, this);
+    }
+}
+
+void AIDetector::startPolled() {
+    if (m_running.load()) return;
+    m_gate->reset(); // a restart starts the gate over; a pool resets it once per worker, harmlessly
     m_running.store(true);
-    m_thread = std::thread(&AIDetector::detectionLoop, this);
+    // The inference workers keep their own threads either way, a forward pass is too long to share one
+    if (m_async.enabled) {
+        for (auto& ctx : m_contexts) {
+            m_workers.emplace_back(&AIDetector::workerLoop, this, std::ref(*ctx));
+        }
+    }
 }
 
 void AIDetector::stop() {
@@ -71,130 +150,231 @@ void AIDetector::stop() {
     if (m_thread.joinable()) {
         m_thread.join();
     }
-}
-
-void AIDetector::detectionLoop() {
-    while (m_running.load()) {
-        auto maybeFrame = m_inQueue.pop();
-        if (!maybeFrame.has_value()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            continue;
+    if (m_jobs) {
+        m_jobs->shutdown();
+    }
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
         }
-
-        DecodedFrame df = std::move(maybeFrame.value());
-        if (!df.frame) {
-            continue;
+    }
+    m_workers.clear();
+    if (m_jobs) {
+        // References nobody got to
+        while (auto job = m_jobs->pop()) {
+            releaseDecodedFrame(job.value());
         }
+        LOG_INFO("AIDetector: Inferred " + std::to_string(framesInferred()) + " frames, skipped " +
+                 std::to_string(framesSkipped()) + " static frames and " +
+                 std::to_string(framesStrided()) + " between detection strides, dropped " +
+                 std::to_string(jobsDropped()) + " behind the workers.");
+    } else {
+        LOG_INFO("AIDetector: Inferred " + std::to_string(framesInferred()) + " frames, skipped " +
+                 std::to_string(framesSkipped()) + " static frames and " +
+                 std::to_string(framesStrided()) + " between detection strides.");
+    }
+}
 
-        // Convert to BGR
-        cv::Mat bgr = avFrameToMat(df.frame);
+bool AIDetector::shouldInfer(const DecodedFrame& df, std::chrono::steady_clock::time_point now) {
+    switch (m_gate->decide(df, now)) {
+    case AIGate::Verdict::Static:
+        m_framesSkipped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    case AIGate::Verdict::Strided:
+        m_framesStrided.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    case AIGate::Verdict::Infer:
+        break;
+    }
+    return true;
+}
 
-        // Run inference
-        auto detections = runInference(bgr);
-        // (Optional) Draw bounding boxes
-        for (auto& det : detections) {
-            cv::rectangle(bgr,
-                cv::Rect(det.x, det.y, det.width, det.height),
-                cv::Scalar(0, 255, 0),
-                2
-            );
-            // Could also draw labels, etc.
-        }
+size_t AIDetector::collectBatch(QueueInterface<DecodedFrame>& queue, InferenceContext& ctx,
+                                bool stampTicket, bool wait, size_t limit) {
+    ctx.batch.clear();
+    const size_t maxBatch = (limit > 0) ? std::min(limit, static_cast<size_t>(m_batch.maxBatch))
+                                        : static_cast<size_t>(m_batch.maxBatch);
 
-        // If you want to encode the bounding boxes “burned in”, you must convert BGR back to YUV
-        // That’s extra overhead. Alternatively, do nothing and just send the original frame to outQueue.
+    // With several detectors on one MpmcQueue the ticket is what FrameReorderer sorts on
+    uint64_t ticket = 0;
+    auto first = queue.popBlocking(wait ? kQueueWait : std::chrono::milliseconds(0), &ticket);
+    if (!first.has_value()) {
+        return 0;
+    }
+    if (stampTicket) first->seq = ticket;
+    ctx.batch.push_back(std::move(first.value()));
 
-        while (!m_outQueue.push(std::move(df))) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    // A shared batcher does the waiting, across every camera
+    const bool fill = wait && !m_batcher;
+    const auto deadline = std::chrono::steady_clock::now() + (fill ? m_batch.maxWait : std::chrono::milliseconds(0));
+    while (ctx.batch.size() < maxBatch && m_running.load()) {
+        // Past the deadline this is a plain try-pop: take what is already queued, don't wait for more
+        const auto remaining = std::max(std::chrono::milliseconds(0),
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()));
+        auto next = queue.popBlocking(remaining, &ticket);
+        if (!next.has_value()) {
+            break;
         }
+        if (stampTicket) next->seq = ticket;
+        ctx.batch.push_back(std::move(next.value()));
     }
-    m_running.store(false);
+    return ctx.batch.size();
 }
 
-cv::Mat AIDetector::avFrameToMat(AVFrame* frame) {
-    // frame->format is likely AV_PIX_FMT_YUV420P from your pipeline
-    // We need to convert to BGR for OpenCV DNN
-    // Basic approach: use libswscale (SwsContext) or do a manual approach if you prefer.
-
-    // We'll do a quick approach using cv::Mat to wrap data:
-    // This is tricky because AVFrame is planar (Y, U, V planes).
-    // Easiest is to do a sws_scale. For brevity, we’ll do a naive approach:
-
-    cv::Mat bgr;
-    // Lerato: allocate a new AVFrame or a buffer, then sws_scale to get BGR24, then wrap in cv::Mat.
-    // For a real solution, create a SwsContext once in your constructor, reuse it for performance.
+void AIDetector::inferBatch(InferenceContext& ctx) {
+    // The frames that passed the gate
+    ctx.frames.clear();
+    ctx.frameOwner.clear();
+    for (size_t i = 0; i < ctx.batch.size(); ++i) {
+        if (ctx.batch[i].frame && ctx.wanted[i]) {
+            ctx.frames.push_back(ctx.batch[i].frame);
+            ctx.frameOwner.push_back(i);
+        }
+    }
+    if (ctx.frames.empty()) {
+        return;
+    }
 
-    // Because we want to keep code simpler, let's do a naive approach with a known function:
-    static struct SwsContext* swsCtx = nullptr;
+    // One forward pass for the whole batch (with other cameras' frames, when the
+    // batcher is shared), then scatter the boxes back to their frames
+    const bool ok = m_batcher ? m_batcher->infer(ctx.frames, ctx.results)
+                              : ctx.inference && ctx.inference->infer(ctx.frames, ctx.results);
+    if (!ok) {
+        return;
+    }
+    for (size_t k = 0; k < ctx.frameOwner.size(); ++k) {
+        DecodedFrame& df = ctx.batch[ctx.frameOwner[k]];
+        df.detections = std::move(ctx.results[k]);
+        df.inferred = true;
+        if (m_bus) {
+            DetectionEvent event;
+            event.pts = df.pts;
+            event.timeBase = df.timeBase;
+            event.seq = df.seq;
+            event.frameWidth  = df.frame->width;
+            event.frameHeight = df.frame->height;
+            event.detections  = df.detections;
+            m_bus->publish(std::move(event));
+        }
+    }
+    m_framesInferred.fetch_add(ctx.frameOwner.size(), std::memory_order_relaxed);
+}
 
-    if (!swsCtx) {
-        swsCtx = sws_getContext(
-            frame->width, frame->height, (AVPixelFormat)frame->format,
-            frame->width, frame->height, AV_PIX_FMT_BGR24,
-            SWS_BILINEAR, nullptr, nullptr, nullptr
-        );
+void AIDetector::forward(DecodedFrame& df) {
+    while (!m_outQueue.enqueue(std::move(df), kQueueWait)) {
+        if (!m_running.load() || m_outQueue.isShutdown()) {
+            releaseDecodedFrame(df);
+            break;
+        }
     }
+}
 
-    cv::Mat temp(frame->height, frame->width, CV_8UC3); // BGR24
-    uint8_t* dest[4] = { temp.data, nullptr, nullptr, nullptr };
-    int destLinesize[4] = { static_cast<int>(frame->width * 3), 0, 0, 0 };
+void AIDetector::detectionLoop() {
+    InferenceContext& ctx = *m_contexts.front();
+    while (m_running.load()) {
+        if (collectBatch(m_inQueue, ctx, true, true) == 0) {
+            continue;
+        }
+        processBatch(ctx);
+    }
+    m_running.store(false);
+}
 
-    sws_scale(swsCtx,
-              frame->data, frame->linesize,
-              0, frame->height,
-              dest, destLinesize);
+void AIDetector::processBatch(InferenceContext& ctx) {
+    const auto now = std::chrono::steady_clock::now();
+    ctx.wanted.assign(ctx.batch.size(), 0);
+    for (size_t i = 0; i < ctx.batch.size(); ++i) {
+        if (!ctx.batch[i].frame) continue;
+        if (shouldInfer(ctx.batch[i], now)) {
+            ctx.wanted[i] = 1;
+        }
+    }
+    inferBatch(ctx);
 
-    bgr = temp.clone(); // copy out if needed
-    return bgr;
+    // Frames are always forwarded, even empty ones, so the reorderer never waits on a missing ticket
+    for (DecodedFrame& df : ctx.batch) {
+        forward(df);
+    }
+    ctx.batch.clear();
 }
 
-std::vector<DetectionBox> AIDetector::runInference(const cv::Mat& bgr) {
-    std::vector<DetectionBox> results;
-
-    if (m_net.empty()) {
-        LOG_ERROR("AIDetector: Net is empty, can't run inference!");
-        return results;
+void AIDetector::forwardLoop() {
+    while (m_running.load()) {
+        uint64_t ticket = 0;
+        auto maybeFrame = m_inQueue.popBlocking(kQueueWait, &ticket);
+        if (!maybeFrame.has_value()) {
+            continue;
+        }
+        DecodedFrame df = std::move(maybeFrame.value());
+        df.seq = ticket;
+        dispatch(df);
+        forward(df);
     }
+    m_running.store(false);
+}
 
-    // The specifics here depend on your model:
-    // 1. Create a blob
-    cv::Mat blob = cv::dnn::blobFromImage(bgr, 1.0/255.0, cv::Size(640, 640), cv::Scalar(), true, false);
-    m_net.setInput(blob);
+void AIDetector::dispatch(const DecodedFrame& df) {
+    const auto now = std::chrono::steady_clock::now();
+    if (!df.frame || !shouldInfer(df, now)) {
+        return;
+    }
 
-    // 2. Forward pass
-    cv::Mat output = m_net.forward();
+    // A new reference to the same refcounted planes: nothing is copied, and whoever
+    // writes into the frame downstream has to av_frame_make_writable() first.
+    DecodedFrame job;
+    job.frame = av_frame_clone(df.frame);
+    job.pts = df.pts;
+    job.timeBase = df.timeBase;
+    job.seq = df.seq;
+    // Drop policy, never blocks; only refused once the queue is shut down
+    if (job.frame && !m_jobs->enqueue(std::move(job), kQueueWait)) {
+        releaseDecodedFrame(job);
+    }
+}
 
-    // 3. Parse output
-    // The parsing logic depends on your specific model’s output layout.
-    // For a YOLO-like model, you might have columns: [x_center, y_center, w, h, conf, classScores...]
-    // This is just a placeholder example.
+size_t AIDetector::poll(size_t budget) {
+    size_t handled = 0;
+    if (m_async.enabled) {
+        while (handled < budget && m_running.load() && m_outQueue.size() < m_outQueue.capacity()) {
+            uint64_t ticket = 0;
+            auto maybeFrame = m_inQueue.popBlocking(std::chrono::milliseconds(0), &ticket);
+            if (!maybeFrame.has_value()) {
+                break;
+            }
+            DecodedFrame df = std::move(maybeFrame.value());
+            df.seq = ticket;
+            dispatch(df);
+            forward(df);
+            ++handled;
+        }
+        return handled;
+    }
 
-    const int rows = output.size[1];
-    const int cols = output.size[2];
+    // No waiting to fill a batch here, it takes whatever is queued and has room to forward.
+    // A link after ai smaller than aiBatchSize just makes for smaller batches.
+    InferenceContext& ctx = *m_contexts.front();
+    while (handled < budget && m_running.load() && m_outQueue.size() < m_outQueue.capacity()) {
+        const size_t room = m_outQueue.capacity() - m_outQueue.size();
+        const size_t n = collectBatch(m_inQueue, ctx, true, false, room);
+        if (n == 0) {
+            break;
+        }
+        processBatch(ctx);
+        handled += n;
+    }
+    return handled;
+}
 
-    float* data = (float*)output.data;
-    for (int i = 0; i < rows; i++) {
-        float confidence = data[4];
-        if (confidence < 0.5f) { // threshold
-            data += cols;
+void AIDetector::workerLoop(InferenceContext& ctx) {
+    while (m_running.load()) {
+        if (collectBatch(*m_jobs, ctx, false, true) == 0) {
             continue;
         }
-        // parse box
-        float x = data[0];
-        float y = data[1];
-        float w = data[2];
-        float h = data[3];
-        DetectionBox db;
-        db.x = (x - w/2) * bgr.cols;   // scale to image coords
-        db.y = (y - h/2) * bgr.rows;
-        db.width  = w * bgr.cols;
-        db.height = h * bgr.rows;
-        db.confidence = confidence;
-        db.classId = (int)data[5]; // example
-
-        results.push_back(db);
-        data += cols;
+        ctx.wanted.assign(ctx.batch.size(), 1); // gated before they were queued
+        inferBatch(ctx);
+        for (DecodedFrame& job : ctx.batch) {
+            releaseDecodedFrame(job);
+        }
+        ctx.batch.clear();
     }
-
-    return results;
 }
@@ -0,0 +1,47 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <codec_config.hpp>
+
+#include <stdexcept>
+
+CodecConfig codecProfile(const std::string& name) {
+    CodecConfig cfg;
+    cfg.profile = name;
+    if (name == "live") {
+        // The defaults: every frame out as soon as it is encoded
+        return cfg;
+    }
+    if (name == "archive") {
+        cfg.rateControl  = RateControl::Crf;
+        cfg.crf          = 23;
+        cfg.gopSeconds   = 4.0;
+        cfg.bFrames      = 3;
+        cfg.sliceThreads = false;
+        cfg.lookahead    = 40;
+        cfg.preset       = "medium";
+        cfg.tune         = "";
+        return cfg;
+    }
+    if (name == "edge") {
+        cfg.rateControl  = RateControl::Crf;
+        cfg.crf          = 26;
+        cfg.gopSeconds   = 4.0;
+        cfg.threads      = 2;
+        cfg.sliceThreads = false;
+        cfg.lookahead    = 10;
+        cfg.preset       = "superfast";
+        cfg.tune         = "";
+        return cfg;
+    }
+    throw std::runtime_error("Config error: unknown encoder profile '" + name +
+                             "' (expected live, archive or edge).");
+}
+
+RateControl parseRateControl(const std::string& name) {
+    if (name == "crf") return RateControl::Crf;
+    if (name == "cbr") return RateControl::Cbr;
+    if (name == "vbr") return RateControl::Vbr;
+    throw std::runtime_error("Config error: unknown rate control '" + name +
+                             "' (expected crf, cbr or vbr).");
+}
@@ -2,17 +2,153 @@
 // Company: Arithaoptix pty Ltd.
 
 #include <config.hpp>
+#include <detection_decoder.hpp>
+#include <inference_backend.hpp>
+#include <video_capture.hpp>
+#include <video_encoder.hpp>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 
+static OverflowPolicy parseOverflowPolicy(const std::string& name) {
+    if (name == "block")      return OverflowPolicy::Block;
+    if (name == "dropNewest") return OverflowPolicy::DropNewest;
+    if (name == "dropOldest") return OverflowPolicy::DropOldest;
+    if (name == "keepGop")    return OverflowPolicy::KeepGop;
+    throw std::runtime_error("Config error: unknown queue policy '" + name +
+                             "' (expected block, dropNewest, dropOldest or keepGop).");
+}
+
+// "x,y x,y x,y ..." -> points, in normalized frame coordinates
+static std::vector<std::pair<float, float>> parsePolygon(std::istringstream& iss) {
+    std::vector<std::pair<float, float>> points;
+    std::string token;
+    while (iss >> token) {
+        float x = 0.f, y = 0.f;
+        char comma = 0;
+        std::istringstream pt(token);
+        if (!(pt >> x >> comma >> y) || comma != ',') {
+            throw std::runtime_error("Config error: bad motionExcludePolygon point '" + token +
+                                     "' (expected x,y).");
+        }
+        points.emplace_back(x, y);
+    }
+    return points;
+}
+
+// "name[:capacity][xworkers] ..." -> stages in pipeline order
+static std::vector<StageConfig> parseStages(std::istringstream& iss) {
+    std::vector<StageConfig> stages;
+    std::string token;
+    while (iss >> token) {
+        if (token == "none") {
+            continue;
+        }
+        StageConfig stage{ token, kDefaultQueueCapacity };
+        std::string rest = token;
+        const size_t x = rest.rfind('x');
+        if (x != std::string::npos && x + 1 < rest.size() &&
+            rest.find_first_not_of("0123456789", x + 1) == std::string::npos) {
+            long long workers = 0;
+            std::istringstream count(rest.substr(x + 1));
+            if (!(count >> workers) || workers <= 0) {
+                throw std::runtime_error("Config error: bad worker count in pipelineStages '" + token + "'.");
+            }
+            stage.workers = static_cast<int>(workers);
+            rest = rest.substr(0, x);
+        }
+        stage.name = rest;
+        const size_t colon = rest.find(':');
+        if (colon != std::string::npos) {
+            stage.name = rest.substr(0, colon);
+            long long capacity = 0;
+            std::istringstream cap(rest.substr(colon + 1));
+            if (!(cap >> capacity) || capacity <= 0) {
+                throw std::runtime_error("Config error: bad queue capacity in pipelineStages '" + token + "'.");
+            }
+            stage.queueCapacity = static_cast<size_t>(capacity);
+        }
+        stages.push_back(stage);
+    }
+    return stages;
+}
+
+InferenceOptions Config::inferenceOptions() const {
+    InferenceOptions inference;
+    inference.engine         = parseInferenceEngine(aiEngine);
+    inference.modelPath      = aiModelPath;
+    inference.modelConfig    = aiModelConfig;
+    inference.useGPU         = aiUseGPU;
+    inference.inputWidth     = aiInputWidth;
+    inference.inputHeight    = aiInputHeight;
+    inference.intraOpThreads = aiIntraOpThreads;
+    inference.interOpThreads = aiInterOpThreads;
+    inference.int8           = aiInt8;
+    return inference;
+}
+
+DecoderOptions Config::detectionDecoderOptions() const {
+    DecoderOptions decode;
+    decode.layout        = parseDetectionLayout(aiModelLayout);
+    decode.confThreshold = aiConfThreshold;
+    decode.nmsThreshold  = aiNmsThreshold;
+    return decode;
+}
+
+CodecConfig Config::codecConfig() const {
+    CodecConfig codec = codecProfile(encoderProfile);
+    if (!encoderRateControl.empty()) codec.rateControl    = parseRateControl(encoderRateControl);
+    if (encoderCrf >= 0)             codec.crf            = encoderCrf;
+    if (encoderBitrateKbps >= 0)     codec.bitrateKbps    = encoderBitrateKbps;
+    if (encoderMaxBitrateKbps >= 0)  codec.maxBitrateKbps = encoderMaxBitrateKbps;
+    if (encoderBufferKbits >= 0)     codec.bufferKbits    = encoderBufferKbits;
+    if (encoderGopSeconds >= 0.0)    codec.gopSeconds     = encoderGopSeconds;
+    if (encoderBFrames >= 0)         codec.bFrames        = encoderBFrames;
+    if (encoderThreads >= 0)         codec.threads        = encoderThreads;
+    if (encoderSliceThreads >= 0)    codec.sliceThreads   = (encoderSliceThreads != 0);
+    if (encoderLookahead >= 0)       codec.lookahead      = encoderLookahead;
+    if (!encoderPreset.empty())      codec.preset         = encoderPreset;
+    if (!encoderTune.empty())        codec.tune           = (encoderTune == "none" ? "" : encoderTune);
+    codec.options.insert(codec.options.end(), encoderOptions.begin(), encoderOptions.end());
+    return codec;
+}
+
 void Config::validate() const {
-    if (inputUrl.empty()) {
-        throw std::runtime_error("Config error: inputUrl is empty.");
+    if (cameras.empty()) {
+        if (inputUrl.empty()) {
+            throw std::runtime_error("Config error: inputUrl is empty.");
+        }
+        if (outputUrl.empty() && renditions.empty()) {
+            throw std::runtime_error("Config error: outputUrl is empty.");
+        }
+    }
+    for (size_t i = 0; i < cameras.size(); ++i) {
+        if (cameras[i].name.empty() || cameras[i].inputUrl.empty() || cameras[i].outputUrl.empty()) {
+            throw std::runtime_error("Config error: camera lines need a name, an inputUrl and an outputUrl.");
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (cameras[j].name == cameras[i].name) {
+                throw std::runtime_error("Config error: camera '" + cameras[i].name + "' is defined twice.");
+            }
+        }
+    }
+    if (!rtspTransport.empty() && rtspTransport != "tcp" && rtspTransport != "udp" &&
+        rtspTransport != "udp_multicast" && rtspTransport != "http") {
+        throw std::runtime_error("Config error: rtspTransport must be tcp, udp, udp_multicast or http.");
+    }
+    if (inputProbeSize < 0 || inputAnalyzeDurationMs < 0 || inputBufferSize < 0 || inputTimeoutMs < 0) {
+        throw std::runtime_error("Config error: inputProbeSize, inputAnalyzeDurationMs, inputBufferSize and "
+                                 "inputTimeoutMs cannot be negative.");
     }
-    if (outputUrl.empty()) {
-        throw std::runtime_error("Config error: outputUrl is empty.");
+    if (inputProbeSize > 0 && inputProbeSize < 32) {
+        throw std::runtime_error("Config error: inputProbeSize must be at least 32 bytes.");
+    }
+    if (jitterBufferMs < 0 || jitterBufferPackets <= 0) {
+        throw std::runtime_error("Config error: jitterBufferMs must be >= 0 and jitterBufferPackets > 0.");
+    }
+    if (executorThreads < 0 || executorSliceFrames <= 0) {
+        throw std::runtime_error("Config error: executorThreads must be >= 0 and executorSliceFrames > 0.");
     }
     if (width <= 0 || height <= 0 || fps <= 0) {
         throw std::runtime_error("Config error: Invalid width/height/fps.");
@@ -20,12 +156,172 @@ void Config::validate() const {
     if (codecName.empty()) {
         throw std::runtime_error("Config error: codecName is empty.");
     }
+    // Checked for every profile in use, the overrides apply to all of them
+    std::vector<std::string> profiles = { encoderProfile };
+    for (const auto& cameraProfile : cameraEncoderProfiles) {
+        bool known = false;
+        for (const CameraConfig& camera : cameras) {
+            known = known || camera.name == cameraProfile.first;
+        }
+        if (!known) {
+            throw std::runtime_error("Config error: cameraEncoderProfile for unknown camera '" +
+                                     cameraProfile.first + "'.");
+        }
+        profiles.push_back(cameraProfile.second);
+    }
+    for (const std::string& profile : profiles) {
+        Config resolved = *this;
+        resolved.encoderProfile = profile;
+        const CodecConfig codec = resolved.codecConfig(); // throws on unknown names
+        if (codec.crf < 0 || codec.crf > 63 || codec.gopSeconds <= 0.0) {
+            throw std::runtime_error("Config error: encoderCrf must be within 0..63 and encoderGopSeconds > 0.");
+        }
+        if (codec.tune == "zerolatency" && (codec.bFrames > 0 || codec.lookahead > 0)) {
+            throw std::runtime_error("Config error: profile '" + profile + "' tunes for zerolatency, which "
+                                     "allows no B-frames or lookahead; set encoderTune none or use another profile.");
+        }
+    }
+    if (!renditions.empty() && passthrough) {
+        throw std::runtime_error("Config error: renditions need the encoder, they cannot be combined with passthrough.");
+    }
+    for (size_t i = 0; i < renditions.size(); ++i) {
+        const RenditionConfig& r = renditions[i];
+        if (r.name.empty() || r.outputUrl.empty()) {
+            throw std::runtime_error("Config error: rendition lines need a name, a size and an outputUrl.");
+        }
+        // 4:2:0 chroma needs even sizes
+        if (r.width <= 0 || r.height <= 0 || r.width % 2 != 0 || r.height % 2 != 0 || r.bitrateKbps < 0) {
+            throw std::runtime_error("Config error: rendition '" + r.name + "' needs a positive, even width and height "
+                                     "and a bitrate >= 0.");
+        }
+        if (cameras.size() > 1 && r.outputUrl.find("{camera}") == std::string::npos) {
+            throw std::runtime_error("Config error: rendition '" + r.name + "' needs {camera} in its outputUrl "
+                                     "when there are several cameras.");
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (renditions[j].name == r.name) {
+                throw std::runtime_error("Config error: rendition '" + r.name + "' is defined twice.");
+            }
+        }
+    }
+    parseDecodeMode(analysisDecode); // throws on an unknown name
+    if (analysisFps < 0.0) {
+        throw std::runtime_error("Config error: analysisFps cannot be negative.");
+    }
+    if (decodeLowres < 0 || decodeLowres > 3) {
+        throw std::runtime_error("Config error: decodeLowres must be within 0..3.");
+    }
+    if (decoderThreads < -1) {
+        throw std::runtime_error("Config error: decoderThreads must be -1 (automatic) or more.");
+    }
+    parseDecoderThreadType(decoderThreadType); // throws on an unknown name
+    if (!hwDecode.empty()) {
+        parseHwDecode(hwDecode);
+    }
+    if (!hwEncode.empty()) {
+        parseHwEncode(hwEncode);
+    }
+    if (hwDecodeExtraFrames < 0) {
+        throw std::runtime_error("Config error: hwDecodeExtraFrames cannot be negative.");
+    }
     if (motionThreshold < 0) {
         throw std::runtime_error("Config error: motionThreshold cannot be negative.");
     }
     if (motionFrameInterval <= 0) {
         throw std::runtime_error("Config error: motionFrameInterval must be > 0.");
     }
+    if (motionDownscale != 1 && motionDownscale != 2 && motionDownscale != 4 && motionDownscale != 8) {
+        throw std::runtime_error("Config error: motionDownscale must be 1, 2, 4 or 8.");
+    }
+    if (motionZoneRows <= 0 || motionZoneCols <= 0 || motionZoneRows > 64 || motionZoneCols > 64) {
+        throw std::runtime_error("Config error: motionZoneRows/motionZoneCols must be in 1..64.");
+    }
+    if (!motionZoneMask.empty()) {
+        if (motionZoneMask.size() != static_cast<size_t>(motionZoneRows * motionZoneCols)) {
+            throw std::runtime_error("Config error: motionZoneMask needs one 0/1 per zone (rows * cols).");
+        }
+        if (motionZoneMask.find_first_not_of("01") != std::string::npos) {
+            throw std::runtime_error("Config error: motionZoneMask may only contain 0 and 1.");
+        }
+        if (motionZoneMask.find('1') == std::string::npos) {
+            throw std::runtime_error("Config error: motionZoneMask disables every zone.");
+        }
+    }
+    for (const auto& poly : motionExcludePolygons) {
+        if (poly.size() < 3) {
+            throw std::runtime_error("Config error: motionExcludePolygon needs at least 3 points.");
+        }
+        for (const auto& pt : poly) {
+            if (pt.first < 0.f || pt.first > 1.f || pt.second < 0.f || pt.second > 1.f) {
+                throw std::runtime_error("Config error: motionExcludePolygon points must be within 0..1.");
+            }
+        }
+    }
+    if (aiRecheckIntervalMs <= 0 || aiMotionKeepAliveMs < 0) {
+        throw std::runtime_error("Config error: aiRecheckIntervalMs must be > 0 and aiMotionKeepAliveMs >= 0.");
+    }
+    parseInferenceEngine(aiEngine);      // throws on an unknown name
+    parseDetectionLayout(aiModelLayout); // same
+    if (aiInputWidth <= 0 || aiInputHeight <= 0) {
+        throw std::runtime_error("Config error: Invalid aiInputWidth/aiInputHeight.");
+    }
+    if (aiIntraOpThreads < 0 || aiInterOpThreads < 0) {
+        throw std::runtime_error("Config error: aiIntraOpThreads/aiInterOpThreads cannot be negative.");
+    }
+    if (aiConfThreshold < 0.f || aiConfThreshold > 1.f || aiNmsThreshold < 0.f || aiNmsThreshold > 1.f) {
+        throw std::runtime_error("Config error: aiConfThreshold and aiNmsThreshold must be within 0..1.");
+    }
+    if (aiBatchSize <= 0 || aiBatchMaxWaitMs < 0) {
+        throw std::runtime_error("Config error: aiBatchSize must be > 0 and aiBatchMaxWaitMs >= 0.");
+    }
+    if (aiAsyncWorkers <= 0 || aiAsyncQueueDepth <= 0) {
+        throw std::runtime_error("Config error: aiAsyncWorkers and aiAsyncQueueDepth must be > 0.");
+    }
+    if (aiDetectionStride <= 0) {
+        throw std::runtime_error("Config error: aiDetectionStride must be > 0.");
+    }
+    if (trackerMaxAge < 0 || trackerMinHits < 1 || trackerIouThreshold <= 0.f || trackerIouThreshold > 1.f) {
+        throw std::runtime_error("Config error: trackerMaxAge must be >= 0, trackerMinHits >= 1 and trackerIouThreshold within (0, 1].");
+    }
+    if (overlayThickness <= 0) {
+        throw std::runtime_error("Config error: overlayThickness must be > 0.");
+    }
+    bool seenAi = false;
+    for (size_t i = 0; i < pipelineStages.size(); ++i) {
+        const std::string& name = pipelineStages[i].name;
+        if (name != "motion" && name != "ai" && name != "tracker" && name != "overlay") {
+            throw std::runtime_error("Config error: unknown pipeline stage '" + name +
+                                     "' (expected motion, ai, tracker or overlay).");
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (pipelineStages[j].name == name) {
+                throw std::runtime_error("Config error: pipeline stage '" + name + "' is listed twice.");
+            }
+        }
+        if ((name == "tracker" || name == "overlay") && !seenAi) {
+            throw std::runtime_error("Config error: the " + name + " stage needs ai before it in pipelineStages.");
+        }
+        // Motion and the tracker work frame to frame, overlay is too cheap to be worth it
+        if (pipelineStages[i].workers > 1 && name != "ai") {
+            throw std::runtime_error("Config error: only the ai stage can run as a pool of workers.");
+        }
+        if (pipelineStages[i].workers > 1 && aiAsync) {
+            throw std::runtime_error("Config error: an ai worker pool and aiAsync don't mix, use aiAsyncWorkers.");
+        }
+        seenAi = seenAi || name == "ai";
+    }
+    if (seenAi && aiModelPath.empty()) {
+        throw std::runtime_error("Config error: the ai stage needs aiModelPath.");
+    }
+    if (encoderQueueCapacity == 0 || streamerQueueCapacity == 0) {
+        throw std::runtime_error("Config error: encoderQueueCapacity and streamerQueueCapacity must be > 0.");
+    }
+    if (reconnectInitialMs <= 0 || reconnectDelaySecs < 0) {
+        throw std::runtime_error("Config error: reconnectInitialMs must be > 0 and reconnectDelaySecs >= 0.");
+    }
+    if (captureQueuePolicy == OverflowPolicy::KeepGop || encoderQueuePolicy == OverflowPolicy::KeepGop) {
+        throw std::runtime_error("Config error: keepGop only applies to the packet queue (streamerQueuePolicy).");
+    }
 }
 
 std::shared_ptr<Config> loadConfig(const std::string& filename) {
@@ -36,12 +332,78 @@ std::shared_ptr<Config> loadConfig(const std::string& filename) {
     cfg->height = 720;
     cfg->fps    = 30;
     cfg->codecName = "libx264";
+    cfg->encoderProfile        = "live";
+    cfg->encoderCrf            = -1;
+    cfg->encoderBitrateKbps    = -1;
+    cfg->encoderMaxBitrateKbps = -1;
+    cfg->encoderBufferKbits    = -1;
+    cfg->encoderGopSeconds     = -1.0;
+    cfg->encoderBFrames        = -1;
+    cfg->encoderThreads        = -1;
+    cfg->encoderSliceThreads   = -1;
+    cfg->encoderLookahead      = -1;
+    cfg->passthrough    = false;
+    cfg->analysisDecode = "keyframes";
+    cfg->analysisFps    = 0.0;
+    cfg->decodeLowres   = 0;
+    cfg->decodeSkipLoopFilter = false;
+    cfg->decoderThreads      = -1;
+    cfg->decoderThreadType   = "auto";
+    cfg->hwDecodeMap         = true;
+    cfg->hwDecodeExtraFrames = 8;
+    cfg->inputProbeSize         = 0;
+    cfg->inputAnalyzeDurationMs = 0;
+    cfg->inputNoBuffer          = false;
+    cfg->inputBufferSize        = 0;
+    cfg->inputMaxDelayMs        = -1;
+    cfg->inputReorderQueueSize  = -1;
+    cfg->inputTimeoutMs         = 0;
+    cfg->cacheStreamInfo        = true;
+    cfg->jitterBufferMs         = 0;
+    cfg->jitterBufferPackets    = 64;
+    cfg->executorThreads     = 0;
+    cfg->executorPinCores    = true;
+    cfg->executorSliceFrames = 4;
     cfg->motionThreshold = 5.0;
     cfg->motionFrameInterval = 1;
+    cfg->motionDownscale = 1;
+    cfg->motionZoneRows  = 1;
+    cfg->motionZoneCols  = 1;
+    cfg->aiEngine            = "opencv";
+    cfg->aiUseGPU            = false;
+    cfg->aiInputWidth        = 640;
+    cfg->aiInputHeight       = 640;
+    cfg->aiIntraOpThreads    = 0;
+    cfg->aiInterOpThreads    = 0;
+    cfg->aiInt8              = false;
+    cfg->aiMotionGated       = true;
+    cfg->aiRecheckIntervalMs = 2000;
+    cfg->aiMotionKeepAliveMs = 1000;
+    cfg->aiModelLayout       = "yolov5";
+    cfg->aiConfThreshold     = 0.25f;
+    cfg->aiNmsThreshold      = 0.45f;
+    cfg->aiBatchSize         = 1;
+    cfg->aiBatchMaxWaitMs    = 10;
+    cfg->aiSharedBatch       = false;
+    cfg->aiAsync             = false;
+    cfg->aiAsyncWorkers      = 1;
+    cfg->aiAsyncQueueDepth   = 8;
+    cfg->aiDetectionStride   = 1;
+    cfg->trackerMaxAge       = 30;
+    cfg->trackerMinHits      = 3;
+    cfg->trackerIouThreshold = 0.3f;
+    cfg->overlayThickness    = 2;
+    cfg->pipelineStages      = { { "motion", kDefaultQueueCapacity } };
+    cfg->encoderQueueCapacity  = kDefaultQueueCapacity;
+    cfg->streamerQueueCapacity = kDefaultQueueCapacity;
+    cfg->captureQueuePolicy  = OverflowPolicy::DropOldest;
+    cfg->encoderQueuePolicy  = OverflowPolicy::Block;
+    cfg->streamerQueuePolicy = OverflowPolicy::KeepGop;
     cfg->logFilePath = "surveillance.log";
     cfg->verboseLogs = false;
     cfg->enableHardwareAccel = false;
     cfg->reconnectOnFailure  = true;
+    cfg->reconnectInitialMs  = 250;
     cfg->reconnectDelaySecs  = 5;
 
     if (filename.empty()) {
@@ -73,6 +435,53 @@ std::shared_ptr<Config> loadConfig(const std::string& filename) {
             iss >> cfg->inputUrl;
         } else if (key == "outputUrl") {
             iss >> cfg->outputUrl;
+        } else if (key == "standbyUrl") {
+            iss >> cfg->standbyUrl;
+        } else if (key == "camera") {
+            CameraConfig camera;
+            iss >> camera.name >> camera.inputUrl >> camera.outputUrl >> camera.standbyUrl;
+            cfg->cameras.push_back(camera);
+        } else if (key == "rendition") {
+            RenditionConfig rendition{ "", 0, 0, "", 0 };
+            iss >> rendition.name >> rendition.width >> rendition.height >> rendition.outputUrl;
+            if (!(iss >> rendition.bitrateKbps)) {
+                rendition.bitrateKbps = 0;
+            }
+            cfg->renditions.push_back(rendition);
+        } else if (key == "rtspTransport") {
+            iss >> cfg->rtspTransport;
+        } else if (key == "inputProbeSize") {
+            iss >> cfg->inputProbeSize;
+        } else if (key == "inputAnalyzeDurationMs") {
+            iss >> cfg->inputAnalyzeDurationMs;
+        } else if (key == "inputNoBuffer") {
+            int tmp;
+            iss >> tmp;
+            cfg->inputNoBuffer = (tmp != 0);
+        } else if (key == "inputBufferSize") {
+            iss >> cfg->inputBufferSize;
+        } else if (key == "inputMaxDelayMs") {
+            iss >> cfg->inputMaxDelayMs;
+        } else if (key == "inputReorderQueueSize") {
+            iss >> cfg->inputReorderQueueSize;
+        } else if (key == "inputTimeoutMs") {
+            iss >> cfg->inputTimeoutMs;
+        } else if (key == "cacheStreamInfo") {
+            int tmp;
+            iss >> tmp;
+            cfg->cacheStreamInfo = (tmp != 0);
+        } else if (key == "jitterBufferMs") {
+            iss >> cfg->jitterBufferMs;
+        } else if (key == "jitterBufferPackets") {
+            iss >> cfg->jitterBufferPackets;
+        } else if (key == "executorThreads") {
+            iss >> cfg->executorThreads;
+        } else if (key == "executorPinCores") {
+            int tmp;
+            iss >> tmp;
+            cfg->executorPinCores = (tmp != 0);
+        } else if (key == "executorSliceFrames") {
+            iss >> cfg->executorSliceFrames;
         } else if (key == "width") {
             iss >> cfg->width;
         } else if (key == "height") {
@@ -81,10 +490,166 @@ std::shared_ptr<Config> loadConfig(const std::string& filename) {
             iss >> cfg->fps;
         } else if (key == "codecName") {
             iss >> cfg->codecName;
+        } else if (key == "encoderProfile") {
+            iss >> cfg->encoderProfile;
+        } else if (key == "encoderRateControl") {
+            iss >> cfg->encoderRateControl;
+        } else if (key == "encoderCrf") {
+            iss >> cfg->encoderCrf;
+        } else if (key == "encoderBitrateKbps") {
+            iss >> cfg->encoderBitrateKbps;
+        } else if (key == "encoderMaxBitrateKbps") {
+            iss >> cfg->encoderMaxBitrateKbps;
+        } else if (key == "encoderBufferKbits") {
+            iss >> cfg->encoderBufferKbits;
+        } else if (key == "encoderGopSeconds") {
+            iss >> cfg->encoderGopSeconds;
+        } else if (key == "encoderBFrames") {
+            iss >> cfg->encoderBFrames;
+        } else if (key == "encoderThreads") {
+            iss >> cfg->encoderThreads;
+        } else if (key == "encoderSliceThreads") {
+            iss >> cfg->encoderSliceThreads;
+        } else if (key == "encoderLookahead") {
+            iss >> cfg->encoderLookahead;
+        } else if (key == "encoderPreset") {
+            iss >> cfg->encoderPreset;
+        } else if (key == "encoderTune") {
+            iss >> cfg->encoderTune;
+        } else if (key == "encoderOption") {
+            std::string name, value;
+            iss >> name >> value;
+            cfg->encoderOptions.emplace_back(name, value);
+        } else if (key == "cameraEncoderProfile") {
+            std::string camera, profile;
+            iss >> camera >> profile;
+            cfg->cameraEncoderProfiles.emplace_back(camera, profile);
+        } else if (key == "passthrough") {
+            int tmp;
+            iss >> tmp;
+            cfg->passthrough = (tmp != 0);
+        } else if (key == "analysisDecode") {
+            iss >> cfg->analysisDecode;
+        } else if (key == "analysisFps") {
+            iss >> cfg->analysisFps;
+        } else if (key == "decodeLowres") {
+            iss >> cfg->decodeLowres;
+        } else if (key == "decodeSkipLoopFilter") {
+            int tmp;
+            iss >> tmp;
+            cfg->decodeSkipLoopFilter = (tmp != 0);
+        } else if (key == "decoderThreads") {
+            iss >> cfg->decoderThreads;
+        } else if (key == "decoderThreadType") {
+            iss >> cfg->decoderThreadType;
+        } else if (key == "hwDecode") {
+            iss >> cfg->hwDecode;
+        } else if (key == "hwDecodeDevice") {
+            iss >> cfg->hwDecodeDevice;
+        } else if (key == "hwDecodeMap") {
+            int tmp;
+            iss >> tmp;
+            cfg->hwDecodeMap = (tmp != 0);
+        } else if (key == "hwDecodeExtraFrames") {
+            iss >> cfg->hwDecodeExtraFrames;
+        } else if (key == "hwEncode") {
+            iss >> cfg->hwEncode;
+        } else if (key == "hwEncodeDevice") {
+            iss >> cfg->hwEncodeDevice;
         } else if (key == "motionThreshold") {
             iss >> cfg->motionThreshold;
         } else if (key == "motionFrameInterval") {
             iss >> cfg->motionFrameInterval;
+        } else if (key == "motionDownscale") {
+            iss >> cfg->motionDownscale;
+        } else if (key == "motionZoneRows") {
+            iss >> cfg->motionZoneRows;
+        } else if (key == "motionZoneCols") {
+            iss >> cfg->motionZoneCols;
+        } else if (key == "motionZoneMask") {
+            iss >> cfg->motionZoneMask;
+        } else if (key == "motionExcludePolygon") {
+            cfg->motionExcludePolygons.push_back(parsePolygon(iss));
+        } else if (key == "aiEngine") {
+            iss >> cfg->aiEngine;
+        } else if (key == "aiModelPath") {
+            iss >> cfg->aiModelPath;
+        } else if (key == "aiModelConfig") {
+            iss >> cfg->aiModelConfig;
+        } else if (key == "aiUseGPU") {
+            int tmp;
+            iss >> tmp;
+            cfg->aiUseGPU = (tmp != 0);
+        } else if (key == "aiInputWidth") {
+            iss >> cfg->aiInputWidth;
+        } else if (key == "aiInputHeight") {
+            iss >> cfg->aiInputHeight;
+        } else if (key == "aiIntraOpThreads") {
+            iss >> cfg->aiIntraOpThreads;
+        } else if (key == "aiInterOpThreads") {
+            iss >> cfg->aiInterOpThreads;
+        } else if (key == "aiInt8") {
+            int tmp;
+            iss >> tmp;
+            cfg->aiInt8 = (tmp != 0);
+        } else if (key == "aiMotionGated") {
+            int tmp;
+            iss >> tmp;
+            cfg->aiMotionGated = (tmp != 0);
+        } else if (key == "aiRecheckIntervalMs") {
+            iss >> cfg->aiRecheckIntervalMs;
+        } else if (key == "aiMotionKeepAliveMs") {
+            iss >> cfg->aiMotionKeepAliveMs;
+        } else if (key == "aiModelLayout") {
+            iss >> cfg->aiModelLayout;
+        } else if (key == "aiConfThreshold") {
+            iss >> cfg->aiConfThreshold;
+        } else if (key == "aiNmsThreshold") {
+            iss >> cfg->aiNmsThreshold;
+        } else if (key == "aiBatchSize") {
+            iss >> cfg->aiBatchSize;
+        } else if (key == "aiBatchMaxWaitMs") {
+            iss >> cfg->aiBatchMaxWaitMs;
+        } else if (key == "aiSharedBatch") {
+            int tmp;
+            iss >> tmp;
+            cfg->aiSharedBatch = (tmp != 0);
+        } else if (key == "aiAsync") {
+            int tmp;
+            iss >> tmp;
+            cfg->aiAsync = (tmp != 0);
+        } else if (key == "aiAsyncWorkers") {
+            iss >> cfg->aiAsyncWorkers;
+        } else if (key == "aiAsyncQueueDepth") {
+            iss >> cfg->aiAsyncQueueDepth;
+        } else if (key == "aiDetectionStride") {
+            iss >> cfg->aiDetectionStride;
+        } else if (key == "trackerMaxAge") {
+            iss >> cfg->trackerMaxAge;
+        } else if (key == "trackerMinHits") {
+            iss >> cfg->trackerMinHits;
+        } else if (key == "trackerIouThreshold") {
+            iss >> cfg->trackerIouThreshold;
+        } else if (key == "overlayThickness") {
+            iss >> cfg->overlayThickness;
+        } else if (key == "pipelineStages") {
+            cfg->pipelineStages = parseStages(iss);
+        } else if (key == "encoderQueueCapacity") {
+            iss >> cfg->encoderQueueCapacity;
+        } else if (key == "streamerQueueCapacity") {
+            iss >> cfg->streamerQueueCapacity;
+        } else if (key == "captureQueuePolicy") {
+            std::string tmp;
+            iss >> tmp;
+            cfg->captureQueuePolicy = parseOverflowPolicy(tmp);
+        } else if (key == "encoderQueuePolicy") {
+            std::string tmp;
+            iss >> tmp;
+            cfg->encoderQueuePolicy = parseOverflowPolicy(tmp);
+        } else if (key == "streamerQueuePolicy") {
+            std::string tmp;
+            iss >> tmp;
+            cfg->streamerQueuePolicy = parseOverflowPolicy(tmp);
         } else if (key == "logFilePath") {
             iss >> cfg->logFilePath;
         } else if (key == "verboseLogs") {
@@ -99,6 +664,8 @@ std::shared_ptr<Config> loadConfig(const std::string& filename) {
             int tmp;
             iss >> tmp;
             cfg->reconnectOnFailure = (tmp != 0);
+        } else if (key == "reconnectInitialMs") {
+            iss >> cfg->reconnectInitialMs;
         } else if (key == "reconnectDelaySecs") {
             iss >> cfg->reconnectDelaySecs;
         }
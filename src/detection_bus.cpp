@@ -0,0 +1,96 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <detection_bus.hpp>
+
+#include <algorithm>
+#include <string>
+
+#include <logger.hpp>
+
+namespace {
+// Workers finish out of order, but never by this much
+constexpr int64_t kRestartGapMs = 10000;
+}
+
+DetectionBus::DetectionBus(size_t historySize)
+    : m_historySize(std::max<size_t>(1, historySize))
+{
+}
+
+int DetectionBus::subscribe(Subscriber subscriber) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const int id = m_nextId++;
+    m_subscribers.emplace_back(id, std::move(subscriber));
+    return id;
+}
+
+void DetectionBus::unsubscribe(int id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(),
+                                       [id](const std::pair<int, Subscriber>& s) { return s.first == id; }),
+                        m_subscribers.end());
+}
+
+void DetectionBus::publish(DetectionEvent event) {
+    std::vector<Subscriber> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (isRestart(event)) {
+            // Stale pts would shadow the new ones until they caught up again
+            LOG_INFO("DetectionBus: Input timestamps restarted, dropping " +
+                     std::to_string(m_history.size()) + " old results.");
+            m_history.clear();
+        }
+        if (m_history.empty() || event.pts > m_newestPts) {
+            m_newestPts = event.pts;
+        }
+        // Evict by arrival, not by pts: an out-of-order result is still recent
+        m_history.push_back(event);
+        while (m_history.size() > m_historySize) {
+            m_history.pop_front();
+        }
+        ++m_published;
+        subscribers.reserve(m_subscribers.size());
+        for (const auto& s : m_subscribers) {
+            subscribers.push_back(s.second);
+        }
+    }
+    // Outside the lock so a subscriber can query the bus
+    for (const auto& subscriber : subscribers) {
+        subscriber(event);
+    }
+}
+
+bool DetectionBus::isRestart(const DetectionEvent& event) const {
+    if (m_history.empty() || event.pts >= m_newestPts) {
+        return false;
+    }
+    if (event.timeBase.num > 0 && event.timeBase.den > 0) {
+        return m_newestPts - event.pts > av_rescale_q(kRestartGapMs, AVRational{1, 1000}, event.timeBase);
+    }
+    // Unknown time base: behind everything we hold can't be a late worker
+    return std::none_of(m_history.begin(), m_history.end(),
+                        [&event](const DetectionEvent& e) { return e.pts <= event.pts; });
+}
+
+bool DetectionBus::latestAtOrBefore(int64_t pts, DetectionEvent& out) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // The history is short, a scan beats keeping it sorted
+    const DetectionEvent* best = nullptr;
+    for (const DetectionEvent& e : m_history) {
+        if (e.pts <= pts && (!best || e.pts >= best->pts)) {
+            best = &e;
+        }
+    }
+    if (!best) {
+        return false;
+    }
+    out = *best;
+    return true;
+}
+
+uint64_t DetectionBus::published() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_published;
+}
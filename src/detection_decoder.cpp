@@ -0,0 +1,314 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <detection_decoder.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ARITHA_DECODE_X86 1
+#endif
+
+namespace {
+
+// Very low thresholds can leave tens of thousands of boxes; NMS is quadratic per
+// class, so only the best ones go in.
+constexpr size_t kMaxNmsCandidates = 4096;
+
+// scores is [numClasses, numAnchors]; keeps the first class on ties like a plain loop would
+void argmaxColumnsScalar(const float* scores, int numClasses, int numAnchors,
+                         float* bestScore, int32_t* bestClass) {
+    std::copy(scores, scores + numAnchors, bestScore);
+    std::fill(bestClass, bestClass + numAnchors, 0);
+    for (int c = 1; c < numClasses; ++c) {
+        const float* row = scores + static_cast<size_t>(c) * numAnchors;
+        for (int a = 0; a < numAnchors; ++a) {
+            if (row[a] > bestScore[a]) {
+                bestScore[a] = row[a];
+                bestClass[a] = c;
+            }
+        }
+    }
+}
+
+// Indices i in [0, count) with values[i * stride] >= threshold
+void filterScalar(const float* values, int stride, int count, float threshold, std::vector<int32_t>& out) {
+    for (int i = 0; i < count; ++i) {
+        if (values[static_cast<size_t>(i) * stride] >= threshold) {
+            out.push_back(i);
+        }
+    }
+}
+
+#ifdef ARITHA_DECODE_X86
+
+__attribute__((target("avx2")))
+void argmaxColumnsAvx2(const float* scores, int numClasses, int numAnchors,
+                       float* bestScore, int32_t* bestClass) {
+    std::copy(scores, scores + numAnchors, bestScore);
+    std::fill(bestClass, bestClass + numAnchors, 0);
+    const int vecAnchors = numAnchors & ~7;
+    for (int c = 1; c < numClasses; ++c) {
+        const float* row = scores + static_cast<size_t>(c) * numAnchors;
+        const __m256 classIdx = _mm256_castsi256_ps(_mm256_set1_epi32(c));
+        for (int a = 0; a < vecAnchors; a += 8) {
+            const __m256 v    = _mm256_loadu_ps(row + a);
+            const __m256 best = _mm256_loadu_ps(bestScore + a);
+            const __m256 gt   = _mm256_cmp_ps(v, best, _CMP_GT_OQ);
+            const __m256 cls  = _mm256_loadu_ps(reinterpret_cast<const float*>(bestClass + a));
+            _mm256_storeu_ps(bestScore + a, _mm256_blendv_ps(best, v, gt));
+            _mm256_storeu_ps(reinterpret_cast<float*>(bestClass + a), _mm256_blendv_ps(cls, classIdx, gt));
+        }
+        for (int a = vecAnchors; a < numAnchors; ++a) {
+            if (row[a] > bestScore[a]) {
+                bestScore[a] = row[a];
+                bestClass[a] = c;
+            }
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+void filterAvx2(const float* values, int stride, int count, float threshold, std::vector<int32_t>& out) {
+    const __m256 thr = _mm256_set1_ps(threshold);
+    const int vecCount = count & ~7;
+    int i = 0;
+    if (stride == 1) {
+        for (; i < vecCount; i += 8) {
+            const __m256 v = _mm256_loadu_ps(values + i);
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(v, thr, _CMP_GE_OQ)));
+            while (mask) {
+                out.push_back(i + __builtin_ctz(mask));
+                mask &= mask - 1;
+            }
+        }
+    } else {
+        // Strided column (YOLOv5 objectness): gather 8 rows at a time
+        const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                   _mm256_set1_epi32(stride));
+        for (; i < vecCount; i += 8) {
+            const __m256 v = _mm256_i32gather_ps(values + static_cast<size_t>(i) * stride, offsets, 4);
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(v, thr, _CMP_GE_OQ)));
+            while (mask) {
+                out.push_back(i + __builtin_ctz(mask));
+                mask &= mask - 1;
+            }
+        }
+    }
+    for (; i < count; ++i) {
+        if (values[static_cast<size_t>(i) * stride] >= threshold) {
+            out.push_back(i);
+        }
+    }
+}
+
+#endif // ARITHA_DECODE_X86
+
+using ArgmaxFn = void (*)(const float*, int, int, float*, int32_t*);
+using FilterFn = void (*)(const float*, int, int, float, std::vector<int32_t>&);
+
+struct DecodeKernel {
+    ArgmaxFn argmax;
+    FilterFn filter;
+    const char* name;
+};
+
+DecodeKernel pickKernel() {
+#ifdef ARITHA_DECODE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {argmaxColumnsAvx2, filterAvx2, "avx2"};
+#endif
+    return {argmaxColumnsScalar, filterScalar, "scalar"};
+}
+
+const DecodeKernel& kernel() {
+    static const DecodeKernel s_kernel = pickKernel();
+    return s_kernel;
+}
+
+inline DetectionBox centerBox(float cx, float cy, float w, float h, float sx, float sy,
+                              float confidence, int classId) {
+    DetectionBox db;
+    db.x = (cx - w / 2) * sx;
+    db.y = (cy - h / 2) * sy;
+    db.width  = w * sx;
+    db.height = h * sy;
+    db.confidence = confidence;
+    db.classId = classId;
+    return db;
+}
+
+inline float iou(const DetectionBox& a, const DetectionBox& b) {
+    const float x1 = std::max(a.x, b.x);
+    const float y1 = std::max(a.y, b.y);
+    const float x2 = std::min(a.x + a.width, b.x + b.width);
+    const float y2 = std::min(a.y + a.height, b.y + b.height);
+    const float inter = std::max(0.f, x2 - x1) * std::max(0.f, y2 - y1);
+    const float uni = a.width * a.height + b.width * b.height - inter;
+    return uni > 0.f ? inter / uni : 0.f;
+}
+
+} // namespace
+
+DetectionLayout parseDetectionLayout(const std::string& name) {
+    if (name == "yolov5") return DetectionLayout::YoloV5;
+    if (name == "yolov8") return DetectionLayout::YoloV8;
+    if (name == "ssd")    return DetectionLayout::Ssd;
+    throw std::runtime_error("Config error: unknown model layout '" + name +
+                             "' (expected yolov5, yolov8 or ssd).");
+}
+
+DetectionDecoder::DetectionDecoder(const DecoderOptions& options)
+    : m_options(options)
+{
+}
+
+const char* DetectionDecoder::kernelName() {
+    return kernel().name;
+}
+
+void DetectionDecoder::decode(const float* data, int dim1, int dim2, int imageIndex,
+                              int inputWidth, int inputHeight, int frameWidth, int frameHeight,
+                              std::vector<DetectionBox>& out) {
+    out.clear();
+    if (!data || dim1 <= 0 || dim2 <= 0 || inputWidth <= 0 || inputHeight <= 0) {
+        return;
+    }
+    // YOLO boxes are in net input pixels, the frame was stretched (not letterboxed) to it
+    const float sx = static_cast<float>(frameWidth) / inputWidth;
+    const float sy = static_cast<float>(frameHeight) / inputHeight;
+
+    switch (m_options.layout) {
+    case DetectionLayout::YoloV5:
+        if (dim2 < 6) return;
+        decodeYoloRows(data, dim1, dim2, true, sx, sy, out);
+        break;
+    case DetectionLayout::YoloV8:
+        if (dim1 < dim2) {
+            if (dim1 < 5) return;
+            decodeYoloV8(data, dim1, dim2, sx, sy, out);
+        } else {
+            if (dim2 < 5) return;
+            decodeYoloRows(data, dim1, dim2, false, sx, sy, out);
+        }
+        break;
+    case DetectionLayout::Ssd:
+        if (dim2 < 7) return;
+        decodeSsd(data, dim1, dim2, imageIndex, frameWidth, frameHeight, out);
+        return; // the net's DetectionOutput layer has done NMS already
+    }
+    nms(out);
+}
+
+void DetectionDecoder::decodeYoloRows(const float* data, int rows, int cols, bool hasObjectness,
+                                      float sx, float sy, std::vector<DetectionBox>& out) {
+    const int firstClass = hasObjectness ? 5 : 4;
+    const float conf = m_options.confThreshold;
+
+    m_candidates.clear();
+    if (hasObjectness) {
+        // obj * class <= obj, so rows with a weak objectness can never make it
+        kernel().filter(data + 4, cols, rows, conf, m_candidates);
+    } else {
+        m_candidates.resize(static_cast<size_t>(rows));
+        std::iota(m_candidates.begin(), m_candidates.end(), 0);
+    }
+
+    for (int32_t r : m_candidates) {
+        const float* row = data + static_cast<size_t>(r) * cols;
+        const float* scores = row + firstClass;
+        const float* best = std::max_element(scores, row + cols);
+        const float score = hasObjectness ? row[4] * *best : *best;
+        if (score >= conf) {
+            out.push_back(centerBox(row[0], row[1], row[2], row[3], sx, sy, score,
+                                    static_cast<int>(best - scores)));
+        }
+    }
+}
+
+void DetectionDecoder::decodeYoloV8(const float* data, int channels, int anchors,
+                                    float sx, float sy, std::vector<DetectionBox>& out) {
+    m_bestScore.resize(static_cast<size_t>(anchors));
+    m_bestClass.resize(static_cast<size_t>(anchors));
+    kernel().argmax(data + static_cast<size_t>(4) * anchors, channels - 4, anchors,
+                    m_bestScore.data(), m_bestClass.data());
+
+    m_candidates.clear();
+    kernel().filter(m_bestScore.data(), 1, anchors, m_options.confThreshold, m_candidates);
+
+    const float* cx = data;
+    const float* cy = data + anchors;
+    const float* w  = data + static_cast<size_t>(2) * anchors;
+    const float* h  = data + static_cast<size_t>(3) * anchors;
+    for (int32_t a : m_candidates) {
+        out.push_back(centerBox(cx[a], cy[a], w[a], h[a], sx, sy, m_bestScore[a], m_bestClass[a]));
+    }
+}
+
+void DetectionDecoder::decodeSsd(const float* data, int rows, int cols, int imageIndex,
+                                 int frameWidth, int frameHeight, std::vector<DetectionBox>& out) {
+    for (int r = 0; r < rows; ++r) {
+        const float* row = data + static_cast<size_t>(r) * cols;
+        if (static_cast<int>(row[0]) != imageIndex || row[2] < m_options.confThreshold) {
+            continue;
+        }
+        DetectionBox db;
+        db.x = row[3] * frameWidth;
+        db.y = row[4] * frameHeight;
+        db.width  = (row[5] - row[3]) * frameWidth;
+        db.height = (row[6] - row[4]) * frameHeight;
+        db.confidence = row[2];
+        db.classId = static_cast<int>(row[1]);
+        out.push_back(db);
+    }
+    if (m_options.maxDetections > 0 && out.size() > static_cast<size_t>(m_options.maxDetections)) {
+        std::sort(out.begin(), out.end(), [](const DetectionBox& a, const DetectionBox& b) {
+            return a.confidence > b.confidence;
+        });
+        out.resize(static_cast<size_t>(m_options.maxDetections));
+    }
+}
+
+void DetectionDecoder::nms(std::vector<DetectionBox>& boxes) {
+    auto byScore = [](const DetectionBox& a, const DetectionBox& b) { return a.confidence > b.confidence; };
+    if (boxes.size() > kMaxNmsCandidates) {
+        std::nth_element(boxes.begin(), boxes.begin() + kMaxNmsCandidates, boxes.end(), byScore);
+        boxes.resize(kMaxNmsCandidates);
+    }
+
+    const size_t n = boxes.size();
+    m_order.resize(n);
+    std::iota(m_order.begin(), m_order.end(), 0u);
+    const bool agnostic = m_options.classAgnosticNms;
+    // Group by class (unless agnostic), best first within a group
+    std::sort(m_order.begin(), m_order.end(), [&](uint32_t a, uint32_t b) {
+        if (!agnostic && boxes[a].classId != boxes[b].classId) {
+            return boxes[a].classId < boxes[b].classId;
+        }
+        return boxes[a].confidence > boxes[b].confidence;
+    });
+
+    m_suppressed.assign(n, 0);
+    m_kept.clear();
+    for (size_t i = 0; i < n; ++i) {
+        if (m_suppressed[i]) continue;
+        const DetectionBox& keep = boxes[m_order[i]];
+        m_kept.push_back(keep);
+        for (size_t j = i + 1; j < n; ++j) {
+            const DetectionBox& other = boxes[m_order[j]];
+            if (!agnostic && other.classId != keep.classId) break; // end of this class
+            if (!m_suppressed[j] && iou(keep, other) > m_options.nmsThreshold) {
+                m_suppressed[j] = 1;
+            }
+        }
+    }
+
+    std::stable_sort(m_kept.begin(), m_kept.end(), byScore);
+    if (m_options.maxDetections > 0 && m_kept.size() > static_cast<size_t>(m_options.maxDetections)) {
+        m_kept.resize(static_cast<size_t>(m_options.maxDetections));
+    }
+    boxes.swap(m_kept);
+}
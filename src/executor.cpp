@@ -0,0 +1,212 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <executor.hpp>
+
+#include <algorithm>
+
+#include <logger.hpp>
+#include <utilities.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Which worker of which executor the current thread is, -1 for outsiders
+thread_local const void* t_executor = nullptr;
+thread_local int t_workerIndex = -1;
+
+// How long an idle worker sleeps before it looks for work to steal again
+constexpr std::chrono::milliseconds kIdleWait{10};
+
+void pinToCore(std::thread& thread, int core) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) != 0) {
+        LOG_WARNING("Executor: Could not pin a worker to core " + std::to_string(core) + ".");
+    }
+#else
+    (void)thread;
+    (void)core;
+#endif
+}
+
+} // namespace
+
+Executor::Executor(int threads, bool pinCores)
+    : m_started(std::chrono::steady_clock::now())
+{
+    const int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    const int count = threads > 0 ? threads : cores;
+    for (int i = 0; i < count; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    // All deques exist before any worker starts stealing from them
+    for (int i = 0; i < count; ++i) {
+        m_workers[i]->thread = std::thread(&Executor::workerLoop, this, i);
+        if (pinCores) {
+            pinToCore(m_workers[i]->thread, i % cores);
+        }
+    }
+    m_timerThread = std::thread(&Executor::timerLoop, this);
+
+    LOG_INFO("Executor: " + std::to_string(count) + " workers" +
+             (pinCores ? ", pinned to cores." : "."));
+}
+
+Executor::~Executor() {
+    shutdown();
+}
+
+void Executor::shutdown() {
+    if (!m_running.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(m_timerMutex);
+        m_timed.clear();
+    }
+    m_timerCv.notify_all();
+    if (m_timerThread.joinable()) {
+        m_timerThread.join();
+    }
+    m_wakeSeq.fetch_add(1, std::memory_order_release);
+    futexWakeAll(m_wakeSeq);
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->tasks.clear();
+    }
+}
+
+void Executor::pushTo(int index, Task task) {
+    Worker& worker = *m_workers[index];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    // Any idle worker may take it, not just the owner. seq_cst on both sides
+    // (here and the sleeper count in workerLoop) so a wakeup can't slip between them.
+    m_wakeSeq.fetch_add(1);
+    if (m_sleepers.load() > 0) {
+        futexWakeAll(m_wakeSeq);
+    }
+}
+
+void Executor::submit(Task task) {
+    if (!m_running.load(std::memory_order_relaxed)) return;
+    const int index = (t_executor == this)
+        ? t_workerIndex
+        : static_cast<int>(m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size());
+    pushTo(index, std::move(task));
+}
+
+void Executor::submitAfter(std::chrono::microseconds delay, Task task) {
+    if (!m_running.load(std::memory_order_relaxed)) return;
+    const int index = (t_executor == this)
+        ? t_workerIndex
+        : static_cast<int>(m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size());
+    const auto due = std::chrono::steady_clock::now() + delay;
+    bool soonest = false;
+    {
+        std::lock_guard<std::mutex> lock(m_timerMutex);
+        m_timed.push_back({ due, index, std::move(task) });
+        std::push_heap(m_timed.begin(), m_timed.end(),
+                       [](const Timed& a, const Timed& b) { return a.due > b.due; });
+        soonest = (m_timed.front().due == due);
+    }
+    if (soonest) {
+        m_timerCv.notify_one();
+    }
+}
+
+void Executor::timerLoop() {
+    const auto later = [](const Timed& a, const Timed& b) { return a.due > b.due; };
+    std::unique_lock<std::mutex> lock(m_timerMutex);
+    while (m_running.load()) {
+        if (m_timed.empty()) {
+            m_timerCv.wait(lock);
+            continue;
+        }
+        const auto due = m_timed.front().due;
+        if (std::chrono::steady_clock::now() < due) {
+            m_timerCv.wait_until(lock, due);
+            continue;
+        }
+        std::pop_heap(m_timed.begin(), m_timed.end(), later);
+        Timed timed = std::move(m_timed.back());
+        m_timed.pop_back();
+        // Back to the worker that asked, the stream's state is still warm in its cache
+        lock.unlock();
+        pushTo(timed.worker, std::move(timed.task));
+        lock.lock();
+    }
+}
+
+bool Executor::takeTask(int index, Task& out) {
+    // Own deque first, oldest task first
+    {
+        Worker& own = *m_workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            out = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    // Then steal the newest from someone else, starting next door so thieves spread out
+    const int count = static_cast<int>(m_workers.size());
+    for (int k = 1; k < count; ++k) {
+        Worker& victim = *m_workers[(index + k) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            out = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            m_workers[index]->stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Executor::workerLoop(int index) {
+    t_executor = this;
+    t_workerIndex = index;
+    Worker& self = *m_workers[index];
+
+    while (m_running.load(std::memory_order_acquire)) {
+        // Read the sequence before looking, so a submit in between wakes us up
+        const uint32_t seq = m_wakeSeq.load(std::memory_order_acquire);
+        Task task;
+        if (!takeTask(index, task)) {
+            m_sleepers.fetch_add(1);
+            futexWait(m_wakeSeq, seq, kIdleWait);
+            m_sleepers.fetch_sub(1);
+            continue;
+        }
+
+        const auto begin = std::chrono::steady_clock::now();
+        task();
+        const auto spent = std::chrono::steady_clock::now() - begin;
+        self.busyNs.fetch_add(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(spent).count()), std::memory_order_relaxed);
+        self.run.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+ExecutorStats Executor::stats() const {
+    ExecutorStats s;
+    const double wall = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_started).count());
+    for (const auto& worker : m_workers) {
+        s.tasksRun    += worker->run.load(std::memory_order_relaxed);
+        s.tasksStolen += worker->stolen.load(std::memory_order_relaxed);
+        s.workerBusy.push_back(wall > 0.0 ? worker->busyNs.load(std::memory_order_relaxed) / wall : 0.0);
+    }
+    return s;
+}
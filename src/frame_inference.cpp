@@ -0,0 +1,140 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+// The parsing in runInference() depends on your model’s architecture; DetectionDecoder
+// handles YOLOv5, YOLOv8 and SSD (DetectionOutput) layouts. Add a layout there for anything else.
+
+#include <frame_inference.hpp>
+
+#include <algorithm>
+#include <string>
+
+#include <logger.hpp>
+
+FrameInference::FrameInference(const InferenceOptions& inference, const DecoderOptions& decode, int maxBatch)
+    : m_inference(inference)
+    , m_maxBatch(std::max(1, maxBatch))
+    , m_inputWidth(inference.inputWidth)
+    , m_inputHeight(inference.inputHeight)
+    , m_decoder(decode)
+{
+    const size_t planeSize = static_cast<size_t>(m_inputWidth) * m_inputHeight;
+    const size_t batch = static_cast<size_t>(m_maxBatch);
+    m_rgbPlanes.resize(3 * planeSize);
+    m_blob.resize(batch * 3 * planeSize);
+    m_imageSizes.reserve(batch);
+    m_slotOwner.reserve(batch);
+}
+
+FrameInference::~FrameInference() {
+    if (m_swsCtx) {
+        sws_freeContext(m_swsCtx);
+        m_swsCtx = nullptr;
+    }
+}
+
+bool FrameInference::load() {
+    m_backend = createInferenceBackend(m_inference.engine);
+    if (!m_backend->load(m_inference)) {
+        m_backend.reset();
+        return false;
+    }
+
+    LOG_INFO(std::string("AIDetector: Model loaded successfully on ") + m_backend->name() +
+             ", decoding with the " + DetectionDecoder::kernelName() + " kernels.");
+    return true;
+}
+
+bool FrameInference::infer(const std::vector<const AVFrame*>& frames,
+                           std::vector<std::vector<DetectionBox>>& results) {
+    results.resize(frames.size());
+    for (auto& boxes : results) {
+        boxes.clear();
+    }
+    if (!m_backend) {
+        LOG_ERROR("AIDetector: No model loaded, can't run inference!");
+        return false;
+    }
+
+    // Convert the frames straight into the blob, one forward pass per full blob
+    const size_t slotSize = 3 * static_cast<size_t>(m_inputWidth) * m_inputHeight;
+    bool ran = false;
+    size_t next = 0;
+    while (next < frames.size()) {
+        m_imageSizes.clear();
+        m_slotOwner.clear();
+        for (; next < frames.size() && m_slotOwner.size() < static_cast<size_t>(m_maxBatch); ++next) {
+            const AVFrame* frame = frames[next];
+            if (!frame || !frameToBlob(frame, m_blob.data() + m_slotOwner.size() * slotSize)) {
+                continue;
+            }
+            m_imageSizes.emplace_back(frame->width, frame->height);
+            m_slotOwner.push_back(next);
+        }
+        if (!m_slotOwner.empty() && runInference(results)) {
+            ran = true;
+        }
+    }
+    return ran;
+}
+
+bool FrameInference::frameToBlob(const AVFrame* frame, float* dst) {
+    // One sws pass does the YUV -> RGB conversion and the resize to the net input
+    // (what blobFromImage used to redo on a full-size BGR copy). GBRP keeps the
+    // channels planar so they line up with the NCHW blob.
+    m_swsCtx = sws_getCachedContext(m_swsCtx,
+        frame->width, frame->height, (AVPixelFormat)frame->format,
+        m_inputWidth, m_inputHeight, AV_PIX_FMT_GBRP,
+        SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!m_swsCtx) {
+        LOG_ERROR("AIDetector: Could not create scaler for " + std::to_string(frame->width) + "x" +
+                  std::to_string(frame->height) + " input.");
+        return false;
+    }
+
+    // GBRP plane order is G, B, R; point them so the buffer ends up R, G, B (swapRB)
+    const size_t planeSize = static_cast<size_t>(m_inputWidth) * m_inputHeight;
+    uint8_t* r = m_rgbPlanes.data();
+    uint8_t* dest[4] = { r + planeSize, r + 2 * planeSize, r, nullptr };
+    int destLinesize[4] = { m_inputWidth, m_inputWidth, m_inputWidth, 0 };
+
+    sws_scale(m_swsCtx,
+              frame->data, frame->linesize,
+              0, frame->height,
+              dest, destLinesize);
+
+    // Normalize into the blob slot; a flat loop the compiler vectorizes
+    const float scale = 1.0f / 255.0f;
+    const size_t total = 3 * planeSize;
+    for (size_t i = 0; i < total; ++i) {
+        dst[i] = r[i] * scale;
+    }
+    return true;
+}
+
+bool FrameInference::runInference(std::vector<std::vector<DetectionBox>>& results) {
+    // 1. The blob is already filled (frameToBlob), NCHW with one image per batch entry.
+    // 2. Forward pass on the filled slots
+    const int count = static_cast<int>(m_slotOwner.size());
+    InferenceOutput output;
+    if (!m_backend->infer(m_blob.data(), count, 3, m_inputHeight, m_inputWidth, output) ||
+        !output.data || output.shape.size() < 3) {
+        return false;
+    }
+
+    // 3. Decode: threshold, class argmax and NMS per image (see DetectionDecoder for the layouts)
+    // YOLO outputs are [batch, dim1, dim2]; SSD gives one [1, 1, N, 7] table for the whole batch.
+    const bool ssd = (m_decoder.options().layout == DetectionLayout::Ssd);
+    const size_t dims = output.shape.size();
+    const int dim1 = static_cast<int>(output.shape[dims - 2]);
+    const int dim2 = static_cast<int>(output.shape[dims - 1]);
+    const float* outData = output.data;
+
+    for (size_t n = 0; n < m_slotOwner.size(); ++n) {
+        const float* data = ssd ? outData : outData + n * static_cast<size_t>(dim1) * dim2;
+        m_decoder.decode(data, dim1, dim2, static_cast<int>(n),
+                         m_inputWidth, m_inputHeight,
+                         m_imageSizes[n].first, m_imageSizes[n].second,
+                         results[m_slotOwner[n]]);
+    }
+    return true;
+}
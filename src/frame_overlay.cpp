@@ -0,0 +1,168 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <frame_overlay.hpp>
+
+#include <algorithm>
+
+namespace {
+
+// Red, green, blue, yellow, cyan, magenta, orange, white (BT.601 limited range)
+const uint8_t kPalette[][3] = {
+    {  81,  90, 240 }, { 145,  54,  34 }, {  41, 240, 110 }, { 210,  16, 146 },
+    { 170, 166,  16 }, { 106, 202, 222 }, { 165,  42, 179 }, { 235, 128, 128 },
+};
+constexpr int kPaletteSize = sizeof(kPalette) / sizeof(kPalette[0]);
+
+bool isSupported(int format) {
+    return format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P || format == AV_PIX_FMT_NV12;
+}
+
+} // namespace
+
+FrameOverlay::FrameOverlay(QueueInterface<DecodedFrame>& inQueue,
+                           QueueInterface<DecodedFrame>& outQueue,
+                           int thickness,
+                           DetectionBus* bus)
+    : m_inQueue(inQueue)
+    , m_outQueue(outQueue)
+    , m_thickness(std::max(1, thickness))
+    , m_bus(bus)
+{
+}
+
+FrameOverlay::~FrameOverlay() {
+    stop();
+}
+
+void FrameOverlay::start() {
+    if (m_running.load()) return;
+    m_running.store(true);
+    m_thread = std::thread(&FrameOverlay::overlayLoop, this);
+}
+
+void FrameOverlay::startPolled() {
+    m_running.store(true);
+}
+
+void FrameOverlay::stop() {
+    if (!m_running.load()) return;
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void FrameOverlay::overlayLoop() {
+    while (m_running.load()) {
+        auto maybeFrame = m_inQueue.popBlocking(kQueueWait);
+        if (!maybeFrame.has_value()) {
+            continue;
+        }
+        DecodedFrame df = std::move(maybeFrame.value());
+        process(df);
+        forward(df);
+    }
+    m_running.store(false);
+}
+
+size_t FrameOverlay::poll(size_t budget) {
+    size_t handled = 0;
+    while (handled < budget && m_running.load() && m_outQueue.size() < m_outQueue.capacity()) {
+        auto maybeFrame = m_inQueue.pop();
+        if (!maybeFrame.has_value()) {
+            break;
+        }
+        DecodedFrame df = std::move(maybeFrame.value());
+        process(df);
+        forward(df);
+        ++handled;
+    }
+    return handled;
+}
+
+void FrameOverlay::process(DecodedFrame& df) {
+    if (!df.frame) {
+        return;
+    }
+    const std::vector<DetectionBox>* boxes = &df.detections;
+    if (m_bus && !df.inferred) {
+        // Async: the newest result up to this frame, a few frames late at most
+        if (!m_bus->latestAtOrBefore(df.pts, m_event)) {
+            return;
+        }
+        boxes = &m_event.detections;
+    }
+    if (boxes->empty()) {
+        return;
+    }
+    if (!isSupported(df.frame->format)) {
+        if (!m_warnedFormat) {
+            LOG_WARNING("FrameOverlay: Can't draw on pixel format " + std::to_string(df.frame->format) +
+                        ", passing frames through.");
+            m_warnedFormat = true;
+        }
+        return;
+    }
+    if (av_frame_make_writable(df.frame) < 0) {
+        // Someone else (an async inference job) still shares the planes and we couldn't copy them
+        LOG_WARNING("FrameOverlay: Frame not writable, skipping overlay.");
+        return;
+    }
+    for (const DetectionBox& box : *boxes) {
+        draw(df.frame, box);
+    }
+}
+
+void FrameOverlay::draw(AVFrame* frame, const DetectionBox& box) {
+    const int key = box.trackId >= 0 ? box.trackId : box.classId;
+    const uint8_t* c = kPalette[((key % kPaletteSize) + kPaletteSize) % kPaletteSize];
+    const Yuv color{ c[0], c[1], c[2] };
+
+    // Even coordinates so the chroma lines up with the luma
+    const int x0 = std::max(0, static_cast<int>(box.x)) & ~1;
+    const int y0 = std::max(0, static_cast<int>(box.y)) & ~1;
+    const int x1 = std::min(frame->width,  static_cast<int>(box.x + box.width))  & ~1;
+    const int y1 = std::min(frame->height, static_cast<int>(box.y + box.height)) & ~1;
+    if (x1 <= x0 || y1 <= y0) {
+        return;
+    }
+    const int th = std::max(2, (m_thickness + 1) & ~1); // even too
+
+    fillRect(frame, x0, y0, x1, std::min(y1, y0 + th), color);      // top
+    fillRect(frame, x0, std::max(y0, y1 - th), x1, y1, color);      // bottom
+    fillRect(frame, x0, y0, std::min(x1, x0 + th), y1, color);      // left
+    fillRect(frame, std::max(x0, x1 - th), y0, x1, y1, color);      // right
+}
+
+void FrameOverlay::fillRect(AVFrame* frame, int x0, int y0, int x1, int y1, const Yuv& color) {
+    for (int y = y0; y < y1; ++y) {
+        std::fill_n(frame->data[0] + y * frame->linesize[0] + x0, x1 - x0, color.y);
+    }
+
+    // 4:2:0, the coordinates are even so this covers exactly the same area
+    const int cx0 = x0 / 2, cx1 = x1 / 2, cy0 = y0 / 2, cy1 = y1 / 2;
+    if (frame->format == AV_PIX_FMT_NV12) {
+        for (int y = cy0; y < cy1; ++y) {
+            uint8_t* uv = frame->data[1] + y * frame->linesize[1] + 2 * cx0;
+            for (int x = cx0; x < cx1; ++x) {
+                *uv++ = color.u;
+                *uv++ = color.v;
+            }
+        }
+    } else {
+        for (int y = cy0; y < cy1; ++y) {
+            std::fill_n(frame->data[1] + y * frame->linesize[1] + cx0, cx1 - cx0, color.u);
+            std::fill_n(frame->data[2] + y * frame->linesize[2] + cx0, cx1 - cx0, color.v);
+        }
+    }
+}
+
+void FrameOverlay::forward(DecodedFrame& df) {
+    while (!m_outQueue.enqueue(std::move(df), kQueueWait)) {
+        if (!m_running.load() || m_outQueue.isShutdown()) {
+            releaseDecodedFrame(df);
+            break;
+        }
+    }
+}
@@ -0,0 +1,176 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <frame_pool.hpp>
+#include <logger.hpp>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace {
+// Same slack FFmpeg's own pool leaves: SIMD over-reads past the last row and
+// a stride aligned for AVX-512 loads.
+constexpr int kStrideAlign  = 64;
+constexpr int kPlanePadding = 16 + kStrideAlign - 1;
+}
+
+FramePool::FramePool(size_t maxIdleShells)
+    : m_maxIdleShells(maxIdleShells)
+{
+    m_idleShells.reserve(maxIdleShells);
+}
+
+FramePool::~FramePool() {
+    for (AVFrame* shell : m_idleShells) {
+        av_frame_free(&shell);
+    }
+    resetPools();
+}
+
+void FramePool::attach(AVCodecContext* codecCtx) {
+    if (!codecCtx || !codecCtx->codec) return;
+    if (!(codecCtx->codec->capabilities & AV_CODEC_CAP_DR1)) {
+        LOG_INFO("FramePool: Decoder " + std::string(codecCtx->codec->name) +
+                 " doesn't support custom buffers, using the default allocator.");
+        return;
+    }
+    codecCtx->opaque = this;
+    codecCtx->get_buffer2 = &FramePool::getBuffer2;
+}
+
+AVFrame* FramePool::acquireFrame() {
+    {
+        std::lock_guard<std::mutex> lock(m_shellMutex);
+        if (!m_idleShells.empty()) {
+            AVFrame* shell = m_idleShells.back();
+            m_idleShells.pop_back();
+            m_shellHits.fetch_add(1, std::memory_order_relaxed);
+            return shell;
+        }
+    }
+    m_shellMisses.fetch_add(1, std::memory_order_relaxed);
+    return av_frame_alloc();
+}
+
+void FramePool::releaseFrame(AVFrame*& frame) {
+    if (!frame) return;
+    av_frame_unref(frame);
+    {
+        std::lock_guard<std::mutex> lock(m_shellMutex);
+        if (m_idleShells.size() < m_maxIdleShells) {
+            m_idleShells.push_back(frame);
+            frame = nullptr;
+            return;
+        }
+    }
+    av_frame_free(&frame);
+}
+
+bool FramePool::allocBuffers(AVFrame* frame) {
+    if (!frame || frame->width <= 0 || frame->height <= 0) return false;
+    return allocPlanes(nullptr, frame);
+}
+
+FramePoolStats FramePool::stats() const {
+    FramePoolStats s;
+    s.shellHits    = m_shellHits.load(std::memory_order_relaxed);
+    s.shellMisses  = m_shellMisses.load(std::memory_order_relaxed);
+    s.bufferMisses = m_bufferMisses.load(std::memory_order_relaxed);
+    uint64_t gets  = m_bufferGets.load(std::memory_order_relaxed);
+    s.bufferHits   = gets > s.bufferMisses ? gets - s.bufferMisses : 0;
+    return s;
+}
+
+int FramePool::getBuffer2(AVCodecContext* codecCtx, AVFrame* frame, int flags) {
+    auto* self = static_cast<FramePool*>(codecCtx->opaque);
+    if (self && self->allocPlanes(codecCtx, frame)) {
+        return 0;
+    }
+    // Hardware surfaces, palettes, odd formats: let libavcodec handle them
+    return avcodec_default_get_buffer2(codecCtx, frame, flags);
+}
+
+bool FramePool::allocPlanes(AVCodecContext* codecCtx, AVFrame* frame) {
+    const auto format = static_cast<AVPixelFormat>(frame->format);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+        return false;
+    }
+
+    // The decoder may write past the visible picture, size planes like the default allocator
+    int width  = frame->width;
+    int height = frame->height;
+    if (codecCtx) {
+        int strideAlign[AV_NUM_DATA_POINTERS];
+        avcodec_align_dimensions2(codecCtx, &width, &height, strideAlign);
+    }
+
+    int linesizes[4];
+    if (av_image_fill_linesizes(linesizes, format, width) < 0) {
+        return false;
+    }
+    ptrdiff_t paddedLinesizes[4];
+    for (int i = 0; i < 4; ++i) {
+        linesizes[i] = (linesizes[i] + kStrideAlign - 1) & ~(kStrideAlign - 1);
+        paddedLinesizes[i] = linesizes[i];
+    }
+    size_t planeSizes[4];
+    if (av_image_fill_plane_sizes(planeSizes, format, height, paddedLinesizes) < 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_poolMutex);
+    if (m_poolFormat != frame->format || m_poolWidth != width || m_poolHeight != height) {
+        resetPools();
+        for (int i = 0; i < 4 && planeSizes[i] > 0; ++i) {
+            m_pools[i] = av_buffer_pool_init2(planeSizes[i] + kPlanePadding, this,
+                                              &FramePool::allocBuffer, nullptr);
+            if (!m_pools[i]) {
+                resetPools();
+                return false;
+            }
+        }
+        m_poolFormat = frame->format;
+        m_poolWidth  = width;
+        m_poolHeight = height;
+        LOG_DEBUG("FramePool: Planes sized for " + std::to_string(width) + "x" + std::to_string(height) +
+                  " " + av_get_pix_fmt_name(format));
+    }
+
+    for (int i = 0; i < 4 && m_pools[i]; ++i) {
+        frame->buf[i] = av_buffer_pool_get(m_pools[i]);
+        if (!frame->buf[i]) {
+            for (int j = 0; j < i; ++j) {
+                av_buffer_unref(&frame->buf[j]);
+            }
+            return false;
+        }
+        m_bufferGets.fetch_add(1, std::memory_order_relaxed);
+        frame->data[i]     = frame->buf[i]->data;
+        frame->linesize[i] = linesizes[i];
+    }
+    frame->extended_data = frame->data;
+    return true;
+}
+
+void FramePool::resetPools() {
+    for (auto& pool : m_pools) {
+        if (pool) {
+            av_buffer_pool_uninit(&pool);
+        }
+    }
+    m_poolFormat = -1;
+    m_poolWidth  = 0;
+    m_poolHeight = 0;
+}
+
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+AVBufferRef* FramePool::allocBuffer(void* opaque, size_t size) {
+#else
+AVBufferRef* FramePool::allocBuffer(void* opaque, int size) {
+#endif
+    static_cast<FramePool*>(opaque)->m_bufferMisses.fetch_add(1, std::memory_order_relaxed);
+    return av_buffer_alloc(size);
+}
@@ -0,0 +1,137 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <frame_reorderer.hpp>
+
+FrameReorderer::FrameReorderer(QueueInterface<DecodedFrame>& inQueue,
+                               QueueInterface<DecodedFrame>& outQueue,
+                               size_t window,
+                               std::chrono::milliseconds maxHold)
+    : m_inQueue(inQueue)
+    , m_outQueue(outQueue)
+    , m_pending(window > 0 ? window : 1)
+    , m_maxHold(maxHold)
+{
+}
+
+FrameReorderer::~FrameReorderer() {
+    stop();
+    for (auto& slot : m_pending) {
+        if (slot.has_value()) {
+            releaseDecodedFrame(*slot);
+        }
+    }
+}
+
+void FrameReorderer::start() {
+    if (m_running.load()) return;
+    m_lastRelease = std::chrono::steady_clock::now();
+    m_polled = false;
+    m_running.store(true);
+    m_thread = std::thread(&FrameReorderer::reorderLoop, this);
+}
+
+void FrameReorderer::startPolled() {
+    m_lastRelease = std::chrono::steady_clock::now();
+    m_polled = true;
+    m_running.store(true);
+}
+
+void FrameReorderer::stop() {
+    if (!m_running.load()) return;
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void FrameReorderer::reorderLoop() {
+    while (m_running.load()) {
+        auto maybeFrame = m_inQueue.popBlocking(kQueueWait);
+        if (maybeFrame.has_value()) {
+            accept(std::move(maybeFrame.value()));
+        }
+        releaseInOrder();
+        skipStalledGap();
+    }
+    m_running.store(false);
+}
+
+size_t FrameReorderer::poll(size_t budget) {
+    size_t handled = 0;
+    while (handled < budget && m_running.load() && !outFull()) {
+        auto maybeFrame = m_inQueue.pop();
+        if (!maybeFrame.has_value()) {
+            break;
+        }
+        accept(std::move(maybeFrame.value()));
+        releaseInOrder();
+        ++handled;
+    }
+    // Runs on idle turns too, that's when a gap is found out
+    releaseInOrder();
+    skipStalledGap();
+    return handled;
+}
+
+void FrameReorderer::accept(DecodedFrame&& df) {
+    const size_t window = m_pending.size();
+    if (df.seq < m_nextSeq) {
+        // We already gave up waiting for this one, it's too late to show it
+        LOG_DEBUG("FrameReorderer: Late frame seq=" + std::to_string(df.seq) + " dropped.");
+        releaseDecodedFrame(df);
+        return;
+    }
+    // Too far ahead for the window: skip the gap rather than stall
+    while (df.seq - m_nextSeq >= window) {
+        if (m_pending[m_nextSeq % window].has_value()) {
+            forward(std::move(*m_pending[m_nextSeq % window]));
+            m_pending[m_nextSeq % window].reset();
+            --m_pendingCount;
+        }
+        ++m_nextSeq;
+    }
+    if (m_pendingCount == 0) {
+        // The hold timer starts when something begins waiting
+        m_lastRelease = std::chrono::steady_clock::now();
+    }
+    m_pending[df.seq % window] = std::move(df);
+    ++m_pendingCount;
+}
+
+void FrameReorderer::skipStalledGap() {
+    // A ticket that never shows up (a worker died, a frame was lost) must
+    // not freeze the stream: after m_maxHold, jump to the oldest frame we have.
+    const size_t window = m_pending.size();
+    if (m_pendingCount == 0 || m_pending[m_nextSeq % window].has_value() ||
+        std::chrono::steady_clock::now() - m_lastRelease <= m_maxHold) {
+        return;
+    }
+    uint64_t skipped = 0;
+    while (!m_pending[m_nextSeq % window].has_value()) {
+        ++m_nextSeq;
+        ++skipped;
+    }
+    LOG_WARNING("FrameReorderer: Gave up on " + std::to_string(skipped) + " missing frame(s).");
+    releaseInOrder();
+}
+
+void FrameReorderer::releaseInOrder() {
+    const size_t window = m_pending.size();
+    while (m_pendingCount > 0 && m_pending[m_nextSeq % window].has_value() && !outFull()) {
+        forward(std::move(*m_pending[m_nextSeq % window]));
+        m_pending[m_nextSeq % window].reset();
+        --m_pendingCount;
+        ++m_nextSeq;
+        m_lastRelease = std::chrono::steady_clock::now();
+    }
+}
+
+void FrameReorderer::forward(DecodedFrame&& df) {
+    while (!m_outQueue.enqueue(std::move(df), kQueueWait)) {
+        if (!m_running.load() || m_outQueue.isShutdown()) {
+            releaseDecodedFrame(df);
+            break;
+        }
+    }
+}
@@ -0,0 +1,60 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <frame_sink.hpp>
+
+FrameSink::FrameSink(QueueInterface<DecodedFrame>& inQueue)
+    : m_inQueue(inQueue)
+{
+}
+
+FrameSink::~FrameSink() {
+    stop();
+    // Frames left over once everything upstream is gone
+    while (auto df = m_inQueue.pop()) {
+        releaseDecodedFrame(df.value());
+    }
+}
+
+void FrameSink::start() {
+    if (m_running.load()) return;
+    m_running.store(true);
+    m_thread = std::thread(&FrameSink::sinkLoop, this);
+}
+
+void FrameSink::startPolled() {
+    m_running.store(true);
+}
+
+void FrameSink::stop() {
+    if (!m_running.load()) return;
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void FrameSink::sinkLoop() {
+    while (m_running.load()) {
+        auto maybeFrame = m_inQueue.popBlocking(kQueueWait);
+        if (maybeFrame.has_value()) {
+            releaseDecodedFrame(maybeFrame.value());
+            m_consumed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    m_running.store(false);
+}
+
+size_t FrameSink::poll(size_t budget) {
+    size_t handled = 0;
+    while (handled < budget && m_running.load()) {
+        auto maybeFrame = m_inQueue.pop();
+        if (!maybeFrame.has_value()) {
+            break;
+        }
+        releaseDecodedFrame(maybeFrame.value());
+        ++handled;
+    }
+    m_consumed.fetch_add(handled, std::memory_order_relaxed);
+    return handled;
+}
@@ -0,0 +1,40 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <inference_backend.hpp>
+#include <opencv_backend.hpp>
+#include <openvino_backend.hpp>
+#include <onnxruntime_backend.hpp>
+#include <logger.hpp>
+
+#include <stdexcept>
+
+InferenceEngine parseInferenceEngine(const std::string& name) {
+    if (name == "opencv")      return InferenceEngine::OpenCv;
+    if (name == "openvino")    return InferenceEngine::OpenVino;
+    if (name == "onnxruntime") return InferenceEngine::OnnxRuntime;
+    throw std::runtime_error("Config error: unknown inference engine '" + name +
+                             "' (expected opencv, openvino or onnxruntime).");
+}
+
+std::unique_ptr<InferenceBackend> createInferenceBackend(InferenceEngine engine) {
+    switch (engine) {
+    case InferenceEngine::OpenVino:
+#ifdef ARITHA_WITH_OPENVINO
+        return std::make_unique<OpenVinoBackend>();
+#else
+        LOG_WARNING("Inference: Built without OpenVINO (ARITHA_WITH_OPENVINO), using OpenCV DNN.");
+        break;
+#endif
+    case InferenceEngine::OnnxRuntime:
+#ifdef ARITHA_WITH_ONNXRUNTIME
+        return std::make_unique<OnnxRuntimeBackend>();
+#else
+        LOG_WARNING("Inference: Built without ONNX Runtime (ARITHA_WITH_ONNXRUNTIME), using OpenCV DNN.");
+        break;
+#endif
+    case InferenceEngine::OpenCv:
+        break;
+    }
+    return std::make_unique<OpenCvBackend>();
+}
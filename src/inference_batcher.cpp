@@ -0,0 +1,149 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <inference_batcher.hpp>
+
+#include <algorithm>
+#include <string>
+
+#include <logger.hpp>
+
+InferenceBatcher::InferenceBatcher(const InferenceOptions& inference,
+                                   const AIBatchOptions& batch,
+                                   const DecoderOptions& decode)
+    : m_inference(inference, decode, batch.maxBatch)
+    , m_batch(batch)
+{
+    m_batch.maxBatch = m_inference.maxBatch();
+    if (!m_inference.load()) {
+        LOG_ERROR("InferenceBatcher: Failed to load model!");
+    }
+    m_frames.reserve(static_cast<size_t>(m_batch.maxBatch));
+    m_slots.reserve(static_cast<size_t>(m_batch.maxBatch));
+}
+
+InferenceBatcher::~InferenceBatcher() {
+    stop();
+}
+
+void InferenceBatcher::start() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running) return;
+        m_running = true;
+    }
+    m_thread = std::thread(&InferenceBatcher::batchLoop, this);
+}
+
+void InferenceBatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        m_running = false;
+        // Nobody will get to these any more
+        for (Request* request : m_requests) {
+            request->ok = false;
+            request->remaining -= request->frames->size() - request->next;
+            if (request->remaining == 0) {
+                finish(*request);
+            }
+        }
+        m_requests.clear();
+        m_queuedFrames = 0;
+    }
+    m_pending.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    LOG_INFO("InferenceBatcher: Inferred " + std::to_string(framesInferred()) + " frames in " +
+             std::to_string(batches()) + " batches.");
+}
+
+bool InferenceBatcher::infer(const std::vector<const AVFrame*>& frames,
+                             std::vector<std::vector<DetectionBox>>& results) {
+    results.resize(frames.size());
+    for (auto& boxes : results) {
+        boxes.clear();
+    }
+    if (frames.empty()) {
+        return true;
+    }
+
+    Request request;
+    request.frames = &frames;
+    request.results = &results;
+    request.arrived = std::chrono::steady_clock::now();
+    request.remaining = frames.size();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_running) {
+        return false;
+    }
+    m_requests.push_back(&request);
+    m_queuedFrames += frames.size();
+    m_pending.notify_one();
+    m_finished.wait(lock, [&request] { return request.done; });
+    return request.ok;
+}
+
+void InferenceBatcher::finish(Request& request) {
+    request.done = true;
+    m_finished.notify_all();
+}
+
+void InferenceBatcher::takeBatch() {
+    m_frames.clear();
+    m_slots.clear();
+    const size_t maxBatch = static_cast<size_t>(m_batch.maxBatch);
+    while (m_frames.size() < maxBatch && !m_requests.empty()) {
+        Request* request = m_requests.front();
+        const size_t take = std::min(maxBatch - m_frames.size(), request->frames->size() - request->next);
+        for (size_t i = 0; i < take; ++i) {
+            m_frames.push_back((*request->frames)[request->next]);
+            m_slots.push_back({ request, request->next });
+            ++request->next;
+        }
+        m_queuedFrames -= take;
+        if (request->next == request->frames->size()) {
+            m_requests.pop_front();
+        }
+    }
+}
+
+void InferenceBatcher::batchLoop() {
+    const size_t maxBatch = static_cast<size_t>(m_batch.maxBatch);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_pending.wait(lock, [this] { return !m_running || !m_requests.empty(); });
+        if (!m_running) {
+            break;
+        }
+        // Close the batch once it is full or the oldest frame has waited maxWait
+        const auto deadline = m_requests.front()->arrived + m_batch.maxWait;
+        m_pending.wait_until(lock, deadline, [this, maxBatch] {
+            return !m_running || m_queuedFrames >= maxBatch;
+        });
+        if (!m_running) {
+            break;
+        }
+        takeBatch();
+
+        // The callers wait on their requests, so the frames can't go away meanwhile
+        lock.unlock();
+        const bool ok = m_inference.infer(m_frames, m_results);
+        lock.lock();
+
+        m_batches.fetch_add(1, std::memory_order_relaxed);
+        if (ok) {
+            m_framesInferred.fetch_add(m_frames.size(), std::memory_order_relaxed);
+        }
+        for (size_t k = 0; k < m_slots.size(); ++k) {
+            Request& request = *m_slots[k].request;
+            (*request.results)[m_slots[k].index] = std::move(m_results[k]);
+            request.ok = request.ok && ok;
+            if (--request.remaining == 0) {
+                finish(request);
+            }
+        }
+    }
+}
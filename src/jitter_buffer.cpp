@@ -0,0 +1,92 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <jitter_buffer.hpp>
+
+#include <cmath>
+#include <iterator>
+
+JitterBuffer::JitterBuffer(size_t capacity)
+    : m_capacity(capacity > 0 ? capacity : 1)
+{
+}
+
+JitterBuffer::~JitterBuffer() {
+    clear();
+}
+
+void JitterBuffer::clear() {
+    for (Entry& e : m_packets) {
+        av_packet_free(&e.packet);
+    }
+    m_packets.clear();
+}
+
+void JitterBuffer::reset(AVRational timeBase, int64_t window) {
+    clear();
+    m_timeBase = timeBase;
+    m_window = window;
+    m_newest = AV_NOPTS_VALUE;
+    m_released = AV_NOPTS_VALUE;
+    m_prevTs = AV_NOPTS_VALUE;
+    m_jitterSecs = 0.0;
+}
+
+void JitterBuffer::updateJitter(int64_t ts, std::chrono::steady_clock::time_point arrival) {
+    if (m_prevTs != AV_NOPTS_VALUE && ts > m_prevTs) {
+        // D = (arrival difference) - (timestamp difference), J += (|D| - J) / 16
+        const double arrivalSecs = std::chrono::duration<double>(arrival - m_prevArrival).count();
+        const double tsSecs = (ts - m_prevTs) * av_q2d(m_timeBase);
+        m_jitterSecs += (std::fabs(arrivalSecs - tsSecs) - m_jitterSecs) / 16.0;
+        m_stats.jitterMs = m_jitterSecs * 1000.0;
+    }
+    if (m_prevTs == AV_NOPTS_VALUE || ts > m_prevTs) {
+        m_prevTs = ts;
+        m_prevArrival = arrival;
+    }
+}
+
+void JitterBuffer::push(AVPacket* packet, std::chrono::steady_clock::time_point arrival) {
+    int64_t ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+    if (ts == AV_NOPTS_VALUE) {
+        // No timestamp to order by, keep it where it arrived
+        ts = m_newest != AV_NOPTS_VALUE ? m_newest : (m_released != AV_NOPTS_VALUE ? m_released : 0);
+    }
+    if (m_released != AV_NOPTS_VALUE && ts < m_released) {
+        ++m_stats.late;
+        av_packet_free(&packet);
+        return;
+    }
+    updateJitter(ts, arrival);
+
+    // Nearly always goes to the back; equal dts keep their arrival order
+    auto it = m_packets.end();
+    while (it != m_packets.begin() && std::prev(it)->ts > ts) {
+        --it;
+    }
+    if (it != m_packets.end()) {
+        ++m_stats.reordered;
+    }
+    m_packets.insert(it, Entry{ ts, packet });
+    if (m_newest == AV_NOPTS_VALUE || ts > m_newest) {
+        m_newest = ts;
+    }
+}
+
+AVPacket* JitterBuffer::pop(bool flush) {
+    if (m_packets.empty()) {
+        return nullptr;
+    }
+    const Entry& head = m_packets.front();
+    const bool full = m_packets.size() > m_capacity;
+    if (!flush && !full && m_newest - head.ts < m_window) {
+        return nullptr;
+    }
+    if (full && !flush && m_newest - head.ts < m_window) {
+        ++m_stats.overflow;
+    }
+    AVPacket* packet = head.packet;
+    m_released = head.ts;
+    m_packets.pop_front();
+    return packet;
+}
@@ -4,11 +4,7 @@
 #include <iostream>
 #include <config.hpp>
 #include <logger.hpp>
-#include <buffer_queue.hpp>
-#include <motion_detector.hpp>
-#include <video_capture.hpp>
-#include <video_encoder.hpp>
-#include <video_streamer.hpp>
+#include <supervisor.hpp>
 #include <utilities.hpp>
 
 int main(int argc, char** argv) {
@@ -20,58 +16,39 @@ int main(int argc, char** argv) {
     Logger::instance().init(config->logFilePath, /*consoleOutput=*/true, config->verboseLogs);
     LOG_INFO("Starting HomeSurveillance...");
 
-    // 3. Create queues
-    static BufferQueue<DecodedFrame, 128> captureQueue;
-    static BufferQueue<DecodedFrame, 128> motionToEncoderQueue;
-    static BufferQueue<EncodedPacket, 128> encoderToStreamerQueue;
+    // 3. One pipeline per camera (stages as listed in pipelineStages), sharing one executor
+    Supervisor supervisor(*config);
 
-    // 4. Create modules
-    VideoCapture capture(config->inputUrl,
-                         captureQueue,
-                         config->reconnectOnFailure,
-                         config->reconnectDelaySecs);
+    // 4. Start the pipelines
+    supervisor.start();
 
-    // The Motion Detector pushes frames to motionToEncoderQueue
-    MotionDetector motion(captureQueue,
-                          motionToEncoderQueue,
-                          config->motionThreshold,
-                          config->motionFrameInterval);
-
-    VideoEncoder encoder(motionToEncoderQueue,
-                         encoderToStreamerQueue,
-                         config->width,
-                         config->height,
-                         config->fps,
-                         config->codecName,
-                         config->enableHardwareAccel);
-
-    VideoStreamer streamer(encoderToStreamerQueue,
-                           config->outputUrl);
-
-    // 5. Start the pipeline
-    capture.start();
-    motion.start();
-    encoder.start();
-    streamer.start();
-
-    // 6. Let it run for 60 seconds in this demo
+    // 5. Let it run for 60 seconds in this demo
     LOG_INFO("System running... will stop in ~60 seconds...");
+    uint64_t lastDropped = 0;
     for (int i = 0; i < 60; ++i) {
-        // If any stage unexpectedly stops, we exit
-        if (!capture.isRunning() || !motion.isRunning() ||
-            !encoder.isRunning() || !streamer.isRunning()) {
-            LOG_ERROR("A module has stopped unexpectedly. Exiting.");
+        uint64_t dropped = supervisor.droppedItems();
+        if (dropped != lastDropped) {
+            LOG_WARNING("Pipeline is falling behind, dropped " + std::to_string(dropped - lastDropped) +
+                        " items in the last second.");
+            lastDropped = dropped;
+        }
+
+        // One camera going down doesn't take the others with it; exit once none is left
+        if (supervisor.checkStreams() == 0) {
+            LOG_ERROR("No camera is running anymore. Exiting.");
             break;
         }
+        if (i % 10 == 9) {
+            supervisor.logMetrics();
+        }
         sleepMs(1000);
     }
 
-    // 7. Stop modules
+    // 6. Stop modules front to back. Once a stage is gone its output queue is
+    // shut down, so the next stage wakes up right away instead of waiting out kQueueWait.
     LOG_INFO("Stopping system...");
-    capture.stop();
-    motion.stop();
-    encoder.stop();
-    streamer.stop();
+    supervisor.stop();
+    supervisor.logQueueStats();
 
     LOG_INFO("Aritha Security terminated gracefully.");
     return 0;
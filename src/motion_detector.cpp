@@ -2,19 +2,46 @@
 // Company: Arithaoptix pty Ltd.
 
 #include <motion_detector.hpp>
+#include <sad_kernel.hpp>
+#include <algorithm>
 #include <cmath>
 #include <thread>
 #include <chrono>
 
-MotionDetector::MotionDetector(BufferQueue<DecodedFrame, 128>& inQueue,
-                               BufferQueue<DecodedFrame, 128>& outQueue,
+// Even-odd rule, points in normalized coordinates
+static bool insidePolygon(const std::vector<std::pair<float, float>>& poly, float x, float y) {
+    bool inside = false;
+    for (size_t i = 0, j = poly.size() - 1; i < poly.size(); j = i++) {
+        const float xi = poly[i].first, yi = poly[i].second;
+        const float xj = poly[j].first, yj = poly[j].second;
+        if ((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+MotionDetector::MotionDetector(QueueInterface<DecodedFrame>& inQueue,
+                               QueueInterface<DecodedFrame>& outQueue,
                                double threshold,
-                               int frameInterval)
+                               int frameInterval,
+                               const MotionOptions& options)
     : m_inQueue(inQueue)
     , m_outQueue(outQueue)
     , m_threshold(threshold)
     , m_frameInterval(frameInterval)
+    , m_options(options)
 {
+    m_options.downscale = std::max(1, m_options.downscale);
+    m_options.zoneRows  = std::max(1, m_options.zoneRows);
+    m_options.zoneCols  = std::max(1, m_options.zoneCols);
+    const size_t zones = static_cast<size_t>(m_options.zoneRows * m_options.zoneCols);
+    if (m_options.zoneEnabled.size() != zones) {
+        if (!m_options.zoneEnabled.empty()) {
+            LOG_WARNING("MotionDetector: Zone mask doesn't match the zone grid, using all zones.");
+        }
+        m_options.zoneEnabled.assign(zones, true);
+    }
 }
 
 MotionDetector::~MotionDetector() {
@@ -26,10 +53,17 @@ MotionDetector::~MotionDetector() {
 
 void MotionDetector::start() {
     if (m_running.load()) return;
-    m_running.store(true);
+    startPolled();
     m_thread = std::thread(&MotionDetector::detectionLoop, this);
 }
 
+void MotionDetector::startPolled() {
+    if (m_running.load()) return;
+    LOG_INFO(std::string("MotionDetector: Using ") + sumAbsDiffKernelName() + " SAD kernel.");
+    m_frameCount = 0;
+    m_running.store(true);
+}
+
 void MotionDetector::stop() {
     if (!m_running.load()) return;
     m_running.store(false);
@@ -38,64 +72,271 @@ void MotionDetector::stop() {
     }
 }
 
+void MotionDetector::prepareGeometry(int width, int height) {
+    const int f = m_options.downscale;
+    m_frameWidth  = width;
+    m_frameHeight = height;
+    m_useSmall    = f > 1 || !m_options.excludePolygons.empty();
+    m_smallWidth  = m_useSmall ? (width + f - 1) / f : width;
+    m_smallHeight = m_useSmall ? (height + f - 1) / f : height;
+    m_prevSmallIndex = -1;
+
+    const size_t pixels = static_cast<size_t>(m_smallWidth) * m_smallHeight;
+    if (m_useSmall) {
+        m_currSmall.assign(pixels, 0);
+        m_prevSmall.assign(pixels, 0);
+        m_blockSums.assign(static_cast<size_t>(m_smallWidth), 0);
+    } else {
+        m_currSmall.clear();
+        m_prevSmall.clear();
+        m_blockSums.clear();
+    }
+
+    // Rasterize the exclusion polygons once per geometry, at the analysis size.
+    // 0xFF keeps a pixel, 0x00 blanks it in both frames so it never adds to the SAD.
+    m_mask.clear();
+    if (!m_options.excludePolygons.empty()) {
+        m_mask.assign(pixels, 0xFF);
+        for (int y = 0; y < m_smallHeight; ++y) {
+            const float ny = (y * f + 0.5f) / height;
+            for (int x = 0; x < m_smallWidth; ++x) {
+                const float nx = (x * f + 0.5f) / width;
+                for (const auto& poly : m_options.excludePolygons) {
+                    if (insidePolygon(poly, nx, ny)) {
+                        m_mask[static_cast<size_t>(y) * m_smallWidth + x] = 0;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    const int rows = m_options.zoneRows;
+    const int cols = m_options.zoneCols;
+    m_zoneActivePixels.assign(static_cast<size_t>(rows * cols), 0);
+    for (int r = 0; r < rows; ++r) {
+        const int y0 = r * m_smallHeight / rows;
+        const int y1 = (r + 1) * m_smallHeight / rows;
+        for (int c = 0; c < cols; ++c) {
+            const int x0 = c * m_smallWidth / cols;
+            const int x1 = (c + 1) * m_smallWidth / cols;
+            int64_t active = static_cast<int64_t>(x1 - x0) * (y1 - y0);
+            if (!m_mask.empty()) {
+                active = 0;
+                for (int y = y0; y < y1; ++y) {
+                    const uint8_t* row = m_mask.data() + static_cast<size_t>(y) * m_smallWidth;
+                    active += std::count(row + x0, row + x1, 0xFF);
+                }
+            }
+            m_zoneActivePixels[static_cast<size_t>(r * cols + c)] = active;
+        }
+    }
+
+    LOG_INFO("MotionDetector: Analysing " + std::to_string(m_smallWidth) + "x" +
+             std::to_string(m_smallHeight) + " luma in " + std::to_string(rows) + "x" +
+             std::to_string(cols) + " zones for " + std::to_string(width) + "x" +
+             std::to_string(height) + " frames.");
+}
+
+void MotionDetector::decimate(const AVFrame* frame, std::vector<uint8_t>& out) {
+    const int f = m_options.downscale;
+    const bool masked = !m_mask.empty();
+    // The right and bottom blocks are partial when the size isn't a multiple of f
+    const int lastCols = m_frameWidth - (m_smallWidth - 1) * f;
+    const int lastRows = m_frameHeight - (m_smallHeight - 1) * f;
+    const int fullCols = m_smallWidth - 1;
+    for (int y = 0; y < m_smallHeight; ++y) {
+        uint8_t* dst = out.data() + static_cast<size_t>(y) * m_smallWidth;
+        if (f == 1) {
+            const uint8_t* src = frame->data[0] + static_cast<ptrdiff_t>(y) * frame->linesize[0];
+            std::copy(src, src + m_smallWidth, dst);
+        } else {
+            // Box average of each f x f block: point sampling aliases noise and
+            // fine texture into flicker that scores as motion
+            const int rows = (y + 1 < m_smallHeight) ? f : lastRows;
+            std::fill(m_blockSums.begin(), m_blockSums.end(), 0u);
+            for (int dy = 0; dy < rows; ++dy) {
+                const uint8_t* src = frame->data[0] + static_cast<ptrdiff_t>(y * f + dy) * frame->linesize[0];
+                for (int x = 0; x < fullCols; ++x) {
+                    const uint8_t* block = src + x * f;
+                    uint32_t sum = 0;
+                    for (int k = 0; k < f; ++k) {
+                        sum += block[k];
+                    }
+                    m_blockSums[static_cast<size_t>(x)] += sum;
+                }
+                const uint8_t* block = src + fullCols * f;
+                uint32_t sum = 0;
+                for (int k = 0; k < lastCols; ++k) {
+                    sum += block[k];
+                }
+                m_blockSums[static_cast<size_t>(fullCols)] += sum;
+            }
+            const uint32_t area = static_cast<uint32_t>(rows * f);
+            for (int x = 0; x < fullCols; ++x) {
+                dst[x] = static_cast<uint8_t>((m_blockSums[static_cast<size_t>(x)] + area / 2) / area);
+            }
+            const uint32_t lastArea = static_cast<uint32_t>(rows * lastCols);
+            dst[fullCols] = static_cast<uint8_t>((m_blockSums[static_cast<size_t>(fullCols)] + lastArea / 2) / lastArea);
+        }
+        if (masked) {
+            const uint8_t* m = m_mask.data() + static_cast<size_t>(y) * m_smallWidth;
+            for (int x = 0; x < m_smallWidth; ++x) {
+                dst[x] &= m[x];
+            }
+        }
+    }
+}
+
+MotionResult MotionDetector::analyze(const AVFrame* current, const AVFrame* previous, int frameIndex) {
+    if (current->width != m_frameWidth || current->height != m_frameHeight) {
+        prepareGeometry(current->width, current->height);
+    }
+
+    const uint8_t* curPlane;
+    const uint8_t* prevPlane;
+    int curStride;
+    int prevStride;
+    if (m_useSmall) {
+        decimate(current, m_currSmall);
+        // With frameInterval 1 the previous frame was analysed last time round, reuse it
+        if (m_prevSmallIndex != frameIndex - 1) {
+            decimate(previous, m_prevSmall);
+        }
+        curPlane   = m_currSmall.data();
+        prevPlane  = m_prevSmall.data();
+        curStride  = m_smallWidth;
+        prevStride = m_smallWidth;
+    } else {
+        curPlane   = current->data[0];
+        prevPlane  = previous->data[0];
+        curStride  = current->linesize[0];
+        prevStride = previous->linesize[0];
+    }
+
+    MotionResult result;
+    const int rows = m_options.zoneRows;
+    const int cols = m_options.zoneCols;
+    result.zoneScores.assign(static_cast<size_t>(rows * cols), 0.0);
+    uint64_t totalDiff = 0;
+    int64_t totalPixels = 0;
+    for (int r = 0; r < rows; ++r) {
+        const int y0 = r * m_smallHeight / rows;
+        const int y1 = (r + 1) * m_smallHeight / rows;
+        for (int c = 0; c < cols; ++c) {
+            const size_t zone = static_cast<size_t>(r * cols + c);
+            const int64_t active = m_zoneActivePixels[zone];
+            if (!m_options.zoneEnabled[zone] || active == 0) {
+                continue;
+            }
+            const int x0 = c * m_smallWidth / cols;
+            const int x1 = (c + 1) * m_smallWidth / cols;
+            // Integer SAD is exact, so a single full-res zone matches the old per-pixel double sum bit for bit
+            const uint64_t diff = sumAbsDiff(curPlane + static_cast<ptrdiff_t>(y0) * curStride + x0, curStride,
+                                             prevPlane + static_cast<ptrdiff_t>(y0) * prevStride + x0, prevStride,
+                                             x1 - x0, y1 - y0);
+            result.zoneScores[zone] = static_cast<double>(diff) / active;
+            if (result.zoneScores[zone] > m_threshold) {
+                result.motion = true;
+            }
+            totalDiff   += diff;
+            totalPixels += active;
+        }
+    }
+    if (totalPixels > 0) {
+        result.score = static_cast<double>(totalDiff) / totalPixels;
+    }
+
+    if (m_useSmall) {
+        std::swap(m_currSmall, m_prevSmall);
+        m_prevSmallIndex = frameIndex;
+    }
+    return result;
+}
+
 void MotionDetector::detectionLoop() {
-    int frameCount = 0;
     while (m_running.load()) {
-        auto maybeFrame = m_inQueue.pop();
+        auto maybeFrame = m_inQueue.popBlocking(kQueueWait);
         if (!maybeFrame.has_value()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
             continue;
         }
+        DecodedFrame df = std::move(maybeFrame.value());
+        if (process(df)) {
+            forward(df);
+        }
+    }
+    m_running.store(false);
+}
 
+size_t MotionDetector::poll(size_t budget) {
+    size_t handled = 0;
+    while (handled < budget && m_running.load() && m_outQueue.size() < m_outQueue.capacity()) {
+        auto maybeFrame = m_inQueue.pop();
+        if (!maybeFrame.has_value()) {
+            break;
+        }
         DecodedFrame df = std::move(maybeFrame.value());
-        AVFrame* current = df.frame;
-        if (!current) {
-            continue;
+        if (process(df)) {
+            forward(df);
         }
-        frameCount++;
-
-        // Only compute difference every m_frameInterval frames
-        if (m_prevFrame && (frameCount % m_frameInterval == 0)) {
-            if (current->width == m_prevFrame->width &&
-                current->height == m_prevFrame->height) {
-                int width = current->width;
-                int height = current->height;
-                int strideCur = current->linesize[0];
-                int stridePrev = m_prevFrame->linesize[0];
-
-                double sumDiff = 0.0;
-                int totalPixels = width * height;
-
-                uint8_t* currData = current->data[0];
-                uint8_t* prevData = m_prevFrame->data[0];
-
-                for (int y = 0; y < height; ++y) {
-                    for (int x = 0; x < width; ++x) {
-                        int idxCur = y * strideCur + x;
-                        int idxPrev = y * stridePrev + x;
-                        double diff = std::abs((double)currData[idxCur] - (double)prevData[idxPrev]);
-                        sumDiff += diff;
-                    }
-                }
-                double avgDiff = sumDiff / totalPixels;
-                if (avgDiff > m_threshold) {
-                    LOG_INFO("MotionDetector: Motion detected. avgDiff=" + std::to_string(avgDiff));
-                } else {
-                    LOG_DEBUG("MotionDetector: No significant motion. avgDiff=" + std::to_string(avgDiff));
+        ++handled;
+    }
+    return handled;
+}
+
+bool MotionDetector::process(DecodedFrame& df) {
+    AVFrame* current = df.frame;
+    if (!current) {
+        return false;
+    }
+    m_frameCount++;
+
+    // Only compute difference every m_frameInterval frames
+    if (m_prevFrame && (m_frameCount % m_frameInterval == 0)) {
+        if (current->width == m_prevFrame->width &&
+            current->height == m_prevFrame->height) {
+            MotionResult result = analyze(current, m_prevFrame, m_frameCount);
+            m_haveResult = true;
+            if (result.motion) {
+                // Every zone's score, the ones over the threshold marked with '*'
+                std::string zones;
+                for (size_t z = 0; z < result.zoneScores.size(); ++z) {
+                    zones += (zones.empty() ? "" : ",") + std::to_string(z) + ":" +
+                             std::to_string(result.zoneScores[z]) +
+                             (result.zoneScores[z] > m_threshold ? "*" : "");
                 }
+                LOG_INFO("MotionDetector: Motion detected. avgDiff=" + std::to_string(result.score) +
+                         " zones=" + zones);
+            } else {
+                LOG_DEBUG("MotionDetector: No significant motion. avgDiff=" + std::to_string(result.score));
             }
+            m_lastResult = std::move(result);
         }
+    }
 
-        // Update previous frame
-        if (!m_prevFrame) {
-            m_prevFrame = av_frame_alloc();
-        }
-        av_frame_ref(m_prevFrame, current);
+    // Downstream (AIDetector) gates on this
+    df.motionEvaluated = m_haveResult;
+    df.motion          = m_lastResult.motion;
+    df.motionScore     = m_lastResult.score;
+    if (m_lastResult.zoneScores.size() > 1) {
+        df.motionZoneScores = m_lastResult.zoneScores;
+    }
 
-        // Pass frame along to next stage
-        while (!m_outQueue.push(std::move(df))) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    // Update previous frame
+    if (!m_prevFrame) {
+        m_prevFrame = av_frame_alloc();
+    }
+    av_frame_unref(m_prevFrame); // drop the last reference, or every frame's planes leak
+    av_frame_ref(m_prevFrame, current);
+    return true;
+}
+
+void MotionDetector::forward(DecodedFrame& df) {
+    // Pass frame along to next stage
+    while (!m_outQueue.enqueue(std::move(df), kQueueWait)) {
+        if (!m_running.load() || m_outQueue.isShutdown()) {
+            releaseDecodedFrame(df);
+            break;
         }
     }
-    m_running.store(false);
 }
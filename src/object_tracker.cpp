@@ -0,0 +1,95 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <object_tracker.hpp>
+
+ObjectTracker::ObjectTracker(QueueInterface<DecodedFrame>& inQueue,
+                             QueueInterface<DecodedFrame>& outQueue,
+                             const SortOptions& options,
+                             DetectionBus* bus)
+    : m_inQueue(inQueue)
+    , m_outQueue(outQueue)
+    , m_bus(bus)
+    , m_tracker(options)
+{
+}
+
+ObjectTracker::~ObjectTracker() {
+    stop();
+}
+
+void ObjectTracker::start() {
+    if (m_running.load()) return;
+    m_running.store(true);
+    m_thread = std::thread(&ObjectTracker::trackLoop, this);
+}
+
+void ObjectTracker::startPolled() {
+    m_running.store(true);
+}
+
+void ObjectTracker::stop() {
+    if (!m_running.load()) return;
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void ObjectTracker::trackLoop() {
+    while (m_running.load()) {
+        auto maybeFrame = m_inQueue.popBlocking(kQueueWait);
+        if (!maybeFrame.has_value()) {
+            continue;
+        }
+        DecodedFrame df = std::move(maybeFrame.value());
+        if (df.frame) {
+            track(df);
+        }
+        forward(df);
+    }
+    m_running.store(false);
+}
+
+size_t ObjectTracker::poll(size_t budget) {
+    size_t handled = 0;
+    while (handled < budget && m_running.load() && m_outQueue.size() < m_outQueue.capacity()) {
+        auto maybeFrame = m_inQueue.pop();
+        if (!maybeFrame.has_value()) {
+            break;
+        }
+        DecodedFrame df = std::move(maybeFrame.value());
+        if (df.frame) {
+            track(df);
+        }
+        forward(df);
+        ++handled;
+    }
+    return handled;
+}
+
+void ObjectTracker::track(DecodedFrame& df) {
+    const std::vector<DetectionBox>* detections = nullptr;
+    if (df.inferred) {
+        detections = &df.detections;
+    } else if (m_bus && m_bus->latestAtOrBefore(df.pts, m_event) &&
+               (!m_haveEvent || m_event.seq != m_lastEventSeq)) {
+        // Async results land a few frames late; correcting with them is still
+        // far better than coasting until the track times out.
+        m_haveEvent = true;
+        m_lastEventSeq = m_event.seq;
+        detections = &m_event.detections;
+    }
+
+    // Without detections this only predicts: the boxes move on with their tracks
+    df.detections = m_tracker.step(detections);
+}
+
+void ObjectTracker::forward(DecodedFrame& df) {
+    while (!m_outQueue.enqueue(std::move(df), kQueueWait)) {
+        if (!m_running.load() || m_outQueue.isShutdown()) {
+            releaseDecodedFrame(df);
+            break;
+        }
+    }
+}
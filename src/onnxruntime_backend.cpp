@@ -0,0 +1,72 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <onnxruntime_backend.hpp>
+
+#ifdef ARITHA_WITH_ONNXRUNTIME
+
+#include <logger.hpp>
+
+OnnxRuntimeBackend::OnnxRuntimeBackend()
+    : m_env(ORT_LOGGING_LEVEL_WARNING, "aritha")
+    , m_memoryInfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
+{
+}
+
+bool OnnxRuntimeBackend::load(const InferenceOptions& options) {
+    try {
+        Ort::SessionOptions so;
+        so.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        if (options.intraOpThreads > 0) {
+            so.SetIntraOpNumThreads(options.intraOpThreads);
+        }
+        if (options.interOpThreads > 1) {
+            // Independent branches of the graph run concurrently
+            so.SetExecutionMode(ExecutionMode::ORT_PARALLEL);
+            so.SetInterOpNumThreads(options.interOpThreads);
+        }
+        if (options.int8) {
+            // Let the optimizer fuse QuantizeLinear/DequantizeLinear pairs into int8 kernels
+            so.AddConfigEntry("session.qdqisint8allowed", "1");
+        }
+        if (options.useGPU) {
+            LOG_WARNING("OnnxRuntimeBackend: GPU requested, using the CPU execution provider.");
+        }
+
+        m_session = std::make_unique<Ort::Session>(m_env, options.modelPath.c_str(), so);
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        m_inputName  = m_session->GetInputNameAllocated(0, allocator).get();
+        m_outputName = m_session->GetOutputNameAllocated(0, allocator).get();
+    } catch (const Ort::Exception& e) {
+        LOG_ERROR(std::string("OnnxRuntimeBackend: Exception loading model: ") + e.what());
+        return false;
+    }
+
+    LOG_INFO("OnnxRuntimeBackend: Loaded " + options.modelPath + " (input '" + m_inputName +
+             "', output '" + m_outputName + "').");
+    return true;
+}
+
+bool OnnxRuntimeBackend::infer(const float* input, int batch, int channels, int height, int width,
+                               InferenceOutput& output) {
+    try {
+        // Wraps the caller's blob, no copy
+        const int64_t shape[4] = { batch, channels, height, width };
+        const size_t count = static_cast<size_t>(batch) * channels * height * width;
+        Ort::Value tensor = Ort::Value::CreateTensor<float>(m_memoryInfo, const_cast<float*>(input),
+                                                            count, shape, 4);
+        const char* inputNames[]  = { m_inputName.c_str() };
+        const char* outputNames[] = { m_outputName.c_str() };
+        m_outputs = m_session->Run(Ort::RunOptions{nullptr}, inputNames, &tensor, 1, outputNames, 1);
+    } catch (const Ort::Exception& e) {
+        LOG_ERROR(std::string("OnnxRuntimeBackend: Exception during inference: ") + e.what());
+        return false;
+    }
+
+    output.data  = m_outputs[0].GetTensorData<float>();
+    output.shape = m_outputs[0].GetTensorTypeAndShapeInfo().GetShape();
+    return true;
+}
+
+#endif // ARITHA_WITH_ONNXRUNTIME
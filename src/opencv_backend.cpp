@@ -0,0 +1,72 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <opencv_backend.hpp>
+#include <logger.hpp>
+
+bool OpenCvBackend::load(const InferenceOptions& options) {
+    try {
+        if (!options.modelConfig.empty()) {
+            // For frameworks like Caffe (prototxt + caffemodel) or TensorFlow (pb + pbtxt)
+            m_net = cv::dnn::readNet(options.modelPath, options.modelConfig);
+        } else {
+            // For ONNX or single-file models
+            m_net = cv::dnn::readNet(options.modelPath);
+        }
+
+        if (options.useGPU) {
+#ifdef CV_CUDNN
+            m_net.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
+            m_net.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
+            LOG_INFO("OpenCvBackend: Using GPU inference (CUDA).");
+#else
+            LOG_WARNING("OpenCvBackend: GPU requested but OpenCV built without CUDA. Falling back to CPU.");
+            m_net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+            m_net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+#endif
+        } else {
+            m_net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+            m_net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+            LOG_INFO("OpenCvBackend: Using CPU inference.");
+        }
+    } catch (const cv::Exception& e) {
+        LOG_ERROR(std::string("OpenCvBackend: Exception loading model: ") + e.what());
+        return false;
+    }
+
+    if (m_net.empty()) {
+        LOG_ERROR("OpenCvBackend: Net is empty after loading " + options.modelPath);
+        return false;
+    }
+
+    // cv::dnn has a single process-wide pool, there's no inter-op setting
+    if (options.intraOpThreads > 0) {
+        cv::setNumThreads(options.intraOpThreads);
+    }
+    if (options.int8) {
+        // Quantized (QDQ) ONNX models are executed with int8 layers natively (OpenCV >= 4.6)
+        LOG_INFO("OpenCvBackend: Expecting an INT8-quantized model.");
+    }
+    return true;
+}
+
+bool OpenCvBackend::infer(const float* input, int batch, int channels, int height, int width,
+                          InferenceOutput& output) {
+    try {
+        // Header over the caller's blob, no copy
+        const int shape[4] = { batch, channels, height, width };
+        cv::Mat blob(4, shape, CV_32F, const_cast<float*>(input));
+        m_net.setInput(blob);
+        m_output = m_net.forward();
+    } catch (const cv::Exception& e) {
+        LOG_ERROR(std::string("OpenCvBackend: Exception during forward: ") + e.what());
+        return false;
+    }
+
+    output.data = reinterpret_cast<const float*>(m_output.data);
+    output.shape.clear();
+    for (int i = 0; i < m_output.dims; ++i) {
+        output.shape.push_back(m_output.size[i]);
+    }
+    return true;
+}
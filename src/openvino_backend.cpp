@@ -0,0 +1,75 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <openvino_backend.hpp>
+
+#ifdef ARITHA_WITH_OPENVINO
+
+#include <logger.hpp>
+
+bool OpenVinoBackend::load(const InferenceOptions& options) {
+    try {
+        std::shared_ptr<ov::Model> model = options.modelConfig.empty()
+            ? m_core.read_model(options.modelPath)
+            : m_core.read_model(options.modelPath, options.modelConfig);
+
+        // Any batch size, fixed input resolution
+        model->reshape(ov::PartialShape{ ov::Dimension::dynamic(), 3,
+                                         options.inputHeight, options.inputWidth });
+
+        ov::AnyMap config;
+        config.insert(ov::hint::performance_mode(ov::hint::PerformanceMode::LATENCY));
+        if (options.intraOpThreads > 0) {
+            config.insert(ov::inference_num_threads(options.intraOpThreads));
+        }
+        if (options.interOpThreads > 0) {
+            // Streams only pay off with a request in flight per stream; there is one
+            // synchronous request here, so the LATENCY hint's single stream it is
+            LOG_WARNING("OpenVinoBackend: aiInterOpThreads does not apply to OpenVINO, ignored.");
+        }
+        if (!options.int8) {
+            // Keep f32 results on CPUs where the plugin would otherwise drop to bf16.
+            // A quantized IR runs its INT8 kernels regardless.
+            config.insert(ov::hint::inference_precision(ov::element::f32));
+        }
+
+        if (options.useGPU) {
+            LOG_WARNING("OpenVinoBackend: GPU requested, using the CPU plugin.");
+        }
+        m_compiled = m_core.compile_model(model, "CPU", config);
+        m_request  = m_compiled.create_infer_request();
+    } catch (const std::exception& e) {
+        LOG_ERROR(std::string("OpenVinoBackend: Exception loading model: ") + e.what());
+        return false;
+    }
+
+    LOG_INFO("OpenVinoBackend: Compiled " + options.modelPath + " for CPU" +
+             (options.int8 ? " (INT8)." : "."));
+    return true;
+}
+
+bool OpenVinoBackend::infer(const float* input, int batch, int channels, int height, int width,
+                            InferenceOutput& output) {
+    try {
+        // Wraps the caller's blob, no copy
+        ov::Tensor tensor(ov::element::f32,
+                          ov::Shape{ static_cast<size_t>(batch), static_cast<size_t>(channels),
+                                     static_cast<size_t>(height), static_cast<size_t>(width) },
+                          const_cast<float*>(input));
+        m_request.set_input_tensor(tensor);
+        m_request.infer();
+        m_output = m_request.get_output_tensor();
+    } catch (const std::exception& e) {
+        LOG_ERROR(std::string("OpenVinoBackend: Exception during inference: ") + e.what());
+        return false;
+    }
+
+    output.data = m_output.data<const float>();
+    output.shape.clear();
+    for (size_t dim : m_output.get_shape()) {
+        output.shape.push_back(static_cast<int64_t>(dim));
+    }
+    return true;
+}
+
+#endif // ARITHA_WITH_OPENVINO
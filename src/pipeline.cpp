@@ -0,0 +1,441 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <pipeline.hpp>
+
+#include <algorithm>
+
+#include <ai_detector.hpp>
+#include <frame_overlay.hpp>
+#include <frame_reorderer.hpp>
+#include <frame_sink.hpp>
+#include <motion_detector.hpp>
+#include <mpmc_queue.hpp>
+#include <object_tracker.hpp>
+#include <rendition_scaler.hpp>
+
+namespace {
+
+// An idle pipeline re-polls after this, doubling up to the max while nothing arrives
+constexpr std::chrono::microseconds kMinIdleDelay{250};
+constexpr std::chrono::microseconds kMaxIdleDelay{4000};
+
+} // namespace
+
+Pipeline::Pipeline(const Config& config, const std::string& name, Executor* executor,
+                   InferenceBatcher* batcher)
+    : m_config(config)
+    , m_name(name)
+    , m_executor(executor)
+    , m_batcher(batcher)
+    , m_packetQueue(config.streamerQueueCapacity)
+{
+    // Whatever a queue drops is released here, so a slow consumer costs frames, not memory
+    auto freeFrame  = [](DecodedFrame& df) { releaseDecodedFrame(df); };
+    auto freePacket = [](EncodedPacket& ep) { av_packet_free(&ep.packet); };
+    auto isKeyPacket = [](const EncodedPacket& ep) {
+        return ep.packet && (ep.packet->flags & AV_PKT_FLAG_KEY);
+    };
+
+    // Passthrough: capture's packets go straight to the streamer, frames are only decoded
+    // (all, keyframes only, or none) when there are stages to analyse them, then dropped
+    const bool passthrough = config.passthrough;
+    const bool analysing = !config.pipelineStages.empty();
+    const bool ladder = !config.renditions.empty();
+
+    // One link into each stage, then the one into the encoder (or the sink).
+    // A pool's workers share their input and output, both MpmcQueues.
+    std::string from = "capture";
+    for (const StageConfig& stage : config.pipelineStages) {
+        if (stage.workers > 1) {
+            m_frameLinks.push_back(std::make_unique<MpmcQueue<DecodedFrame>>(stage.queueCapacity));
+            m_linkNames.push_back(from + "->" + stage.name + " x" + std::to_string(stage.workers));
+            m_frameLinks.push_back(std::make_unique<MpmcQueue<DecodedFrame>>(stage.queueCapacity));
+            m_linkNames.push_back(stage.name + "->reorder");
+        } else {
+            m_frameLinks.push_back(std::make_unique<BufferQueue<DecodedFrame>>(stage.queueCapacity));
+            m_linkNames.push_back(from + "->" + stage.name);
+        }
+        from = stage.name;
+    }
+    m_frameLinks.push_back(std::make_unique<BufferQueue<DecodedFrame>>(config.encoderQueueCapacity));
+    m_linkNames.push_back(from + (passthrough ? "->sink" : (ladder ? "->ladder" : "->encoder")));
+
+    // With no stages capture feeds the encoder directly and the capture policy applies
+    m_frameLinks.front()->setOverflowPolicy(config.captureQueuePolicy, freeFrame);
+    if (m_frameLinks.size() > 1) {
+        m_frameLinks.back()->setOverflowPolicy(config.encoderQueuePolicy, freeFrame);
+    }
+    m_packetQueue.setOverflowPolicy(config.streamerQueuePolicy, freePacket, isKeyPacket);
+
+    for (const StageConfig& stage : config.pipelineStages) {
+        if (stage.name == "ai") {
+            m_bus = std::make_unique<DetectionBus>();
+        }
+    }
+
+    CaptureOptions captureOptions;
+    InputOptions& input = captureOptions.input;
+    input.rtspTransport = config.rtspTransport;
+    input.probeSize = config.inputProbeSize;
+    input.analyzeDurationUs = static_cast<int64_t>(config.inputAnalyzeDurationMs) * 1000;
+    input.noBuffer = config.inputNoBuffer;
+    input.bufferSize = config.inputBufferSize;
+    input.maxDelayUs = config.inputMaxDelayMs >= 0 ? static_cast<int64_t>(config.inputMaxDelayMs) * 1000 : -1;
+    input.reorderQueueSize = config.inputReorderQueueSize;
+    input.timeoutUs = static_cast<int64_t>(config.inputTimeoutMs) * 1000;
+    input.cacheStreamInfo = config.cacheStreamInfo;
+    input.jitterBufferMs = config.jitterBufferMs;
+    input.jitterBufferPackets = static_cast<size_t>(config.jitterBufferPackets);
+    captureOptions.reconnectInitialMs = config.reconnectInitialMs;
+    captureOptions.standbyUrl = config.standbyUrl;
+    captureOptions.decoderThreads = std::max(0, config.decoderThreads); // Supervisor resolves -1 for several cameras
+    captureOptions.decoderThreadType = parseDecoderThreadType(config.decoderThreadType);
+    if (!config.hwDecode.empty()) {
+        captureOptions.hwDecode = parseHwDecode(config.hwDecode);
+    } else if (config.enableHardwareAccel) {
+        captureOptions.hwDecode = HwDecode::Auto;
+    }
+    captureOptions.hwDevice = config.hwDecodeDevice;
+    captureOptions.hwMap = config.hwDecodeMap;
+    captureOptions.hwExtraFrames = config.hwDecodeExtraFrames;
+    HwEncodeOptions hwEncode;
+    if (!config.hwEncode.empty()) {
+        hwEncode.mode = parseHwEncode(config.hwEncode);
+    } else if (config.enableHardwareAccel) {
+        hwEncode.mode = HwEncode::Auto;
+    }
+    hwEncode.device = config.hwEncodeDevice;
+    // One encoder at the decoded size can encode the decoder's surfaces in place
+    captureOptions.keepHwFrames = (hwEncode.mode != HwEncode::None && !passthrough && !ladder);
+    std::shared_ptr<StreamInfo> streamInfo;
+    if (!passthrough && (config.analysisFps > 0.0 || config.decodeLowres > 0 || config.decodeSkipLoopFilter)) {
+        LOG_WARNING("Pipeline " + m_name + ": analysisFps/decodeLowres/decodeSkipLoopFilter only apply "
+                    "to passthrough, the encoder needs every full frame.");
+    }
+    if (passthrough) {
+        streamInfo = std::make_shared<StreamInfo>();
+        captureOptions.decode = analysing ? parseDecodeMode(config.analysisDecode) : DecodeMode::None;
+        captureOptions.analysisFps = config.analysisFps;
+        captureOptions.lowres = config.decodeLowres;
+        captureOptions.skipLoopFilter = config.decodeSkipLoopFilter;
+        captureOptions.packetQueue = &m_packetQueue;
+        captureOptions.streamInfo = streamInfo;
+    }
+    m_capture = std::make_unique<VideoCapture>(config.inputUrl,
+                                               *m_frameLinks.front(),
+                                               config.reconnectOnFailure,
+                                               config.reconnectDelaySecs,
+                                               captureOptions);
+    size_t link = 0;
+    for (const StageConfig& stage : config.pipelineStages) {
+        QueueInterface<DecodedFrame>& in = *m_frameLinks[link];
+        if (stage.workers > 1) {
+            QueueInterface<DecodedFrame>& done = *m_frameLinks[link + 1];
+            QueueInterface<DecodedFrame>& out = *m_frameLinks[link + 2];
+            // One gate for the pool, so the stride and rechecks count the stage's frames
+            auto gate = (stage.name == "ai") ? std::make_shared<AIGate>(aiGateOptions()) : nullptr;
+            for (int w = 0; w < stage.workers; ++w) {
+                m_stages.push_back({ stage.name, makeStage(stage.name, in, done, gate), &done, true });
+            }
+            // Room for everything in flight between the pool's input and the reorderer
+            const size_t window = done.capacity() + static_cast<size_t>(stage.workers) * config.aiBatchSize;
+            m_stages.push_back({ "reorder", std::make_unique<FrameReorderer>(done, out, window), &out, false });
+            link += 2;
+        } else {
+            QueueInterface<DecodedFrame>& out = *m_frameLinks[link + 1];
+            // Sync inference runs the forward pass itself: on an executor worker that
+            // would hold the slice for whole batches and could never wait to fill one
+            const bool ownThread = (stage.name == "ai" && !config.aiAsync);
+            m_stages.push_back({ stage.name, makeStage(stage.name, in, out), &out, ownThread });
+            link += 1;
+        }
+    }
+    if (ladder) {
+        // Every rendition gets the link sizes and policies of the single-output chain
+        std::vector<RenditionTarget> targets;
+        for (const RenditionConfig& rc : config.renditions) {
+            CodecConfig codec = config.codecConfig();
+            if (rc.bitrateKbps > 0) {
+                // Under crf the rendition's bitrate is the cap
+                if (codec.rateControl == RateControl::Crf) {
+                    codec.maxBitrateKbps = rc.bitrateKbps;
+                } else {
+                    codec.bitrateKbps = rc.bitrateKbps;
+                }
+            }
+            Rendition r;
+            r.name = rc.name;
+            r.frames = std::make_unique<BufferQueue<DecodedFrame>>(config.encoderQueueCapacity);
+            r.frames->setOverflowPolicy(config.encoderQueuePolicy, freeFrame);
+            r.packets = std::make_unique<BufferQueue<EncodedPacket>>(config.streamerQueueCapacity);
+            r.packets->setOverflowPolicy(config.streamerQueuePolicy, freePacket, isKeyPacket);
+            auto renditionInfo = std::make_shared<StreamInfo>();
+            r.encoder = std::make_unique<VideoEncoder>(*r.frames, *r.packets, rc.width, rc.height, config.fps,
+                                                       config.codecName, hwEncode, codec, renditionInfo);
+            r.streamer = std::make_unique<VideoStreamer>(*r.packets, rc.outputUrl, renditionInfo);
+            targets.push_back({ rc.width, rc.height, r.frames.get() });
+            m_renditions.push_back(std::move(r));
+        }
+        m_stages.push_back({ "ladder", std::make_unique<RenditionScaler>(*m_frameLinks.back(), targets), nullptr, false });
+    } else if (!passthrough) {
+        streamInfo = std::make_shared<StreamInfo>();
+        m_encoder = std::make_unique<VideoEncoder>(*m_frameLinks.back(),
+                                                   m_packetQueue,
+                                                   config.width,
+                                                   config.height,
+                                                   config.fps,
+                                                   config.codecName,
+                                                   hwEncode,
+                                                   config.codecConfig(),
+                                                   streamInfo);
+    } else if (analysing) {
+        // Runs like any other stage, threaded or on the executor
+        m_stages.push_back({ "sink", std::make_unique<FrameSink>(*m_frameLinks.back()), nullptr, false });
+    }
+    if (!ladder) {
+        m_streamer = std::make_unique<VideoStreamer>(m_packetQueue, config.outputUrl, streamInfo);
+    }
+
+    std::string topology = "capture";
+    for (size_t i = 0; i < m_stages.size(); ++i) {
+        size_t workers = 1;
+        while (m_stages[i].ownThread && i + 1 < m_stages.size() && m_stages[i + 1].ownThread &&
+               m_stages[i + 1].name == m_stages[i].name) {
+            ++workers;
+            ++i;
+        }
+        topology += " -> " + m_stages[i].name + (workers > 1 ? " x" + std::to_string(workers) : "");
+    }
+    if (passthrough) {
+        LOG_INFO("Pipeline " + m_name + ": capture -> streamer (passthrough)" +
+                 (analysing ? ", analysing " + config.analysisDecode + ": " + topology : ""));
+    } else if (ladder) {
+        std::string names;
+        for (const Rendition& r : m_renditions) {
+            names += (names.empty() ? "" : ", ") + r.name;
+        }
+        LOG_INFO("Pipeline " + m_name + ": " + topology + " -> " + std::to_string(m_renditions.size()) +
+                 " x (encoder -> streamer): " + names + (m_executor ? " (stages on the shared executor)" : ""));
+    } else {
+        LOG_INFO("Pipeline " + m_name + ": " + topology + " -> encoder -> streamer" +
+                 (m_executor ? " (stages on the shared executor)" : ""));
+    }
+}
+
+Pipeline::~Pipeline() {
+    stop();
+}
+
+AIGateOptions Pipeline::aiGateOptions() const {
+    AIGateOptions gate;
+    gate.motionGated     = m_config.aiMotionGated;
+    gate.recheckInterval = std::chrono::milliseconds(m_config.aiRecheckIntervalMs);
+    gate.keepAlive       = std::chrono::milliseconds(m_config.aiMotionKeepAliveMs);
+    gate.detectionStride = m_config.aiDetectionStride;
+    return gate;
+}
+
+std::unique_ptr<PipelineStage> Pipeline::makeStage(const std::string& name,
+                                                   QueueInterface<DecodedFrame>& in,
+                                                   QueueInterface<DecodedFrame>& out,
+                                                   std::shared_ptr<AIGate> poolGate) {
+    const Config& cfg = m_config;
+    if (name == "motion") {
+        MotionOptions options;
+        options.downscale = cfg.motionDownscale;
+        options.zoneRows  = cfg.motionZoneRows;
+        options.zoneCols  = cfg.motionZoneCols;
+        for (char c : cfg.motionZoneMask) {
+            options.zoneEnabled.push_back(c == '1');
+        }
+        options.excludePolygons = cfg.motionExcludePolygons;
+        return std::make_unique<MotionDetector>(in, out, cfg.motionThreshold, cfg.motionFrameInterval, options);
+    }
+
+    if (name == "ai") {
+        AIBatchOptions batch;
+        batch.maxBatch = cfg.aiBatchSize;
+        batch.maxWait  = std::chrono::milliseconds(cfg.aiBatchMaxWaitMs);
+
+        AIAsyncOptions async;
+        async.enabled    = cfg.aiAsync;
+        async.workers    = cfg.aiAsyncWorkers;
+        async.queueDepth = static_cast<size_t>(cfg.aiAsyncQueueDepth);
+
+        return std::make_unique<AIDetector>(in, out, cfg.inferenceOptions(), aiGateOptions(), batch,
+                                            cfg.detectionDecoderOptions(), async, m_bus.get(), m_batcher,
+                                            std::move(poolGate));
+    }
+
+    if (name == "tracker") {
+        SortOptions options;
+        options.maxAge       = cfg.trackerMaxAge;
+        options.minHits      = cfg.trackerMinHits;
+        options.iouThreshold = cfg.trackerIouThreshold;
+        // Async results never reach the frame, the tracker has to pick them up off the bus
+        return std::make_unique<ObjectTracker>(in, out, options, cfg.aiAsync ? m_bus.get() : nullptr);
+    }
+
+    // Config::validate() only lets the four names through. Without a tracker to
+    // pick them up, async results have to come off the bus here too.
+    const bool tracked = std::any_of(cfg.pipelineStages.begin(), cfg.pipelineStages.end(),
+                                     [](const StageConfig& stage) { return stage.name == "tracker"; });
+    return std::make_unique<FrameOverlay>(in, out, cfg.overlayThickness,
+                                          (cfg.aiAsync && !tracked) ? m_bus.get() : nullptr);
+}
+
+void Pipeline::start() {
+    m_capture->start();
+    for (Stage& stage : m_stages) {
+        if (m_executor && !stage.ownThread) {
+            stage.module->startPolled();
+        } else {
+            stage.module->start();
+        }
+    }
+    if (m_encoder) {
+        m_encoder->start();
+    }
+    if (m_streamer) {
+        m_streamer->start();
+    }
+    for (Rendition& r : m_renditions) {
+        r.encoder->start();
+        r.streamer->start();
+    }
+
+    if (m_executor && !m_stages.empty() && !m_slice) {
+        m_slice = std::make_shared<SliceControl>();
+        m_idleDelay = kMinIdleDelay;
+        scheduleSlice(std::chrono::microseconds(0));
+    }
+}
+
+void Pipeline::scheduleSlice(std::chrono::microseconds delay) {
+    auto control = m_slice;
+    auto task = [this, control] {
+        std::lock_guard<std::mutex> lock(control->mutex);
+        if (control->active) {
+            runSlice();
+        }
+    };
+    if (delay.count() == 0) {
+        m_executor->submit(std::move(task));
+    } else {
+        m_executor->submitAfter(delay, std::move(task));
+    }
+}
+
+void Pipeline::runSlice() {
+    // In pipeline order, so a frame can make it through every stage in one turn
+    const size_t budget = static_cast<size_t>(m_config.executorSliceFrames);
+    size_t handled = 0;
+    for (Stage& stage : m_stages) {
+        if (!stage.ownThread) {
+            handled += stage.module->poll(budget);
+        }
+    }
+
+    if (handled > 0) {
+        m_idleDelay = kMinIdleDelay;
+        scheduleSlice(std::chrono::microseconds(0));
+    } else {
+        scheduleSlice(m_idleDelay);
+        m_idleDelay = std::min(m_idleDelay * 2, kMaxIdleDelay);
+    }
+}
+
+void Pipeline::stop() {
+    m_capture->stop();
+    m_frameLinks.front()->shutdown();
+    if (m_slice) {
+        // Waits out a slice in progress; queued ones find the flag down and do nothing
+        {
+            std::lock_guard<std::mutex> lock(m_slice->mutex);
+            m_slice->active = false;
+        }
+        m_slice.reset();
+    }
+    for (size_t i = 0; i < m_stages.size(); ++i) {
+        m_stages[i].module->stop();
+        // A pool's output closes behind its last worker
+        QueueInterface<DecodedFrame>* out = m_stages[i].out;
+        if (out && (i + 1 == m_stages.size() || m_stages[i + 1].out != out)) {
+            out->shutdown();
+        }
+    }
+    if (m_encoder) {
+        m_encoder->stop();
+    }
+    m_packetQueue.shutdown();
+    if (m_streamer) {
+        m_streamer->stop();
+    }
+    // The ladder has stopped feeding them; each encoder then its streamer, as above
+    for (Rendition& r : m_renditions) {
+        r.frames->shutdown();
+    }
+    for (Rendition& r : m_renditions) {
+        r.encoder->stop();
+        r.packets->shutdown();
+    }
+    for (Rendition& r : m_renditions) {
+        r.streamer->stop();
+    }
+}
+
+bool Pipeline::isRunning() const {
+    if (!m_capture->isRunning() || (m_encoder && !m_encoder->isRunning()) ||
+        (m_streamer && !m_streamer->isRunning())) {
+        return false;
+    }
+    for (const Rendition& r : m_renditions) {
+        if (!r.encoder->isRunning() || !r.streamer->isRunning()) {
+            return false;
+        }
+    }
+    for (const Stage& stage : m_stages) {
+        if (!stage.module->isRunning()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t Pipeline::framesCaptured() const {
+    return m_frameLinks.front()->stats().enqueued;
+}
+
+CaptureStats Pipeline::captureStats() const {
+    return m_capture->stats();
+}
+
+uint64_t Pipeline::droppedItems() const {
+    uint64_t dropped = m_packetQueue.stats().dropped();
+    for (const auto& link : m_frameLinks) {
+        dropped += link->stats().dropped();
+    }
+    for (const Rendition& r : m_renditions) {
+        dropped += r.frames->stats().dropped() + r.packets->stats().dropped();
+    }
+    return dropped;
+}
+
+void Pipeline::logQueueStats() const {
+    auto logDrops = [](const std::string& name, const QueueStats& s) {
+        LOG_INFO(name + ": enqueued=" + std::to_string(s.enqueued) +
+                 " droppedNewest=" + std::to_string(s.droppedNewest) +
+                 " droppedOldest=" + std::to_string(s.droppedOldest));
+    };
+    for (size_t i = 0; i < m_frameLinks.size(); ++i) {
+        logDrops(m_name + " " + m_linkNames[i], m_frameLinks[i]->stats());
+    }
+    for (const Rendition& r : m_renditions) {
+        logDrops(m_name + " ladder->" + r.name + " encoder", r.frames->stats());
+        logDrops(m_name + " " + r.name + " encoder->streamer", r.packets->stats());
+    }
+    if (m_streamer) {
+        logDrops(m_name + (m_encoder ? " encoder->streamer" : " capture->streamer"), m_packetQueue.stats());
+    }
+}
@@ -0,0 +1,162 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <rendition_scaler.hpp>
+
+#include <algorithm>
+
+RenditionScaler::RenditionScaler(QueueInterface<DecodedFrame>& inQueue,
+                                 const std::vector<RenditionTarget>& targets,
+                                 AVPixelFormat format)
+    : m_inQueue(inQueue)
+    , m_format(format)
+{
+    for (const RenditionTarget& target : targets) {
+        Level level;
+        level.target = target;
+        level.pool = std::make_shared<FramePool>(32);
+        m_levels.push_back(level);
+    }
+    // The cascade runs big to small
+    std::stable_sort(m_levels.begin(), m_levels.end(), [](const Level& a, const Level& b) {
+        return a.target.width * a.target.height > b.target.width * b.target.height;
+    });
+}
+
+RenditionScaler::~RenditionScaler() {
+    stop();
+    for (Level& level : m_levels) {
+        if (level.swsCtx) {
+            sws_freeContext(level.swsCtx);
+            level.swsCtx = nullptr;
+        }
+    }
+}
+
+void RenditionScaler::start() {
+    if (m_running.load()) return;
+    m_running.store(true);
+    m_thread = std::thread(&RenditionScaler::scalerLoop, this);
+}
+
+void RenditionScaler::startPolled() {
+    m_running.store(true);
+}
+
+void RenditionScaler::stop() {
+    if (!m_running.load()) return;
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    LOG_INFO("RenditionScaler: " + std::to_string(m_framesScaled) + " renditions scaled, " +
+             std::to_string(m_framesShared) + " shared as is.");
+}
+
+void RenditionScaler::scalerLoop() {
+    while (m_running.load()) {
+        auto maybeFrame = m_inQueue.popBlocking(kQueueWait);
+        if (!maybeFrame.has_value()) {
+            continue;
+        }
+        DecodedFrame df = std::move(maybeFrame.value());
+        process(df);
+    }
+    m_running.store(false);
+}
+
+bool RenditionScaler::roomLeft() const {
+    for (const Level& level : m_levels) {
+        if (level.target.queue->size() >= level.target.queue->capacity()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t RenditionScaler::poll(size_t budget) {
+    size_t handled = 0;
+    while (handled < budget && m_running.load() && roomLeft()) {
+        auto maybeFrame = m_inQueue.pop();
+        if (!maybeFrame.has_value()) {
+            break;
+        }
+        DecodedFrame df = std::move(maybeFrame.value());
+        process(df);
+        ++handled;
+    }
+    return handled;
+}
+
+AVFrame* RenditionScaler::scale(const AVFrame* src, Level& level) {
+    const int width  = level.target.width;
+    const int height = level.target.height;
+    AVFrame* dst = level.pool->acquireFrame();
+    if (src->format == m_format && src->width == width && src->height == height) {
+        // Already the right picture: another reference, no copy
+        if (av_frame_ref(dst, src) < 0) {
+            level.pool->releaseFrame(dst);
+            return nullptr;
+        }
+        ++m_framesShared;
+        return dst;
+    }
+
+    level.swsCtx = sws_getCachedContext(level.swsCtx,
+                                        src->width, src->height, static_cast<AVPixelFormat>(src->format),
+                                        width, height, m_format,
+                                        SWS_BILINEAR, nullptr, nullptr, nullptr);
+    dst->format = m_format;
+    dst->width  = width;
+    dst->height = height;
+    if (!level.swsCtx || (!level.pool->allocBuffers(dst) && av_frame_get_buffer(dst, 0) < 0)) {
+        level.pool->releaseFrame(dst);
+        return nullptr;
+    }
+    sws_scale(level.swsCtx, src->data, src->linesize, 0, src->height, dst->data, dst->linesize);
+    av_frame_copy_props(dst, src);
+    ++m_framesScaled;
+    return dst;
+}
+
+void RenditionScaler::process(DecodedFrame& df) {
+    if (!df.frame) {
+        return;
+    }
+
+    // Scale every level before handing any of them on: the encoders release
+    // their frames whenever they like, and the next level still reads this one
+    const AVFrame* src = df.frame;
+    for (Level& level : m_levels) {
+        level.out = scale(src, level);
+        if (level.out) {
+            src = level.out;
+        } else {
+            LOG_ERROR("RenditionScaler: Could not scale to " + std::to_string(level.target.width) + "x" +
+                      std::to_string(level.target.height) + ".");
+        }
+    }
+
+    for (Level& level : m_levels) {
+        if (!level.out) {
+            continue;
+        }
+        DecodedFrame out;
+        out.frame = level.out;
+        out.pts = df.pts;
+        out.timeBase = df.timeBase;
+        out.pool = level.pool;
+        level.out = nullptr;
+        forward(*level.target.queue, out);
+    }
+    releaseDecodedFrame(df);
+}
+
+void RenditionScaler::forward(QueueInterface<DecodedFrame>& out, DecodedFrame& df) {
+    while (!out.enqueue(std::move(df), kQueueWait)) {
+        if (!m_running.load() || out.isShutdown()) {
+            releaseDecodedFrame(df);
+            break;
+        }
+    }
+}
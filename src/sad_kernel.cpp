@@ -0,0 +1,135 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <sad_kernel.hpp>
+
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ARITHA_SAD_X86 1
+#endif
+
+namespace {
+
+inline uint32_t rowTail(const uint8_t* a, const uint8_t* b, int from, int width) {
+    uint32_t sum = 0;
+    for (int x = from; x < width; ++x) {
+        sum += static_cast<uint32_t>(std::abs(static_cast<int>(a[x]) - static_cast<int>(b[x])));
+    }
+    return sum;
+}
+
+#ifdef ARITHA_SAD_X86
+
+__attribute__((target("sse2")))
+uint64_t sumAbsDiffSse2(const uint8_t* a, int strideA, const uint8_t* b, int strideB,
+                        int width, int height) {
+    uint64_t total = 0;
+    const int vecWidth = width & ~15;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* rowA = a + static_cast<intptr_t>(y) * strideA;
+        const uint8_t* rowB = b + static_cast<intptr_t>(y) * strideB;
+        __m128i acc = _mm_setzero_si128();
+        for (int x = 0; x < vecWidth; x += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rowA + x));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rowB + x));
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+        }
+        total += static_cast<uint64_t>(_mm_cvtsi128_si64(acc)) +
+                 static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc)));
+        total += rowTail(rowA, rowB, vecWidth, width);
+    }
+    return total;
+}
+
+__attribute__((target("avx2")))
+uint64_t sumAbsDiffAvx2(const uint8_t* a, int strideA, const uint8_t* b, int strideB,
+                        int width, int height) {
+    uint64_t total = 0;
+    const int vecWidth = width & ~31;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* rowA = a + static_cast<intptr_t>(y) * strideA;
+        const uint8_t* rowB = b + static_cast<intptr_t>(y) * strideB;
+        __m256i acc = _mm256_setzero_si256();
+        for (int x = 0; x < vecWidth; x += 32) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rowA + x));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rowB + x));
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, vb));
+        }
+        __m128i sum128 = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        total += static_cast<uint64_t>(_mm_cvtsi128_si64(sum128)) +
+                 static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(sum128, sum128)));
+        total += rowTail(rowA, rowB, vecWidth, width);
+    }
+    return total;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+uint64_t sumAbsDiffAvx512(const uint8_t* a, int strideA, const uint8_t* b, int strideB,
+                          int width, int height) {
+    uint64_t total = 0;
+    const int vecWidth = width & ~63;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* rowA = a + static_cast<intptr_t>(y) * strideA;
+        const uint8_t* rowB = b + static_cast<intptr_t>(y) * strideB;
+        __m512i acc = _mm512_setzero_si512();
+        for (int x = 0; x < vecWidth; x += 64) {
+            __m512i va = _mm512_loadu_si512(rowA + x);
+            __m512i vb = _mm512_loadu_si512(rowB + x);
+            acc = _mm512_add_epi64(acc, _mm512_sad_epu8(va, vb));
+        }
+        alignas(64) uint64_t lanes[8];
+        _mm512_store_si512(lanes, acc);
+        for (uint64_t lane : lanes) total += lane;
+        total += rowTail(rowA, rowB, vecWidth, width);
+    }
+    return total;
+}
+
+#endif // ARITHA_SAD_X86
+
+using SadFn = uint64_t (*)(const uint8_t*, int, const uint8_t*, int, int, int);
+
+struct SadKernel {
+    SadFn fn;
+    const char* name;
+};
+
+SadKernel pickKernel() {
+#ifdef ARITHA_SAD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) return {sumAbsDiffAvx512, "avx512bw"};
+    if (__builtin_cpu_supports("avx2"))     return {sumAbsDiffAvx2, "avx2"};
+    if (__builtin_cpu_supports("sse2"))     return {sumAbsDiffSse2, "sse2"};
+#endif
+    return {sumAbsDiffScalar, "scalar"};
+}
+
+const SadKernel& kernel() {
+    static const SadKernel s_kernel = pickKernel();
+    return s_kernel;
+}
+
+} // namespace
+
+uint64_t sumAbsDiffScalar(const uint8_t* a, int strideA,
+                          const uint8_t* b, int strideB,
+                          int width, int height) {
+    uint64_t total = 0;
+    for (int y = 0; y < height; ++y) {
+        total += rowTail(a + static_cast<intptr_t>(y) * strideA,
+                         b + static_cast<intptr_t>(y) * strideB, 0, width);
+    }
+    return total;
+}
+
+uint64_t sumAbsDiff(const uint8_t* a, int strideA,
+                    const uint8_t* b, int strideB,
+                    int width, int height) {
+    return kernel().fn(a, strideA, b, strideB, width, height);
+}
+
+const char* sumAbsDiffKernelName() {
+    return kernel().name;
+}
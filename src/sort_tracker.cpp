@@ -0,0 +1,234 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <sort_tracker.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Noise settings from the reference SORT implementation
+constexpr float kMeasNoise[4]   = { 1.f, 1.f, 10.f, 10.f };
+constexpr float kProcNoise[7]   = { 1.f, 1.f, 1.f, 1.f, 0.01f, 0.01f, 0.0001f };
+constexpr float kInitVar        = 10.f;
+constexpr float kInitVelVar     = 10000.f; // velocities are unknown until the second detection
+
+// Inverse of a 4x4 (Gauss-Jordan with partial pivoting). False if singular.
+bool invert4(float m[4][4], float inv[4][4]) {
+    float a[4][8];
+    for (int r = 0; r < 4; ++r) {
+        for (int c = 0; c < 4; ++c) {
+            a[r][c] = m[r][c];
+            a[r][c + 4] = (r == c) ? 1.f : 0.f;
+        }
+    }
+    for (int c = 0; c < 4; ++c) {
+        int pivot = c;
+        for (int r = c + 1; r < 4; ++r) {
+            if (std::fabs(a[r][c]) > std::fabs(a[pivot][c])) pivot = r;
+        }
+        if (std::fabs(a[pivot][c]) < 1e-12f) return false;
+        if (pivot != c) {
+            for (int k = 0; k < 8; ++k) std::swap(a[c][k], a[pivot][k]);
+        }
+        const float d = 1.f / a[c][c];
+        for (int k = 0; k < 8; ++k) a[c][k] *= d;
+        for (int r = 0; r < 4; ++r) {
+            if (r == c) continue;
+            const float f = a[r][c];
+            if (f == 0.f) continue;
+            for (int k = 0; k < 8; ++k) a[r][k] -= f * a[c][k];
+        }
+    }
+    for (int r = 0; r < 4; ++r) {
+        for (int c = 0; c < 4; ++c) inv[r][c] = a[r][c + 4];
+    }
+    return true;
+}
+
+} // namespace
+
+SortTracker::SortTracker(const SortOptions& options)
+    : m_options(options)
+{
+}
+
+std::array<float, SortTracker::kMeas> SortTracker::toMeasurement(const DetectionBox& det) {
+    const float w = std::max(det.width, 1e-3f);
+    const float h = std::max(det.height, 1e-3f);
+    return { det.x + w / 2, det.y + h / 2, w * h, w / h };
+}
+
+DetectionBox SortTracker::toBox(const Track& t) {
+    const float s = std::max(t.x[2], 0.f);
+    const float r = std::max(t.x[3], 1e-3f);
+    const float w = std::sqrt(s * r);
+    const float h = w > 0.f ? s / w : 0.f;
+    DetectionBox box;
+    box.x = t.x[0] - w / 2;
+    box.y = t.x[1] - h / 2;
+    box.width = w;
+    box.height = h;
+    box.confidence = t.confidence;
+    box.classId = t.classId;
+    box.trackId = t.id;
+    return box;
+}
+
+float SortTracker::iou(const DetectionBox& a, const DetectionBox& b) {
+    const float x1 = std::max(a.x, b.x);
+    const float y1 = std::max(a.y, b.y);
+    const float x2 = std::min(a.x + a.width, b.x + b.width);
+    const float y2 = std::min(a.y + a.height, b.y + b.height);
+    const float inter = std::max(0.f, x2 - x1) * std::max(0.f, y2 - y1);
+    const float uni = a.width * a.height + b.width * b.height - inter;
+    return uni > 0.f ? inter / uni : 0.f;
+}
+
+SortTracker::Track SortTracker::startTrack(const DetectionBox& det) {
+    Track t;
+    t.id = m_nextId++;
+    t.classId = det.classId;
+    t.confidence = det.confidence;
+    const auto z = toMeasurement(det);
+    t.x = { z[0], z[1], z[2], z[3], 0.f, 0.f, 0.f };
+    for (auto& row : t.P) row.fill(0.f);
+    for (int i = 0; i < kState; ++i) {
+        t.P[i][i] = (i < kMeas) ? kInitVar : kInitVelVar;
+    }
+    return t;
+}
+
+void SortTracker::predict(Track& t) const {
+    // Don't let the area go negative
+    if (t.x[2] + t.x[6] <= 0.f) {
+        t.x[6] = 0.f;
+    }
+    // x = F x, F adds the velocity of states 4..6 to 0..2
+    t.x[0] += t.x[4];
+    t.x[1] += t.x[5];
+    t.x[2] += t.x[6];
+
+    // P = F P F^T + Q, written out for the sparse F
+    Cov fp = t.P;
+    for (int c = 0; c < kState; ++c) {
+        fp[0][c] += t.P[4][c];
+        fp[1][c] += t.P[5][c];
+        fp[2][c] += t.P[6][c];
+    }
+    Cov fpf = fp;
+    for (int r = 0; r < kState; ++r) {
+        fpf[r][0] += fp[r][4];
+        fpf[r][1] += fp[r][5];
+        fpf[r][2] += fp[r][6];
+    }
+    for (int i = 0; i < kState; ++i) {
+        fpf[i][i] += kProcNoise[i];
+    }
+    t.P = fpf;
+}
+
+void SortTracker::correct(Track& t, const DetectionBox& det) const {
+    const auto z = toMeasurement(det);
+
+    // H picks the first four states, so H P H^T is P's top-left block and P H^T its first four columns
+    float S[4][4];
+    for (int r = 0; r < kMeas; ++r) {
+        for (int c = 0; c < kMeas; ++c) {
+            S[r][c] = t.P[r][c] + (r == c ? kMeasNoise[r] : 0.f);
+        }
+    }
+    float Sinv[4][4];
+    if (!invert4(S, Sinv)) {
+        return;
+    }
+
+    // K = P H^T S^-1 (7x4)
+    float K[kState][kMeas];
+    for (int r = 0; r < kState; ++r) {
+        for (int c = 0; c < kMeas; ++c) {
+            float sum = 0.f;
+            for (int k = 0; k < kMeas; ++k) sum += t.P[r][k] * Sinv[k][c];
+            K[r][c] = sum;
+        }
+    }
+
+    float y[kMeas];
+    for (int i = 0; i < kMeas; ++i) y[i] = z[i] - t.x[i];
+    for (int r = 0; r < kState; ++r) {
+        for (int k = 0; k < kMeas; ++k) t.x[r] += K[r][k] * y[k];
+    }
+
+    // P = (I - K H) P
+    Cov P = t.P;
+    for (int r = 0; r < kState; ++r) {
+        for (int c = 0; c < kState; ++c) {
+            float sum = 0.f;
+            for (int k = 0; k < kMeas; ++k) sum += K[r][k] * t.P[k][c];
+            P[r][c] -= sum;
+        }
+    }
+    t.P = P;
+
+    t.confidence = det.confidence;
+    t.hits++;
+    t.timeSinceUpdate = 0;
+}
+
+const std::vector<DetectionBox>& SortTracker::step(const std::vector<DetectionBox>* detections) {
+    ++m_frameCount;
+
+    m_predicted.clear();
+    for (Track& t : m_tracks) {
+        predict(t);
+        t.timeSinceUpdate++;
+        m_predicted.push_back(toBox(t));
+    }
+
+    if (detections) {
+        const auto& dets = *detections;
+
+        // Every track/detection pair of the same class above the threshold, best first
+        m_pairs.clear();
+        for (size_t ti = 0; ti < m_tracks.size(); ++ti) {
+            for (size_t di = 0; di < dets.size(); ++di) {
+                if (dets[di].classId != m_tracks[ti].classId) continue;
+                const float v = iou(m_predicted[ti], dets[di]);
+                if (v >= m_options.iouThreshold) {
+                    m_pairs.push_back({ v, static_cast<int>(ti), static_cast<int>(di) });
+                }
+            }
+        }
+        std::sort(m_pairs.begin(), m_pairs.end(), [](const Pair& a, const Pair& b) { return a.iou > b.iou; });
+
+        m_trackMatched.assign(m_tracks.size(), 0);
+        m_detMatched.assign(dets.size(), 0);
+        for (const Pair& p : m_pairs) {
+            if (m_trackMatched[p.track] || m_detMatched[p.det]) continue;
+            m_trackMatched[p.track] = 1;
+            m_detMatched[p.det] = 1;
+            correct(m_tracks[p.track], dets[p.det]);
+        }
+
+        for (size_t di = 0; di < dets.size(); ++di) {
+            if (!m_detMatched[di]) {
+                m_tracks.push_back(startTrack(dets[di]));
+            }
+        }
+    }
+
+    // Forget tracks that have gone unmatched for too long
+    m_tracks.erase(std::remove_if(m_tracks.begin(), m_tracks.end(), [this](const Track& t) {
+        return t.timeSinceUpdate > m_options.maxAge;
+    }), m_tracks.end());
+
+    // Report confirmed tracks; right after start-up there's no history, so report what we have
+    m_output.clear();
+    for (const Track& t : m_tracks) {
+        if (t.hits >= m_options.minHits || m_frameCount <= m_options.minHits) {
+            m_output.push_back(toBox(t));
+        }
+    }
+    return m_output;
+}
@@ -0,0 +1,169 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <standby_input.hpp>
+
+#include <logger.hpp>
+
+StandbyInput::StandbyInput(const std::string& url, Opener opener, const std::atomic<bool>& running,
+                           std::chrono::milliseconds retryDelay, size_t maxGopPackets)
+    : m_opener(std::move(opener))
+    , m_running(running)
+    , m_retryDelay(retryDelay)
+    , m_maxGopPackets(maxGopPackets > 0 ? maxGopPackets : 1)
+    , m_url(url)
+{
+}
+
+StandbyInput::~StandbyInput() {
+    stop();
+}
+
+void StandbyInput::start() {
+    if (m_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = false;
+    }
+    m_thread = std::thread(&StandbyInput::run, this);
+}
+
+void StandbyInput::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    closeConnection();
+}
+
+bool StandbyInput::active() const {
+    return m_running.load() && !m_stop;
+}
+
+bool StandbyInput::ready() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_ready;
+}
+
+void StandbyInput::closeConnection() {
+    for (AVPacket*& packet : m_conn.gop) {
+        av_packet_free(&packet);
+    }
+    m_conn.gop.clear();
+    if (m_conn.fmtCtx) {
+        avformat_close_input(&m_conn.fmtCtx);
+    }
+    m_conn.videoStreamIndex = -1;
+    m_ready = false;
+}
+
+void StandbyInput::cachePacket(const AVPacket* packet) {
+    if (packet->flags & AV_PKT_FLAG_KEY) {
+        for (AVPacket*& old : m_conn.gop) {
+            av_packet_free(&old);
+        }
+        m_conn.gop.clear();
+    } else if (m_conn.gop.empty() || m_conn.gop.size() >= m_maxGopPackets) {
+        // Nothing to decode from yet, or a GOP too long to keep: wait for the next keyframe
+        for (AVPacket*& old : m_conn.gop) {
+            av_packet_free(&old);
+        }
+        m_conn.gop.clear();
+        return;
+    }
+    if (AVPacket* ref = av_packet_clone(packet)) {
+        m_conn.gop.push_back(ref);
+    }
+}
+
+bool StandbyInput::take(StandbyConnection& out, const std::string& nextUrl, std::chrono::milliseconds wait) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_ready) {
+        return false;
+    }
+    m_nextUrl = nextUrl;
+    m_wantHandover = true;
+    if (!m_cv.wait_for(lock, wait, [this] { return m_handedOver || !m_ready || m_stop; }) || !m_handedOver) {
+        // Reader stuck in a read, or its connection just died
+        m_wantHandover = false;
+        return false;
+    }
+    out = std::move(m_conn);
+    m_conn = StandbyConnection();
+    m_handedOver = false;
+    m_ready = false;
+    lock.unlock();
+    m_cv.notify_all();
+    return true;
+}
+
+void StandbyInput::run() {
+    AVPacket* packet = av_packet_alloc();
+    while (active()) {
+        std::string url;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            url = m_url;
+        }
+        AVFormatContext* fmtCtx = m_opener(url);
+        int videoIndex = -1;
+        for (unsigned int i = 0; fmtCtx && i < fmtCtx->nb_streams; i++) {
+            if (fmtCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+                videoIndex = static_cast<int>(i);
+                break;
+            }
+        }
+        if (videoIndex < 0) {
+            if (fmtCtx) {
+                avformat_close_input(&fmtCtx);
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait_for(lock, m_retryDelay, [this] { return !active(); });
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_conn.url = url;
+            m_conn.fmtCtx = fmtCtx;
+            m_conn.videoStreamIndex = videoIndex;
+            m_ready = true;
+        }
+        LOG_INFO("StandbyInput: Standby connection ready: " + url);
+
+        // Keep it streaming so the session stays alive and the GOP cache current
+        while (active()) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_wantHandover) {
+                    m_wantHandover = false;
+                    m_handedOver = true;
+                    m_url = m_nextUrl;
+                    m_cv.notify_all();
+                    // take() moves the connection out; don't touch it after this
+                    m_cv.wait(lock, [this] { return !m_handedOver || m_stop; });
+                    break;
+                }
+            }
+            int ret = av_read_frame(fmtCtx, packet);
+            if (ret < 0) {
+                LOG_WARNING("StandbyInput: Standby connection lost: " + url);
+                std::lock_guard<std::mutex> lock(m_mutex);
+                closeConnection();
+                m_cv.notify_all();
+                break;
+            }
+            if (packet->stream_index == videoIndex) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                cachePacket(packet);
+            }
+            av_packet_unref(packet);
+        }
+    }
+    av_packet_free(&packet);
+}
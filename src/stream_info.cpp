@@ -0,0 +1,50 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <stream_info.hpp>
+
+#include <cstring>
+
+bool sameCodecParameters(const AVCodecParameters* a, const AVCodecParameters* b) {
+    if (!a || !b) {
+        return false;
+    }
+    return a->codec_id == b->codec_id && a->width == b->width && a->height == b->height &&
+           (a->format < 0 || b->format < 0 || a->format == b->format) &&
+           a->extradata_size == b->extradata_size &&
+           (a->extradata_size == 0 || std::memcmp(a->extradata, b->extradata, a->extradata_size) == 0);
+}
+
+StreamInfo::StreamInfo()
+    : m_codecpar(avcodec_parameters_alloc())
+{
+}
+
+StreamInfo::~StreamInfo() {
+    avcodec_parameters_free(&m_codecpar);
+}
+
+void StreamInfo::publish(const AVCodecParameters* codecpar, AVRational timeBase) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    avcodec_parameters_copy(m_codecpar, codecpar);
+    m_timeBase = timeBase;
+    ++m_generation;
+}
+
+bool StreamInfo::get(AVCodecParameters* codecpar, AVRational& timeBase, uint64_t& generation) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_generation == 0) {
+        return false;
+    }
+    if (avcodec_parameters_copy(codecpar, m_codecpar) < 0) {
+        return false;
+    }
+    timeBase = m_timeBase;
+    generation = m_generation;
+    return true;
+}
+
+uint64_t StreamInfo::generation() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_generation;
+}
@@ -0,0 +1,175 @@
+// Author: Lerato Mokoena
+// Company: Arithaoptix pty Ltd.
+
+#include <supervisor.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+#include <logger.hpp>
+
+Supervisor::Supervisor(const Config& config)
+    : m_executor(std::make_unique<Executor>(config.executorThreads, config.executorPinCores))
+{
+    std::vector<CameraConfig> cameras = config.cameras;
+    if (cameras.empty()) {
+        cameras.push_back({ "camera", config.inputUrl, config.outputUrl, config.standbyUrl });
+    }
+
+    const bool ai = std::any_of(config.pipelineStages.begin(), config.pipelineStages.end(),
+                                [](const StageConfig& stage) { return stage.name == "ai"; });
+    if (ai && config.aiSharedBatch) {
+        AIBatchOptions batch;
+        batch.maxBatch = config.aiBatchSize;
+        batch.maxWait  = std::chrono::milliseconds(config.aiBatchMaxWaitMs);
+        m_batcher = std::make_unique<InferenceBatcher>(config.inferenceOptions(), batch,
+                                                       config.detectionDecoderOptions());
+    }
+
+    for (const CameraConfig& camera : cameras) {
+        auto cfg = std::make_unique<Config>(config);
+        cfg->inputUrl  = camera.inputUrl;
+        cfg->outputUrl = camera.outputUrl;
+        cfg->standbyUrl = camera.standbyUrl;
+        for (const auto& cameraProfile : config.cameraEncoderProfiles) {
+            if (cameraProfile.first == camera.name) {
+                cfg->encoderProfile = cameraProfile.second;
+            }
+        }
+        cfg->cameras.clear();
+        cfg->cameraEncoderProfiles.clear();
+        if (cameras.size() > 1) {
+            shareCodecThreads(*cfg, cameras.size());
+        }
+        for (RenditionConfig& rendition : cfg->renditions) {
+            const std::string placeholder = "{camera}";
+            size_t pos;
+            while ((pos = rendition.outputUrl.find(placeholder)) != std::string::npos) {
+                rendition.outputUrl.replace(pos, placeholder.size(), camera.name);
+            }
+        }
+        m_pipelines.push_back(std::make_unique<Pipeline>(*cfg, camera.name, m_executor.get(), m_batcher.get()));
+        m_configs.push_back(std::move(cfg));
+    }
+    m_reportedDown.assign(m_pipelines.size(), false);
+    m_lastFrames.assign(m_pipelines.size(), 0);
+
+    LOG_INFO("Supervisor: " + std::to_string(m_pipelines.size()) + " camera(s) on " +
+             std::to_string(m_executor->threads()) + " executor threads" +
+             (m_batcher ? ", one batched model for all of them." : "."));
+}
+
+void Supervisor::shareCodecThreads(Config& cfg, size_t cameras) {
+    const int cores = std::max(1u, std::thread::hardware_concurrency());
+    const int share = std::max(1, cores / static_cast<int>(cameras));
+    if (cfg.decoderThreads < 0) {
+        cfg.decoderThreads = share;
+    }
+    if (cfg.encoderThreads < 0) {
+        // A ladder runs an encoder per rendition; a profile's own count is only capped
+        const int encoders = std::max<int>(1, static_cast<int>(cfg.renditions.size()));
+        const int perEncoder = std::max(1, share / encoders);
+        const int profileThreads = cfg.codecConfig().threads;
+        cfg.encoderThreads = profileThreads > 0 ? std::min(profileThreads, perEncoder) : perEncoder;
+    }
+}
+
+Supervisor::~Supervisor() {
+    stop();
+}
+
+void Supervisor::start() {
+    if (m_batcher) {
+        m_batcher->start();
+    }
+    for (auto& pipeline : m_pipelines) {
+        pipeline->start();
+    }
+    m_lastMetrics = std::chrono::steady_clock::now();
+}
+
+void Supervisor::stop() {
+    for (auto& pipeline : m_pipelines) {
+        pipeline->stop();
+    }
+    // After the ai stages, which may be waiting on a batch
+    if (m_batcher) {
+        m_batcher->stop();
+    }
+    m_executor->shutdown();
+}
+
+size_t Supervisor::checkStreams() {
+    size_t running = 0;
+    for (size_t i = 0; i < m_pipelines.size(); ++i) {
+        if (m_pipelines[i]->isRunning()) {
+            ++running;
+        } else if (!m_reportedDown[i]) {
+            LOG_ERROR("Supervisor: Camera " + m_pipelines[i]->name() + " has stopped.");
+            m_reportedDown[i] = true;
+        }
+    }
+    return running;
+}
+
+uint64_t Supervisor::droppedItems() const {
+    uint64_t dropped = 0;
+    for (const auto& pipeline : m_pipelines) {
+        dropped += pipeline->droppedItems();
+    }
+    return dropped;
+}
+
+SupervisorMetrics Supervisor::metrics() const {
+    SupervisorMetrics m;
+    for (const auto& pipeline : m_pipelines) {
+        StreamMetrics s;
+        s.name = pipeline->name();
+        s.running = pipeline->isRunning();
+        s.framesCaptured = pipeline->framesCaptured();
+        s.dropped = pipeline->droppedItems();
+        s.capture = pipeline->captureStats();
+        m.streams.push_back(s);
+    }
+    m.executor = m_executor->stats();
+    return m;
+}
+
+void Supervisor::logMetrics() {
+    const auto now = std::chrono::steady_clock::now();
+    const double secs = std::chrono::duration<double>(now - m_lastMetrics).count();
+    m_lastMetrics = now;
+
+    const SupervisorMetrics m = metrics();
+    for (size_t i = 0; i < m.streams.size(); ++i) {
+        const StreamMetrics& s = m.streams[i];
+        const double fps = secs > 0.0 ? (s.framesCaptured - m_lastFrames[i]) / secs : 0.0;
+        m_lastFrames[i] = s.framesCaptured;
+        const CaptureStats& c = s.capture;
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "%s: %s, %.1f fps, %llu frames, %llu dropped, first frame %.0f ms, jitter %.1f ms, "
+                      "%llu reconnects (last outage %.0f ms)",
+                      s.name.c_str(), s.running ? "up" : "DOWN", fps,
+                      static_cast<unsigned long long>(s.framesCaptured),
+                      static_cast<unsigned long long>(s.dropped),
+                      c.lastFirstFrameMs, c.jitter.jitterMs,
+                      static_cast<unsigned long long>(c.connects > 0 ? c.connects - 1 : 0),
+                      c.lastOutageMs);
+        LOG_INFO(std::string("Supervisor: ") + line);
+    }
+
+    std::string busy;
+    for (double b : m.executor.workerBusy) {
+        busy += (busy.empty() ? "" : " ") + std::to_string(static_cast<int>(b * 100.0 + 0.5)) + "%";
+    }
+    LOG_INFO("Supervisor: executor ran " + std::to_string(m.executor.tasksRun) + " slices (" +
+             std::to_string(m.executor.tasksStolen) + " stolen), worker load " + busy);
+}
+
+void Supervisor::logQueueStats() const {
+    for (const auto& pipeline : m_pipelines) {
+        pipeline->logQueueStats();
+    }
+}
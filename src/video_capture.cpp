@@ -2,95 +2,801 @@
 // Company: Arithaoptix pty Ltd.
 #include <video_capture.hpp>
 #include <motion_detector.hpp> // for DecodedFrame
+#include <algorithm>
 #include <chrono>
+#include <stdexcept>
 #include <thread>
 
+DecodeMode parseDecodeMode(const std::string& name) {
+    if (name == "all")       return DecodeMode::All;
+    if (name == "keyframes") return DecodeMode::Keyframes;
+    if (name == "none")      return DecodeMode::None;
+    throw std::runtime_error("Config error: unknown decode mode '" + name +
+                             "' (expected all, keyframes or none).");
+}
+
+HwDecode parseHwDecode(const std::string& name) {
+    if (name == "none")  return HwDecode::None;
+    if (name == "auto")  return HwDecode::Auto;
+    if (name == "vaapi") return HwDecode::Vaapi;
+    if (name == "qsv")   return HwDecode::Qsv;
+    throw std::runtime_error("Config error: unknown hardware decoder '" + name +
+                             "' (expected none, auto, vaapi or qsv).");
+}
+
+int parseDecoderThreadType(const std::string& name) {
+    if (name == "frame") return FF_THREAD_FRAME;
+    if (name == "slice") return FF_THREAD_SLICE;
+    if (name == "auto")  return FF_THREAD_FRAME | FF_THREAD_SLICE;
+    throw std::runtime_error("Config error: unknown decoder thread type '" + name +
+                             "' (expected frame, slice or auto).");
+}
+
+// Decoder can take frames from a device of this type through hw_device_ctx
+static bool supportsHwDevice(const AVCodec* codec, AVHWDeviceType type) {
+    for (int i = 0;; ++i) {
+        const AVCodecHWConfig* hwConfig = avcodec_get_hw_config(codec, i);
+        if (!hwConfig) {
+            return false;
+        }
+        if ((hwConfig->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && hwConfig->device_type == type) {
+            return true;
+        }
+    }
+}
+
 VideoCapture::VideoCapture(const std::string& inputUrl,
-                           BufferQueue<DecodedFrame, 128>& captureQueue,
+                           QueueInterface<DecodedFrame>& captureQueue,
                            bool reconnectOnFailure,
-                           int reconnectDelaySecs)
+                           int reconnectDelaySecs,
+                           const CaptureOptions& options)
     : m_inputUrl(inputUrl)
+    , m_currentUrl(inputUrl)
     , m_reconnectOnFailure(reconnectOnFailure)
     , m_reconnectDelaySecs(reconnectDelaySecs)
+    , m_rng(std::random_device{}())
     , m_captureQueue(captureQueue)
+    , m_options(options)
+    , m_jitter(options.input.jitterBufferPackets)
+    , m_framePool(std::make_shared<FramePool>())
 {
     avformat_network_init();
+    if (!m_options.standbyUrl.empty()) {
+        // Probed in full, it's off the critical path
+        auto opener = [this](const std::string& url) -> AVFormatContext* {
+            AVFormatContext* fmtCtx = openInput(url);
+            if (fmtCtx && avformat_find_stream_info(fmtCtx, nullptr) < 0) {
+                LOG_WARNING("VideoCapture: Failed to find stream info: " + url);
+                avformat_close_input(&fmtCtx);
+            }
+            return fmtCtx;
+        };
+        m_standby = std::make_unique<StandbyInput>(m_options.standbyUrl, opener, m_running,
+                                                   std::chrono::seconds(std::max(1, m_reconnectDelaySecs)));
+    }
 }
 
 VideoCapture::~VideoCapture() {
     stop();
+    m_standby.reset();
     closeStream();
+    avcodec_parameters_free(&m_cachedPar);
+    avcodec_parameters_free(&m_decoderPar);
+    av_buffer_unref(&m_hwDevice);
 }
 
 void VideoCapture::start() {
     if (m_running.load()) return;
     m_running.store(true);
     m_thread = std::thread(&VideoCapture::captureLoop, this);
+    if (m_standby) {
+        m_standby->start();
+    }
 }
 
 void VideoCapture::stop() {
-    if (!m_running.load()) return;
+    // No early return on !m_running: the loop clears it itself when it gives up,
+    // and the thread still needs joining then
     m_running.store(false);
+    {
+        // Wakes a reconnect backoff; blocked FFmpeg I/O sees m_running through interruptCallback
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+    }
+    m_waitCv.notify_all();
     if (m_thread.joinable()) {
         m_thread.join();
     }
+    if (m_standby) {
+        m_standby->stop();
+    }
 }
 
-bool VideoCapture::openStream() {
-    closeStream();
+int VideoCapture::interruptCallback(void* opaque) {
+    return static_cast<VideoCapture*>(opaque)->m_running.load() ? 0 : 1;
+}
 
-    int ret = avformat_open_input(&m_fmtCtx, m_inputUrl.c_str(), nullptr, nullptr);
-    if (ret < 0) {
-        LOG_ERROR("VideoCapture: Failed to open input: " + m_inputUrl);
-        return false;
+CaptureStats VideoCapture::stats() const {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+}
+
+static bool isRtsp(const std::string& url) {
+    return url.compare(0, 7, "rtsp://") == 0 || url.compare(0, 8, "rtsps://") == 0;
+}
+
+static int findVideoStream(const AVFormatContext* fmtCtx) {
+    for (unsigned int i = 0; i < fmtCtx->nb_streams; i++) {
+        if (fmtCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            return static_cast<int>(i);
+        }
     }
+    return -1;
+}
+
+// Fill in what the probe would have found. Extradata the camera sent just now
+// (SDP sprop-parameter-sets) beats the cached one, in-band SPS/PPS beat both.
+static void fillFromCache(AVCodecParameters* par, const AVCodecParameters* cached) {
+    if (par->width > 0 && par->height > 0 && par->extradata_size > 0) {
+        return;
+    }
+    AVCodecParameters* fresh = avcodec_parameters_alloc();
+    avcodec_parameters_copy(fresh, par);
+    avcodec_parameters_copy(par, cached);
+    if (fresh->extradata_size > 0) {
+        av_freep(&par->extradata);
+        par->extradata = fresh->extradata;
+        par->extradata_size = fresh->extradata_size;
+        fresh->extradata = nullptr;
+        fresh->extradata_size = 0;
+    }
+    avcodec_parameters_free(&fresh);
+}
 
-    ret = avformat_find_stream_info(m_fmtCtx, nullptr);
+AVDictionary* VideoCapture::inputOptions(const std::string& url) const {
+    const InputOptions& in = m_options.input;
+    AVDictionary* opts = nullptr;
+    const bool rtsp = isRtsp(url);
+    if (rtsp && !in.rtspTransport.empty()) {
+        av_dict_set(&opts, "rtsp_transport", in.rtspTransport.c_str(), 0);
+    }
+    if (in.probeSize > 0) {
+        av_dict_set_int(&opts, "probesize", in.probeSize, 0);
+    }
+    if (in.analyzeDurationUs > 0) {
+        av_dict_set_int(&opts, "analyzeduration", in.analyzeDurationUs, 0);
+    }
+    if (in.noBuffer) {
+        av_dict_set(&opts, "fflags", "nobuffer", 0);
+    }
+    if (in.bufferSize > 0) {
+        av_dict_set_int(&opts, "buffer_size", in.bufferSize, 0);
+    }
+    if (in.maxDelayUs >= 0) {
+        av_dict_set_int(&opts, "max_delay", in.maxDelayUs, 0);
+    }
+    if (in.reorderQueueSize >= 0) {
+        av_dict_set_int(&opts, "reorder_queue_size", in.reorderQueueSize, 0);
+    }
+    if (in.timeoutUs > 0) {
+        // RTSP's socket timeout was 'stimeout' until FFmpeg 5 ('timeout' meant listen timeout)
+#if LIBAVFORMAT_VERSION_MAJOR >= 59
+        const char* key = rtsp ? "timeout" : "rw_timeout";
+#else
+        const char* key = rtsp ? "stimeout" : "rw_timeout";
+#endif
+        av_dict_set_int(&opts, key, in.timeoutUs, 0);
+    }
+    return opts;
+}
+
+AVFormatContext* VideoCapture::openInput(const std::string& url) {
+    AVFormatContext* fmtCtx = avformat_alloc_context();
+    if (!fmtCtx) {
+        return nullptr;
+    }
+    // stop() gets a blocked open/read out at once instead of after the socket timeout
+    fmtCtx->interrupt_callback.callback = &VideoCapture::interruptCallback;
+    fmtCtx->interrupt_callback.opaque = this;
+
+    AVDictionary* opts = inputOptions(url);
+    int ret = avformat_open_input(&fmtCtx, url.c_str(), nullptr, &opts); // frees fmtCtx on failure
+    if (opts) {
+        // Whatever is left wasn't taken by this demuxer/protocol
+        std::string unused;
+        const AVDictionaryEntry* e = nullptr;
+        while ((e = av_dict_get(opts, "", e, AV_DICT_IGNORE_SUFFIX))) {
+            unused += std::string(unused.empty() ? "" : ", ") + e->key;
+        }
+        if (ret >= 0) {
+            LOG_WARNING("VideoCapture: Input options not used by " + url + ": " + unused);
+        }
+        av_dict_free(&opts);
+    }
     if (ret < 0) {
-        LOG_ERROR("VideoCapture: Failed to find stream info: " + m_inputUrl);
+        LOG_ERROR("VideoCapture: Failed to open input: " + url);
+        return nullptr;
+    }
+    return fmtCtx;
+}
+
+bool VideoCapture::openStream() {
+    // The decoder stays, setupStream() decides whether it can be reused
+    closeInput();
+    m_openStart = std::chrono::steady_clock::now();
+
+    m_fmtCtx = openInput(m_currentUrl);
+    if (!m_fmtCtx) {
         return false;
     }
 
-    m_videoStreamIndex = -1;
-    for (unsigned int i = 0; i < m_fmtCtx->nb_streams; i++) {
-        if (m_fmtCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            m_videoStreamIndex = i;
-            break;
+    // Reconnecting to the same camera: the SDP already says which codec, the
+    // rest comes from the first probe instead of reading seconds of stream again
+    m_videoStreamIndex = findVideoStream(m_fmtCtx);
+    const bool fromCache = m_options.input.cacheStreamInfo && m_cachedPar && m_cachedUrl == m_currentUrl &&
+                           m_videoStreamIndex >= 0 &&
+                           m_fmtCtx->streams[m_videoStreamIndex]->codecpar->codec_id == m_cachedPar->codec_id;
+    if (fromCache) {
+        fillFromCache(m_fmtCtx->streams[m_videoStreamIndex]->codecpar, m_cachedPar);
+    } else {
+        int ret = avformat_find_stream_info(m_fmtCtx, nullptr);
+        if (ret < 0) {
+            LOG_ERROR("VideoCapture: Failed to find stream info: " + m_currentUrl);
+            return false;
         }
+        m_videoStreamIndex = findVideoStream(m_fmtCtx);
     }
     if (m_videoStreamIndex < 0) {
-        LOG_ERROR("VideoCapture: No video stream found in: " + m_inputUrl);
+        LOG_ERROR("VideoCapture: No video stream found in: " + m_currentUrl);
         return false;
     }
+    return setupStream(fromCache);
+}
+
+// Everything after the demuxer is open and m_videoStreamIndex known
+bool VideoCapture::setupStream(bool fromCache) {
+    AVStream* stream = m_fmtCtx->streams[m_videoStreamIndex];
+    AVCodecParameters* codecPar = stream->codecpar;
+    m_timeBase = stream->time_base;
+    if (!fromCache && m_options.input.cacheStreamInfo) {
+        if (!m_cachedPar) {
+            m_cachedPar = avcodec_parameters_alloc();
+        }
+        avcodec_parameters_copy(m_cachedPar, codecPar);
+        m_cachedUrl = m_currentUrl;
+    }
+    if (m_options.input.jitterBufferMs > 0) {
+        m_jitter.reset(stream->time_base,
+                       av_rescale_q(m_options.input.jitterBufferMs, AVRational{1, 1000}, stream->time_base));
+    }
+    if (m_options.streamInfo) {
+        m_options.streamInfo->publish(codecPar, stream->time_base);
+    }
+    if (m_options.decode == DecodeMode::None) {
+        LOG_INFO("VideoCapture: Successfully opened stream (passthrough only): " + m_currentUrl);
+        markOpened(fromCache);
+        return true;
+    }
+
+    // New stream, new timestamps
+    m_analysisInterval = 0;
+    if (m_options.analysisFps > 0.0 && stream->time_base.num > 0) {
+        m_analysisInterval = static_cast<int64_t>(stream->time_base.den /
+                                                  (m_options.analysisFps * stream->time_base.num));
+    }
+    m_nextDue = AV_NOPTS_VALUE;
+    m_lastKeyPts = AV_NOPTS_VALUE;
+    m_gopDuration = 0;
+    m_chainBroken = false;
+
+    if (m_codecCtx && sameCodecParameters(m_decoderPar, codecPar)) {
+        // Same stream as before the drop: keep the decoder (threads, hw device, pools), forget its state
+        avcodec_flush_buffers(m_codecCtx);
+        LOG_INFO("VideoCapture: Reusing the decoder.");
+    } else {
+        closeDecoder();
+        if (!openDecoder(codecPar)) {
+            return false;
+        }
+    }
+
+    LOG_INFO("VideoCapture: Successfully opened stream: " + m_currentUrl);
+    markOpened(fromCache);
+    return true;
+}
+
+void VideoCapture::markOpened(bool fromCache) {
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats.connects++;
+    if (fromCache) {
+        m_stats.probesSkipped++;
+    }
+    m_stats.lastOpenMs = std::chrono::duration<double, std::milli>(now - m_openStart).count();
+    m_awaitingFirst = true;
+}
+
+void VideoCapture::markFirstOutput() {
+    if (!m_awaitingFirst) {
+        return;
+    }
+    m_awaitingFirst = false;
+    m_reconnectAttempts = 0;
+    const auto now = std::chrono::steady_clock::now();
+    std::string line;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_stats.lastFirstFrameMs = std::chrono::duration<double, std::milli>(now - m_openStart).count();
+        line = "VideoCapture: First " + std::string(m_options.decode == DecodeMode::None ? "packet " : "frame ") +
+               std::to_string(static_cast<int>(m_stats.lastFirstFrameMs)) + " ms after connecting (open " +
+               std::to_string(static_cast<int>(m_stats.lastOpenMs)) + " ms)";
+        if (m_lost) {
+            m_stats.lastOutageMs = std::chrono::duration<double, std::milli>(now - m_lostAt).count();
+            line += ", outage " + std::to_string(static_cast<int>(m_stats.lastOutageMs)) + " ms";
+        }
+    }
+    m_lost = false;
+    LOG_INFO(line + ".");
+}
 
-    AVCodecParameters* codecPar = m_fmtCtx->streams[m_videoStreamIndex]->codecpar;
-    AVCodec* codec = avcodec_find_decoder(codecPar->codec_id);
+void VideoCapture::markStreamLost() {
+    if (!m_lost) {
+        m_lost = true;
+        m_lostAt = std::chrono::steady_clock::now();
+    }
+}
+
+bool VideoCapture::openDecoder(const AVCodecParameters* codecPar) {
+    const AVCodec* codec = avcodec_find_decoder(codecPar->codec_id);
     if (!codec) {
-        LOG_ERROR("VideoCapture: Decoder not found for: " + m_inputUrl);
+        LOG_ERROR("VideoCapture: Decoder not found for: " + m_currentUrl);
         return false;
     }
+    const bool hw = setupHwDecode(codec);
 
     m_codecCtx = avcodec_alloc_context3(codec);
     avcodec_parameters_to_context(m_codecCtx, codecPar);
+    // Hardware surfaces don't come from the pool, it hands those to the default allocator
+    m_framePool->attach(m_codecCtx);
+    if (m_options.decode == DecodeMode::Keyframes) {
+        // We only feed it keyframes anyway; this also covers streams that don't flag them
+        m_codecCtx->skip_frame = AVDISCARD_NONKEY;
+    }
+    if (m_options.skipLoopFilter) {
+        m_codecCtx->skip_loop_filter = AVDISCARD_ALL;
+    }
+    if (hw) {
+        m_codecCtx->hw_device_ctx = av_buffer_ref(m_hwDevice);
+        m_codecCtx->extra_hw_frames = m_options.hwExtraFrames;
+    } else {
+        m_codecCtx->thread_count = m_options.decoderThreads;
+        m_codecCtx->thread_type = m_options.decoderThreadType;
+        if (m_options.decode == DecodeMode::Keyframes || m_options.analysisFps > 0.0) {
+            // Frame threads hold back thread_count-1 pictures. Fed only keyframes (or a
+            // thinned-out stream) that is as many GOPs late, 30 s on 16 cores at a 2 s GOP.
+            m_codecCtx->thread_type = FF_THREAD_SLICE;
+        }
+        if (m_options.lowres > 0) {
+            const int lowres = std::min<int>(m_options.lowres, codec->max_lowres);
+            if (lowres < m_options.lowres) {
+                LOG_WARNING("VideoCapture: " + std::string(codec->name) + " only decodes at lowres " +
+                            std::to_string(lowres) + ", not " + std::to_string(m_options.lowres) + ".");
+            }
+            m_codecCtx->lowres = lowres;
+        }
+    }
 
-    if ((ret = avcodec_open2(m_codecCtx, codec, nullptr)) < 0) {
-        LOG_ERROR("VideoCapture: Failed to open codec for: " + m_inputUrl);
+    if (avcodec_open2(m_codecCtx, codec, nullptr) < 0) {
+        avcodec_free_context(&m_codecCtx);
+        if (hw) {
+            LOG_WARNING("VideoCapture: Failed to open " + std::string(codec->name) +
+                        " on the hardware device, decoding in software.");
+            m_hwDisabled = true;
+            return openDecoder(codecPar);
+        }
+        LOG_ERROR("VideoCapture: Failed to open codec for: " + m_currentUrl);
         return false;
     }
+    m_hwActive = hw;
+    m_hwFramesOut = 0;
+    if (!m_decoderPar) {
+        m_decoderPar = avcodec_parameters_alloc();
+    }
+    avcodec_parameters_copy(m_decoderPar, codecPar);
 
-    LOG_INFO("VideoCapture: Successfully opened stream: " + m_inputUrl);
+    if (hw) {
+        const auto* device = reinterpret_cast<const AVHWDeviceContext*>(m_hwDevice->data);
+        LOG_INFO("VideoCapture: Decoding with " + std::string(codec->name) + " on " +
+                 av_hwdevice_get_type_name(device->type) + (m_options.hwMap ? " (mapped frames)." : "."));
+    } else {
+        LOG_INFO("VideoCapture: Decoding with " + std::string(codec->name) + " in software, " +
+                 std::to_string(m_codecCtx->thread_count) + " thread(s).");
+    }
     return true;
 }
 
+bool VideoCapture::setupHwDecode(const AVCodec*& codec) {
+    if (m_options.hwDecode == HwDecode::None || m_hwDisabled) {
+        return false;
+    }
+    if (m_options.lowres > 0) {
+        // Hardware decoders always output full size
+        LOG_INFO("VideoCapture: decodeLowres is software only, not using hardware decode.");
+        m_hwDisabled = true;
+        return false;
+    }
+
+    const bool tryVaapi = (m_options.hwDecode == HwDecode::Auto || m_options.hwDecode == HwDecode::Vaapi);
+    const bool tryQsv   = (m_options.hwDecode == HwDecode::Auto || m_options.hwDecode == HwDecode::Qsv);
+    if (tryVaapi && supportsHwDevice(codec, AV_HWDEVICE_TYPE_VAAPI) && ensureHwDevice(AV_HWDEVICE_TYPE_VAAPI)) {
+        return true;
+    }
+    if (tryQsv) {
+        // QSV isn't a hwaccel of the native decoders, it has decoders of its own (h264_qsv, hevc_qsv...)
+        const AVCodec* qsv = avcodec_find_decoder_by_name((std::string(codec->name) + "_qsv").c_str());
+        if (qsv && ensureHwDevice(AV_HWDEVICE_TYPE_QSV)) {
+            codec = qsv;
+            return true;
+        }
+    }
+
+    LOG_WARNING("VideoCapture: No hardware decoder for " + std::string(codec->name) + ", decoding in software.");
+    m_hwDisabled = true;
+    return false;
+}
+
+bool VideoCapture::ensureHwDevice(AVHWDeviceType type) {
+    if (m_hwDevice) {
+        if (reinterpret_cast<const AVHWDeviceContext*>(m_hwDevice->data)->type == type) {
+            return true;
+        }
+        av_buffer_unref(&m_hwDevice);
+    }
+    const char* device = m_options.hwDevice.empty() ? nullptr : m_options.hwDevice.c_str();
+    int ret = av_hwdevice_ctx_create(&m_hwDevice, type, device, nullptr, 0);
+    if (ret < 0) {
+        char err[AV_ERROR_MAX_STRING_SIZE] = {0};
+        av_strerror(ret, err, sizeof(err));
+        LOG_WARNING("VideoCapture: Could not open " + std::string(av_hwdevice_get_type_name(type)) + " device " +
+                    (device ? device : "(default)") + ": " + err);
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+// Buffer with no data, put in a spare buf[] slot of a frame: FFmpeg drops it with
+// the frame's last reference, or when av_frame_make_writable() copies the frame
+// off the surface. Its free callback gives the surface back to the count.
+void releaseSurfaceCount(void*, uint8_t* data) {
+    auto* count = reinterpret_cast<std::shared_ptr<std::atomic<int>>*>(data);
+    (*count)->fetch_sub(1, std::memory_order_relaxed);
+    delete count;
+}
+
+AVBufferRef* makeSurfaceToken(const std::shared_ptr<std::atomic<int>>& count) {
+    auto* holder = new std::shared_ptr<std::atomic<int>>(count);
+    AVBufferRef* token = av_buffer_create(reinterpret_cast<uint8_t*>(holder), sizeof(*holder),
+                                          releaseSurfaceCount, nullptr, AV_BUFFER_FLAG_READONLY);
+    if (!token) {
+        delete holder;
+        return nullptr;
+    }
+    count->fetch_add(1, std::memory_order_relaxed);
+    return token;
+}
+
+bool attachSurfaceToken(AVFrame* frame, AVBufferRef* token) {
+    for (int i = 0; i < AV_NUM_DATA_POINTERS; ++i) {
+        if (!frame->buf[i]) {
+            frame->buf[i] = av_buffer_ref(token);
+            return frame->buf[i] != nullptr;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+AVFrame* VideoCapture::downloadFrame(const AVFrame* hwFrame, AVBufferRef*& token) {
+    AVFrame* out = m_framePool->acquireFrame();
+    token = nullptr;
+
+    // Zero-copy: the frame reads the surface in place and holds on to it until released.
+    // Only while the decoder has surfaces to spare, a full pool makes every decode fail.
+    const bool spare = m_surfacesOut->load(std::memory_order_relaxed) < m_options.hwExtraFrames;
+    if (m_options.hwMap && m_copyingOut == spare) {
+        m_copyingOut = !spare;
+        if (m_copyingOut) {
+            LOG_INFO("VideoCapture: " + std::to_string(m_options.hwExtraFrames) + " mapped frames still "
+                     "downstream, copying frames out until they come back.");
+        }
+    }
+    if (m_options.hwMap && spare) {
+        out->format = m_options.outputFormat;
+        if (av_hwframe_map(out, hwFrame, AV_HWFRAME_MAP_READ) == 0 &&
+            av_frame_copy_props(out, hwFrame) == 0) {
+            token = makeSurfaceToken(m_surfacesOut);
+            if (token && !attachSurfaceToken(out, token)) {
+                av_buffer_unref(&token);
+            }
+            return out;
+        }
+        av_frame_unref(out);
+    }
+
+    // Mapping not supported for this surface/format (or turned off, or no spare surfaces): copy it out
+    out->format = m_options.outputFormat;
+    if (av_hwframe_transfer_data(out, hwFrame, 0) == 0 &&
+        av_frame_copy_props(out, hwFrame) == 0) {
+        return out;
+    }
+    m_framePool->releaseFrame(out);
+    return nullptr;
+}
+
+void VideoCapture::fallBackToSoftware(const std::string& reason) {
+    LOG_WARNING("VideoCapture: Hardware decode failed (" + reason + "), decoding in software from now on.");
+    m_hwDisabled = true;
+    closeDecoder();
+    // Null decoder on failure, the capture loop reconnects
+    openDecoder(m_fmtCtx->streams[m_videoStreamIndex]->codecpar);
+}
+
 void VideoCapture::closeStream() {
+    closeDecoder();
+    closeInput();
+}
+
+void VideoCapture::closeInput() {
+    if (m_fmtCtx) {
+        avformat_close_input(&m_fmtCtx);
+        m_fmtCtx = nullptr;
+    }
+}
+
+void VideoCapture::closeDecoder() {
     if (m_codecCtx) {
         avcodec_free_context(&m_codecCtx);
         m_codecCtx = nullptr;
     }
-    if (m_fmtCtx) {
-        avformat_close_input(&m_fmtCtx);
-        m_fmtCtx = nullptr;
+}
+
+std::chrono::milliseconds VideoCapture::nextBackoff() {
+    // Doubling up to reconnectDelaySecs, then a random point in the upper half of
+    // that, so a site full of cameras behind one switch doesn't retry in lockstep
+    const int64_t initial = std::max(1, m_options.reconnectInitialMs);
+    const int64_t cap = std::max<int64_t>(initial, m_reconnectDelaySecs * 1000LL);
+    int64_t base = initial;
+    for (int i = 0; i < m_reconnectAttempts && base < cap; ++i) {
+        base *= 2;
     }
+    base = std::min(base, cap);
+    ++m_reconnectAttempts;
+    std::uniform_int_distribution<int64_t> dist(base / 2, base);
+    return std::chrono::milliseconds(dist(m_rng));
+}
+
+bool VideoCapture::waitForRetry(std::chrono::milliseconds delay) {
+    std::unique_lock<std::mutex> lock(m_waitMutex);
+    m_waitCv.wait_for(lock, delay, [this] { return !m_running.load(); });
+    return m_running.load();
+}
+
+bool VideoCapture::takeStandby(AVFrame*& frame) {
+    if (!m_standby) {
+        return false;
+    }
+    StandbyConnection conn;
+    if (!m_standby->take(conn, m_currentUrl, std::chrono::milliseconds(500))) {
+        return false;
+    }
+    LOG_WARNING("VideoCapture: Failing over from " + m_currentUrl + " to " + conn.url + ".");
+    closeInput();
+    m_openStart = std::chrono::steady_clock::now();
+    m_fmtCtx = conn.fmtCtx;
+    m_videoStreamIndex = conn.videoStreamIndex;
+    m_currentUrl = conn.url;
+
+    const bool ok = setupStream(false);
+    if (ok) {
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_stats.failovers++;
+        }
+        // Decode from the standby's last keyframe on instead of waiting for the next one
+        for (AVPacket* packet : conn.gop) {
+            handlePacket(packet, frame);
+        }
+    } else {
+        closeInput();
+    }
+    for (AVPacket*& packet : conn.gop) {
+        av_packet_free(&packet);
+    }
+    return ok;
+}
+
+void VideoCapture::forwardPacket(const AVPacket* packet) {
+    // A new reference, the payload isn't copied
+    EncodedPacket ep;
+    ep.packet = av_packet_clone(packet);
+    if (!ep.packet) {
+        return;
+    }
+    while (!m_options.packetQueue->enqueue(std::move(ep), kQueueWait)) {
+        if (!m_running.load() || m_options.packetQueue->isShutdown()) {
+            av_packet_free(&ep.packet);
+            break;
+        }
+        LOG_WARNING("VideoCapture: packet queue full, waiting...");
+    }
+}
+
+bool VideoCapture::shouldDecode(const AVPacket* packet) {
+    const bool key = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+    if (m_options.decode == DecodeMode::Keyframes && !key) {
+        // Keyframe mode never even hands the rest to the decoder
+        ++m_packetsSkipped;
+        return false;
+    }
+    if (m_analysisInterval <= 0) {
+        return true;
+    }
+
+    const int64_t ts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    if (ts == AV_NOPTS_VALUE) {
+        return true; // can't tell, decode and let frameDue() sort it out
+    }
+    if (key) {
+        if (m_lastKeyPts != AV_NOPTS_VALUE && ts > m_lastKeyPts) {
+            m_gopDuration = ts - m_lastKeyPts;
+        }
+        m_lastKeyPts = ts;
+    }
+
+    const bool due = (m_nextDue == AV_NOPTS_VALUE || ts >= m_nextDue);
+    // Keyframes come often enough on their own: skip whole GOPs
+    const bool keyframesSuffice = (m_gopDuration > 0 && m_gopDuration <= m_analysisInterval);
+
+    if (key) {
+        if (due || !keyframesSuffice) {
+            m_chainBroken = false;
+            return true;
+        }
+        m_chainBroken = true;
+        ++m_packetsSkipped;
+        return false;
+    }
+    if (m_chainBroken) {
+        // Wouldn't decode cleanly without what we dropped
+        ++m_packetsSkipped;
+        return false;
+    }
+    if (due) {
+        return true;
+    }
+    if (keyframesSuffice) {
+        m_chainBroken = true;
+        ++m_packetsSkipped;
+        return false;
+    }
+    if (packet->flags & AV_PKT_FLAG_DISPOSABLE) {
+        // Nothing references it, it can go without hurting the frames after it
+        ++m_packetsSkipped;
+        return false;
+    }
+    // A reference frame we don't want to see, but the next due one needs it
+    return true;
+}
+
+bool VideoCapture::frameDue(const AVFrame* frame) {
+    if (m_analysisInterval <= 0) {
+        return true;
+    }
+    const int64_t ts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+    if (ts == AV_NOPTS_VALUE) {
+        return true;
+    }
+    if (m_nextDue != AV_NOPTS_VALUE && ts < m_nextDue) {
+        return false;
+    }
+    m_nextDue = ts + m_analysisInterval;
+    return true;
+}
+
+void VideoCapture::decodePacket(const AVPacket* packet, AVFrame*& frame) {
+    int ret = avcodec_send_packet(m_codecCtx, packet);
+    if (ret < 0) {
+        LOG_ERROR("VideoCapture: Error sending packet for decode.");
+        // Before the first good surface that's the device/driver, not the stream
+        if (m_hwActive && m_hwFramesOut == 0) {
+            fallBackToSoftware("could not decode the first frame");
+        }
+        return;
+    }
+
+    while (true) {
+        if (!frame) {
+            frame = m_framePool->acquireFrame();
+        }
+        ret = avcodec_receive_frame(m_codecCtx, frame);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            break;
+        } else if (ret < 0) {
+            LOG_ERROR("VideoCapture: Error decoding frame.");
+            if (m_hwActive && m_hwFramesOut == 0) {
+                fallBackToSoftware("could not decode the first frame");
+            }
+            break;
+        }
+        if (!frameDue(frame)) {
+            // Only decoded to keep the references intact
+            av_frame_unref(frame);
+            continue;
+        }
+
+        // Push decoded frame
+        DecodedFrame df;
+        if (frame->hw_frames_ctx) {
+            // Surfaces stay on the device, the stages get a mapped (or copied) picture.
+            // The receive target is kept, the mapping holds its own reference to the surface.
+            AVBufferRef* token = nullptr;
+            df.frame = downloadFrame(frame, token);
+            if (token && m_options.keepHwFrames) {
+                // Same surface as the mapping, counted once: both hold the one token
+                df.hwFrame = av_frame_clone(frame);
+                if (df.hwFrame && attachSurfaceToken(df.hwFrame, token)) {
+                    df.hwPixels = df.frame->data[0];
+                } else {
+                    av_frame_free(&df.hwFrame);
+                }
+            }
+            av_buffer_unref(&token);
+            av_frame_unref(frame);
+            if (!df.frame) {
+                fallBackToSoftware("could not map or download a decoded surface");
+                return;
+            }
+            ++m_hwFramesOut;
+        } else {
+            df.frame = frame;
+            frame = nullptr;
+        }
+        df.pts = df.frame->pts;
+        df.timeBase = m_timeBase;
+        df.pool = m_framePool;
+
+        markFirstOutput();
+        while (!m_captureQueue.enqueue(std::move(df), kQueueWait)) {
+            if (!m_running.load() || m_captureQueue.isShutdown()) {
+                releaseDecodedFrame(df);
+                break;
+            }
+            LOG_WARNING("VideoCapture: capture queue full, waiting...");
+        }
+    }
+}
+
+void VideoCapture::handlePacket(const AVPacket* packet, AVFrame*& frame) {
+    if (m_options.packetQueue) {
+        forwardPacket(packet);
+        if (m_options.decode == DecodeMode::None) {
+            markFirstOutput();
+        }
+    }
+    if (m_options.decode != DecodeMode::None && m_codecCtx && shouldDecode(packet)) {
+        decodePacket(packet, frame);
+    }
+}
+
+void VideoCapture::drainJitterBuffer(AVFrame*& frame, bool flush) {
+    while (AVPacket* packet = m_jitter.pop(flush)) {
+        handlePacket(packet, frame);
+        av_packet_free(&packet);
+    }
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats.jitter = m_jitter.stats();
 }
 
 void VideoCapture::captureLoop() {
@@ -103,25 +809,40 @@ void VideoCapture::captureLoop() {
     }
 
     AVPacket* packet = av_packet_alloc();
+    // Receive target, only handed over (and replaced) when a picture comes out
+    AVFrame* frame = nullptr;
+    const bool decoding = (m_options.decode != DecodeMode::None);
+    const bool jitterOn = (m_options.input.jitterBufferMs > 0);
     while (m_running.load()) {
-        if (!m_fmtCtx || !m_codecCtx) {
-            if (m_reconnectOnFailure) {
-                LOG_WARNING("VideoCapture: Trying reconnect in " + std::to_string(m_reconnectDelaySecs) + "s...");
-                std::this_thread::sleep_for(std::chrono::seconds(m_reconnectDelaySecs));
-                if (!openStream()) {
-                    continue;
-                }
-            } else {
+        if (!m_fmtCtx || (decoding && !m_codecCtx)) {
+            if (!m_reconnectOnFailure) {
+                break;
+            }
+            if (takeStandby(frame)) {
+                continue;
+            }
+            const std::chrono::milliseconds delay = nextBackoff();
+            LOG_WARNING("VideoCapture: Trying reconnect in " + std::to_string(delay.count()) + " ms...");
+            if (!waitForRetry(delay)) {
                 break;
             }
+            if (!openStream()) {
+                continue;
+            }
         }
 
         int ret = av_read_frame(m_fmtCtx, packet);
         if (ret < 0) {
             LOG_WARNING("VideoCapture: av_read_frame returned " + std::to_string(ret));
             av_packet_unref(packet);
+            if (jitterOn) {
+                // What made it here still goes out, in order
+                drainJitterBuffer(frame, true);
+            }
+            markStreamLost();
             if (m_reconnectOnFailure) {
-                closeStream();
+                // Decoder kept, a reconnect to the same stream reuses it
+                closeInput();
                 continue;
             } else {
                 break;
@@ -129,34 +850,13 @@ void VideoCapture::captureLoop() {
         }
 
         if (packet->stream_index == m_videoStreamIndex) {
-            ret = avcodec_send_packet(m_codecCtx, packet);
-            if (ret < 0) {
-                LOG_ERROR("VideoCapture: Error sending packet for decode.");
-                av_packet_unref(packet);
-                continue;
-            }
-
-            while (true) {
-                AVFrame* frame = av_frame_alloc();
-                ret = avcodec_receive_frame(m_codecCtx, frame);
-                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                    av_frame_free(&frame);
-                    break;
-                } else if (ret < 0) {
-                    LOG_ERROR("VideoCapture: Error decoding frame.");
-                    av_frame_free(&frame);
-                    break;
-                }
-
-                // Push decoded frame
-                DecodedFrame df;
-                df.frame = frame;
-                df.pts = frame->pts;
-
-                while (!m_captureQueue.push(std::move(df))) {
-                    LOG_WARNING("VideoCapture: capture queue full, dropping frame...");
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                }
+            if (jitterOn) {
+                AVPacket* held = av_packet_alloc();
+                av_packet_move_ref(held, packet);
+                m_jitter.push(held, std::chrono::steady_clock::now());
+                drainJitterBuffer(frame, false);
+            } else {
+                handlePacket(packet, frame);
             }
         }
 
@@ -164,6 +864,21 @@ void VideoCapture::captureLoop() {
     }
 
     av_packet_free(&packet);
+    m_framePool->releaseFrame(frame);
     closeStream();
+
+    if (m_packetsSkipped > 0) {
+        LOG_INFO("VideoCapture: Skipped " + std::to_string(m_packetsSkipped) + " packets before decode.");
+    }
+    FramePoolStats poolStats = m_framePool->stats();
+    LOG_INFO("VideoCapture: Frame pool shells hit/miss=" + std::to_string(poolStats.shellHits) + "/" +
+             std::to_string(poolStats.shellMisses) + ", buffers hit/miss=" +
+             std::to_string(poolStats.bufferHits) + "/" + std::to_string(poolStats.bufferMisses));
+    if (jitterOn) {
+        const JitterStats& js = m_jitter.stats();
+        LOG_INFO("VideoCapture: Jitter buffer reordered=" + std::to_string(js.reordered) + " late=" +
+                 std::to_string(js.late) + " overflow=" + std::to_string(js.overflow) + ", jitter " +
+                 std::to_string(js.jitterMs) + " ms");
+    }
     m_running.store(false);
 }
@@ -2,23 +2,87 @@
 // Company: Arithaoptix pty Ltd.
 
 #include <video_encoder.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
 #include <thread>
 #include <iostream>
 
-VideoEncoder::VideoEncoder(BufferQueue<DecodedFrame, 128>& inQueue,
-                           BufferQueue<EncodedPacket, 128>& outQueue,
+extern "C" {
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace {
+
+enum class CodecFamily { X264, X265, SvtAv1, Other };
+
+CodecFamily codecFamily(const AVCodec* codec) {
+    if (std::strncmp(codec->name, "libx264", 7) == 0) return CodecFamily::X264;
+    if (std::strcmp(codec->name, "libx265") == 0)     return CodecFamily::X265;
+    if (std::strcmp(codec->name, "libsvtav1") == 0)   return CodecFamily::SvtAv1;
+    return CodecFamily::Other;
+}
+
+// SVT-AV1 presets are numbers, 0 (slowest) to 13; anything else is passed as is
+std::string svtPreset(const std::string& preset) {
+    static const std::pair<const char*, const char*> kPresets[] = {
+        { "ultrafast", "12" }, { "superfast", "11" }, { "veryfast", "10" },
+        { "faster", "9" }, { "fast", "8" }, { "medium", "6" },
+        { "slow", "4" }, { "slower", "3" }, { "veryslow", "2" },
+    };
+    for (const auto& p : kPresets) {
+        if (preset == p.first) return p.second;
+    }
+    return preset;
+}
+
+// VAAPI/QSV encoders are named after the codec: h264_vaapi, hevc_qsv...
+const char* hwCodecPrefix(AVCodecID id) {
+    switch (id) {
+    case AV_CODEC_ID_H264: return "h264";
+    case AV_CODEC_ID_HEVC: return "hevc";
+    case AV_CODEC_ID_AV1:  return "av1";
+    default:               return nullptr;
+    }
+}
+
+bool isHwEncoder(const AVCodec* codec) {
+    const std::string name = codec->name;
+    return name.find("_vaapi") != std::string::npos || name.find("_qsv") != std::string::npos;
+}
+
+} // namespace
+
+HwEncode parseHwEncode(const std::string& name) {
+    if (name == "none")  return HwEncode::None;
+    if (name == "auto")  return HwEncode::Auto;
+    if (name == "vaapi") return HwEncode::Vaapi;
+    if (name == "qsv")   return HwEncode::Qsv;
+    throw std::runtime_error("Config error: unknown hardware encoder '" + name +
+                             "' (expected none, auto, vaapi or qsv).");
+}
+
+VideoEncoder::VideoEncoder(QueueInterface<DecodedFrame>& inQueue,
+                           BufferQueue<EncodedPacket>& outQueue,
                            int width,
                            int height,
                            int fps,
                            const std::string& codecName,
-                           bool hwAccel)
+                           const HwEncodeOptions& hw,
+                           const CodecConfig& codec,
+                           std::shared_ptr<StreamInfo> streamInfo)
     : m_inQueue(inQueue)
     , m_outQueue(outQueue)
     , m_width(width)
     , m_height(height)
     , m_fps(fps)
     , m_codecName(codecName)
-    , m_hwAccel(hwAccel)
+    , m_hw(hw)
+    , m_codec(codec)
+    , m_streamInfo(std::move(streamInfo))
+    , m_scalePool(std::make_shared<FramePool>(32))
 {
 }
 
@@ -27,8 +91,17 @@ VideoEncoder::~VideoEncoder() {
     closeEncoder();
 }
 
-bool VideoEncoder::initEncoder() {
+bool VideoEncoder::initEncoder(const AVFrame* hwInput) {
+    if (m_hw.mode != HwEncode::None && initHwEncoder(hwInput)) {
+        return true;
+    }
+
     const AVCodec* codec = avcodec_find_encoder_by_name(m_codecName.c_str());
+    if (codec && isHwEncoder(codec)) {
+        // A hardware encoder was configured and didn't open: the codec's software one
+        LOG_WARNING("Video Encoder: " + m_codecName + " unavailable, encoding in software.");
+        codec = avcodec_find_encoder(codec->id);
+    }
     if (!codec) {
         // fallback to H.264 if not found
         codec = avcodec_find_encoder(AV_CODEC_ID_H264);
@@ -50,36 +123,307 @@ bool VideoEncoder::initEncoder() {
     m_codecCtx->time_base = (AVRational){1, m_fps};
     m_codecCtx->framerate = (AVRational){m_fps, 1};
     m_codecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
-    m_codecCtx->thread_count = 4;
-    m_codecCtx->gop_size = 12;
-    m_codecCtx->max_b_frames = 2;
+    m_swFormat = AV_PIX_FMT_YUV420P;
+    applyCodecConfig(codec);
 
-    // Some advanced settings if h264
-    if (strstr(codec->name, "264") != nullptr) {
-        av_opt_set(m_codecCtx->priv_data, "preset", "veryfast", 0);
-        av_opt_set(m_codecCtx->priv_data, "tune", "zerolatency", 0);
+    if (avcodec_open2(m_codecCtx, codec, nullptr) < 0) {
+        LOG_ERROR("Video Encoder: Failed to open encoder.");
+        return false;
     }
 
-    if (m_hwAccel) {
-        LOG_INFO("Video Encoder: Hardware acceleration requested (placeholder).");
-        // Actual usage depends on NVENC, VAAPI, etc.
+    m_initialized = true;
+    publishStreamInfo();
+    LOG_INFO("Video Encoder: Encoder initialized: " + std::string(codec->name));
+    return true;
+}
+
+bool VideoEncoder::initHwEncoder(const AVFrame* hwInput) {
+    const AVCodec* configured = avcodec_find_encoder_by_name(m_codecName.c_str());
+    const char* prefix = hwCodecPrefix(configured ? configured->id : AV_CODEC_ID_H264);
+    if (!prefix) {
+        LOG_WARNING("Video Encoder: No VAAPI/QSV encoder for " + m_codecName + ", encoding in software.");
+        return false;
     }
 
+    const bool tryVaapi = (m_hw.mode == HwEncode::Auto || m_hw.mode == HwEncode::Vaapi);
+    const bool tryQsv   = (m_hw.mode == HwEncode::Auto || m_hw.mode == HwEncode::Qsv);
+    const std::pair<AVHWDeviceType, const char*> candidates[] = {
+        { AV_HWDEVICE_TYPE_VAAPI, "_vaapi" },
+        { AV_HWDEVICE_TYPE_QSV,   "_qsv" },
+    };
+    for (const auto& candidate : candidates) {
+        if ((candidate.first == AV_HWDEVICE_TYPE_VAAPI && !tryVaapi) ||
+            (candidate.first == AV_HWDEVICE_TYPE_QSV && !tryQsv)) {
+            continue;
+        }
+        const AVCodec* codec = avcodec_find_encoder_by_name((std::string(prefix) + candidate.second).c_str());
+        if (!codec) {
+            continue;
+        }
+        // The decoder's surfaces first, then surfaces of our own
+        if (hwInput && openHwEncoder(codec, candidate.first, hwInput)) {
+            return true;
+        }
+        closeEncoder();
+        if (openHwEncoder(codec, candidate.first, nullptr)) {
+            return true;
+        }
+        closeEncoder();
+    }
+    LOG_WARNING("Video Encoder: No usable VAAPI/QSV encoder, encoding in software.");
+    return false;
+}
+
+bool VideoEncoder::openHwEncoder(const AVCodec* codec, AVHWDeviceType type, const AVFrame* hwInput) {
+    const AVPixelFormat hwFormat = (type == AV_HWDEVICE_TYPE_VAAPI) ? AV_PIX_FMT_VAAPI : AV_PIX_FMT_QSV;
+    const bool direct = hwInput && hwInput->hw_frames_ctx && hwInput->format == hwFormat &&
+                        hwInput->width == m_width && hwInput->height == m_height;
+    if (hwInput && !direct) {
+        return false;
+    }
+
+    if (direct) {
+        // Same device and pool as the decoder: its surfaces go in without a copy.
+        // Surfaces the encoder holds on to come out of the decoder's extra frames;
+        // uploads get a pool of their own when they come up.
+        m_hwFrames = av_buffer_ref(hwInput->hw_frames_ctx);
+        const auto* frames = reinterpret_cast<const AVHWFramesContext*>(m_hwFrames->data);
+        m_hwDevice = av_buffer_ref(frames->device_ref);
+    } else {
+        const char* device = m_hw.device.empty() ? nullptr : m_hw.device.c_str();
+        int ret = av_hwdevice_ctx_create(&m_hwDevice, type, device, nullptr, 0);
+        if (ret < 0) {
+            char err[AV_ERROR_MAX_STRING_SIZE] = {0};
+            av_strerror(ret, err, sizeof(err));
+            LOG_WARNING("Video Encoder: Could not open " + std::string(av_hwdevice_get_type_name(type)) +
+                        " device " + (device ? device : "(default)") + ": " + err);
+            return false;
+        }
+        m_hwFrames = allocSurfaces(hwFormat, AV_PIX_FMT_NV12);
+        if (!m_hwFrames) {
+            LOG_WARNING("Video Encoder: Could not allocate " + std::string(av_hwdevice_get_type_name(type)) +
+                        " surfaces.");
+            return false;
+        }
+        m_uploadFrames = av_buffer_ref(m_hwFrames);
+    }
+
+    m_codecCtx = avcodec_alloc_context3(codec);
+    if (!m_codecCtx) {
+        return false;
+    }
+    m_codecCtx->width = m_width;
+    m_codecCtx->height = m_height;
+    m_codecCtx->time_base = (AVRational){1, m_fps};
+    m_codecCtx->framerate = (AVRational){m_fps, 1};
+    m_codecCtx->pix_fmt = hwFormat;
+    m_codecCtx->hw_frames_ctx = av_buffer_ref(m_hwFrames);
+    applyCodecConfig(codec);
+
     if (avcodec_open2(m_codecCtx, codec, nullptr) < 0) {
-        LOG_ERROR("Video Encoder: Failed to open encoder.");
+        LOG_WARNING("Video Encoder: Could not open " + std::string(codec->name) +
+                    (direct ? " on the decoder's surfaces." : "."));
         return false;
     }
 
+    m_swFormat = reinterpret_cast<const AVHWFramesContext*>(m_hwFrames->data)->sw_format;
+    m_hwFormat = hwFormat;
+    m_hwActive = true;
     m_initialized = true;
-    LOG_INFO("Video Encoder: Encoder initialized: " + m_codecName);
+    publishStreamInfo();
+    LOG_INFO("Video Encoder: Encoding with " + std::string(codec->name) + " on " + av_hwdevice_get_type_name(type) +
+             (direct ? ", straight from the decoder's surfaces." : ", uploading frames."));
     return true;
 }
 
+AVBufferRef* VideoEncoder::allocSurfaces(AVPixelFormat hwFormat, AVPixelFormat swFormat) {
+    AVBufferRef* ref = av_hwframe_ctx_alloc(m_hwDevice);
+    if (!ref) {
+        return nullptr;
+    }
+    auto* frames = reinterpret_cast<AVHWFramesContext*>(ref->data);
+    frames->format = hwFormat;
+    frames->sw_format = swFormat;
+    frames->width = m_width;
+    frames->height = m_height;
+    frames->initial_pool_size = 20; // QSV needs a fixed pool
+    if (av_hwframe_ctx_init(ref) < 0) {
+        av_buffer_unref(&ref);
+        return nullptr;
+    }
+    return ref;
+}
+
+AVFrame* VideoEncoder::hwInputFrame(DecodedFrame& df) {
+    // Zero-copy: the decoder's surface, as long as nothing replaced its pixels on the way
+    if (df.hwFrame && df.hwFrame->format == m_hwFormat && df.frame->data[0] == df.hwPixels &&
+        df.hwFrame->width == m_width && df.hwFrame->height == m_height && df.hwFrame->hw_frames_ctx) {
+        const auto* frames = reinterpret_cast<const AVHWFramesContext*>(df.hwFrame->hw_frames_ctx->data);
+        const auto* ours = reinterpret_cast<const AVHWFramesContext*>(m_hwFrames->data);
+        if (frames->device_ref->data == ours->device_ref->data) {
+            ++m_framesDirect;
+            return df.hwFrame;
+        }
+    }
+
+    // Otherwise to the surface format in system memory, then up once
+    if (!m_uploadFrames && !(m_uploadFrames = allocSurfaces(m_hwFormat, m_swFormat))) {
+        return nullptr;
+    }
+    AVFrame* sw = convertFrame(df.frame);
+    if (!sw) {
+        return nullptr;
+    }
+    AVFrame* hw = av_frame_alloc();
+    bool ok = hw && av_hwframe_get_buffer(m_uploadFrames, hw, 0) == 0 &&
+              av_hwframe_transfer_data(hw, sw, 0) == 0 && av_frame_copy_props(hw, sw) == 0;
+    if (sw != df.frame) {
+        m_scalePool->releaseFrame(sw);
+    }
+    if (!ok) {
+        av_frame_free(&hw);
+        return nullptr;
+    }
+    ++m_framesUploaded;
+    return hw;
+}
+
+void VideoEncoder::applyCodecConfig(const AVCodec* codec) {
+    CodecConfig cc = m_codec;
+    const CodecFamily family = codecFamily(codec);
+    const std::string name = codec->name;
+
+    if (m_streamInfo) {
+        // flv wants SPS/PPS as extradata for its sequence header, not in band
+        m_codecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (cc.tune == "zerolatency" && (cc.bFrames > 0 || cc.lookahead > 0)) {
+        // x264 would quietly drop them anyway; say so rather than pretend
+        LOG_WARNING("Video Encoder: zerolatency allows no B-frames or lookahead, turning them off.");
+        cc.bFrames = 0;
+        cc.lookahead = 0;
+    }
+
+    // No bitrate given: about 0.1 bit per pixel, 2.8 Mbit/s for 720p30
+    const int64_t bitrate = cc.bitrateKbps > 0 ? cc.bitrateKbps * 1000LL
+                                               : static_cast<int64_t>(m_width) * m_height * m_fps / 10;
+    const int64_t maxRate = cc.rateControl == RateControl::Cbr ? bitrate : cc.maxBitrateKbps * 1000LL;
+
+    m_codecCtx->gop_size = std::max(1, static_cast<int>(std::lround(cc.gopSeconds * m_fps)));
+    m_codecCtx->max_b_frames = cc.bFrames;
+    m_codecCtx->thread_count = cc.threads;
+    m_codecCtx->thread_type = cc.sliceThreads ? FF_THREAD_SLICE : FF_THREAD_FRAME;
+    if (cc.rateControl != RateControl::Crf) {
+        m_codecCtx->bit_rate = bitrate;
+    }
+    if (maxRate > 0) {
+        m_codecCtx->rc_max_rate = maxRate;
+        m_codecCtx->rc_buffer_size = static_cast<int>(cc.bufferKbits > 0 ? cc.bufferKbits * 1000LL : maxRate / 2);
+    }
+
+    auto setOption = [this, &name](const std::string& key, const std::string& value) {
+        if (av_opt_set(m_codecCtx->priv_data, key.c_str(), value.c_str(), 0) < 0) {
+            LOG_WARNING("Video Encoder: " + name + " does not take " + key + "=" + value + ".");
+            return false;
+        }
+        return true;
+    };
+
+    // x265 and SVT-AV1 take most of their settings as one "key=value:key=value" option
+    std::string params;
+    auto addParam = [&params](const std::string& param) {
+        params += (params.empty() ? "" : ":") + param;
+    };
+    std::string paramsKey;
+    switch (family) {
+    case CodecFamily::X264:
+        // Slice threads follow thread_type
+        if (!cc.preset.empty()) setOption("preset", cc.preset);
+        if (!cc.tune.empty()) setOption("tune", cc.tune);
+        if (cc.rateControl == RateControl::Crf) setOption("crf", std::to_string(cc.crf));
+        if (cc.rateControl == RateControl::Cbr) setOption("nal-hrd", "cbr");
+        if (cc.lookahead >= 0) setOption("rc-lookahead", std::to_string(cc.lookahead));
+        break;
+    case CodecFamily::X265:
+        paramsKey = "x265-params";
+        if (!cc.preset.empty()) setOption("preset", cc.preset);
+        if (!cc.tune.empty()) setOption("tune", cc.tune);
+        if (cc.rateControl == RateControl::Crf) setOption("crf", std::to_string(cc.crf));
+        if (cc.rateControl == RateControl::Cbr) addParam("strict-cbr=1");
+        addParam("bframes=" + std::to_string(cc.bFrames));
+        if (cc.lookahead >= 0) addParam("rc-lookahead=" + std::to_string(cc.lookahead));
+        // x265 has no slice threading; one frame thread is its low-latency equivalent
+        if (cc.sliceThreads) addParam("frame-threads=1");
+        if (cc.threads > 0) addParam("pools=" + std::to_string(cc.threads));
+        break;
+    case CodecFamily::SvtAv1:
+        paramsKey = "svtav1-params";
+        if (!cc.preset.empty()) setOption("preset", svtPreset(cc.preset));
+        if (cc.rateControl == RateControl::Crf) setOption("crf", std::to_string(cc.crf));
+        // Low-delay prediction structure is SVT-AV1's zerolatency
+        if (cc.tune == "zerolatency") addParam("pred-struct=1");
+        if (cc.lookahead >= 0) addParam("lookahead=" + std::to_string(cc.lookahead));
+        if (cc.threads > 0) addParam("lp=" + std::to_string(cc.threads));
+        break;
+    case CodecFamily::Other:
+        if (!cc.preset.empty()) av_opt_set(m_codecCtx->priv_data, "preset", cc.preset.c_str(), 0);
+        if (cc.rateControl == RateControl::Crf &&
+            av_opt_set(m_codecCtx->priv_data, "crf", std::to_string(cc.crf).c_str(), 0) < 0) {
+            LOG_INFO("Video Encoder: " + name + " has no crf, encoding at " +
+                     std::to_string(bitrate / 1000) + " kbit/s instead.");
+            m_codecCtx->bit_rate = bitrate;
+        }
+        break;
+    }
+
+    // The user's options last, so they win; theirs for the params key go after ours
+    for (const auto& option : cc.options) {
+        if (!paramsKey.empty() && option.first == paramsKey) {
+            addParam(option.second);
+        } else {
+            setOption(option.first, option.second);
+        }
+    }
+    if (!params.empty()) {
+        setOption(paramsKey, params);
+    }
+
+    static const char* const kRateControls[] = { "crf", "cbr", "vbr" };
+    LOG_INFO("Video Encoder: Profile " + cc.profile + ", " + kRateControls[static_cast<int>(cc.rateControl)] +
+             (cc.rateControl == RateControl::Crf ? " " + std::to_string(cc.crf)
+                                                  : " " + std::to_string(bitrate / 1000) + " kbit/s") +
+             (maxRate > 0 ? ", max " + std::to_string(maxRate / 1000) + " kbit/s" : "") +
+             ", gop " + std::to_string(m_codecCtx->gop_size) + ", " + std::to_string(cc.bFrames) + " B-frames, " +
+             (cc.sliceThreads ? "slice" : "frame") + " threads" +
+             (cc.preset.empty() ? "" : ", preset " + cc.preset) + (cc.tune.empty() ? "" : ", tune " + cc.tune) + ".");
+}
+
+void VideoEncoder::publishStreamInfo() {
+    if (!m_streamInfo) {
+        return;
+    }
+    AVCodecParameters* par = avcodec_parameters_alloc();
+    if (!par || avcodec_parameters_from_context(par, m_codecCtx) < 0) {
+        LOG_ERROR("Video Encoder: Could not read the encoder's stream parameters.");
+        avcodec_parameters_free(&par);
+        return;
+    }
+    // Packets come out in the codec's time base, the streamer rescales from there
+    m_streamInfo->publish(par, m_codecCtx->time_base);
+    avcodec_parameters_free(&par);
+}
+
 void VideoEncoder::closeEncoder() {
     if (m_codecCtx) {
         avcodec_free_context(&m_codecCtx);
         m_codecCtx = nullptr;
     }
+    av_buffer_unref(&m_uploadFrames);
+    av_buffer_unref(&m_hwFrames);
+    av_buffer_unref(&m_hwDevice);
+    m_hwFormat = AV_PIX_FMT_NONE;
+    m_hwActive = false;
     if (m_swsCtx) {
         sws_freeContext(m_swsCtx);
         m_swsCtx = nullptr;
@@ -87,10 +431,80 @@ void VideoEncoder::closeEncoder() {
     m_initialized = false;
 }
 
+AVFrame* VideoEncoder::convertFrame(AVFrame* src) {
+    const bool matches = (src->format == m_swFormat &&
+                          src->width == m_width && src->height == m_height);
+    if (src->format != m_srcFormat || src->width != m_srcWidth || src->height != m_srcHeight) {
+        const char* name = av_get_pix_fmt_name(static_cast<AVPixelFormat>(src->format));
+        const std::string from = std::to_string(src->width) + "x" + std::to_string(src->height) + " " +
+                                 (name ? name : "unknown");
+        if (matches) {
+            LOG_INFO("Video Encoder: Input is " + from + ", encoding it as is.");
+        } else {
+            LOG_INFO("Video Encoder: Converting " + from + " to " + std::to_string(m_width) + "x" +
+                     std::to_string(m_height) + " " + av_get_pix_fmt_name(m_swFormat) + ".");
+        }
+        m_srcFormat = src->format;
+        m_srcWidth  = src->width;
+        m_srcHeight = src->height;
+    }
+
+    // Fast path: no copy for cameras that already send what we encode
+    if (matches) {
+        ++m_framesPassed;
+        return src;
+    }
+
+    m_swsCtx = sws_getCachedContext(m_swsCtx,
+                                    src->width, src->height, static_cast<AVPixelFormat>(src->format),
+                                    m_width, m_height, m_swFormat,
+                                    SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!m_swsCtx) {
+        return nullptr;
+    }
+
+    AVFrame* dst = m_scalePool->acquireFrame();
+    dst->format = m_swFormat;
+    dst->width  = m_width;
+    dst->height = m_height;
+    if (!m_scalePool->allocBuffers(dst) && av_frame_get_buffer(dst, 0) < 0) {
+        m_scalePool->releaseFrame(dst);
+        return nullptr;
+    }
+    sws_scale(m_swsCtx, src->data, src->linesize, 0, src->height, dst->data, dst->linesize);
+
+    av_frame_copy_props(dst, src);
+    // yuvj* in, yuv* out: swscale converted to limited range on the way
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(src->format));
+    if (desc && std::strncmp(desc->name, "yuvj", 4) == 0) {
+        dst->color_range = AVCOL_RANGE_MPEG;
+    }
+    ++m_framesConverted;
+    return dst;
+}
+
+int64_t VideoEncoder::encoderPts(const DecodedFrame& df) {
+    if (df.pts == AV_NOPTS_VALUE || df.timeBase.num <= 0 || df.timeBase.den <= 0) {
+        // Nothing to go by: one frame interval on
+        m_lastPts = (m_lastPts == AV_NOPTS_VALUE) ? 0 : m_lastPts + 1;
+        return m_lastPts;
+    }
+    int64_t pts = av_rescale_q(df.pts, df.timeBase, m_codecCtx->time_base) + m_ptsOffset;
+    if (m_lastPts != AV_NOPTS_VALUE && pts <= m_lastPts) {
+        // Went backwards (a reconnect, a failover) or two inputs landed on one
+        // tick: carry on one interval after the last, at the new stream's pace
+        m_ptsOffset += m_lastPts + 1 - pts;
+        pts = m_lastPts + 1;
+    }
+    m_lastPts = pts;
+    return pts;
+}
+
 void VideoEncoder::start() {
     if (m_running.load()) return;
 
-    if (!m_initialized) {
+    // Hardware encode waits for the first frame, to see whether it can share the decoder's surfaces
+    if (!m_initialized && m_hw.mode == HwEncode::None) {
         if (!initEncoder()) {
             LOG_ERROR("Video Encoder: Could not init encoder.");
             return;
@@ -124,8 +538,9 @@ void VideoEncoder::stop() {
             }
             EncodedPacket ep;
             ep.packet = pkt;
-            while (!m_outQueue.push(std::move(ep))) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            // The streamer may already be gone, so don't wait forever on it
+            if (!m_outQueue.enqueue(std::move(ep), kQueueWait)) {
+                av_packet_free(&ep.packet);
             }
         }
     }
@@ -133,9 +548,8 @@ void VideoEncoder::stop() {
 
 void VideoEncoder::encodingLoop() {
     while (m_running.load()) {
-        auto maybeFrame = m_inQueue.pop();
+        auto maybeFrame = m_inQueue.popBlocking(kQueueWait);
         if (!maybeFrame.has_value()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
             continue;
         }
         DecodedFrame df = std::move(maybeFrame.value());
@@ -143,10 +557,35 @@ void VideoEncoder::encodingLoop() {
             continue;
         }
 
-        int ret = avcodec_send_frame(m_codecCtx, df.frame);
+        if (!m_initialized) {
+            const AVFrame* hwInput = (df.hwFrame && df.frame->data[0] == df.hwPixels) ? df.hwFrame : nullptr;
+            if (!initEncoder(hwInput)) {
+                LOG_ERROR("Video Encoder: Could not init encoder.");
+                releaseDecodedFrame(df);
+                break;
+            }
+        }
+
+        AVFrame* input = m_hwActive ? hwInputFrame(df) : convertFrame(df.frame);
+        if (!input) {
+            LOG_ERROR("Video Encoder: Could not convert the input frame.");
+            releaseDecodedFrame(df);
+            continue;
+        }
+        // Frames count in the input stream's time base, the encoder in 1/fps
+        input->pts = encoderPts(df);
+        // The encoder takes its own reference, a converted copy or upload can go right away
+        int ret = avcodec_send_frame(m_codecCtx, input);
+        if (input == df.frame || input == df.hwFrame) {
+            // df's own, released with it
+        } else if (m_hwActive) {
+            av_frame_free(&input);
+        } else {
+            m_scalePool->releaseFrame(input);
+        }
         if (ret < 0) {
             LOG_ERROR("Video Encoder: Error sending frame to encoder.");
-            av_frame_free(&df.frame);
+            releaseDecodedFrame(df);
             continue;
         }
 
@@ -164,16 +603,26 @@ void VideoEncoder::encodingLoop() {
 
             EncodedPacket ep;
             ep.packet = pkt;
-            while (!m_outQueue.push(std::move(ep))) {
+            while (!m_outQueue.enqueue(std::move(ep), kQueueWait)) {
+                if (!m_running.load() || m_outQueue.isShutdown()) {
+                    av_packet_free(&ep.packet);
+                    break;
+                }
                 LOG_WARNING("Video Encoder: Packet queue is full, waiting...");
-                
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
             }
             // Allocate a new packet for next iteration
             pkt = av_packet_alloc();
         }
 
-        av_frame_free(&df.frame);
+        releaseDecodedFrame(df);
+    }
+    if (m_framesConverted > 0) {
+        LOG_INFO("Video Encoder: Converted " + std::to_string(m_framesConverted) + " frames, passed " +
+                 std::to_string(m_framesPassed) + " through as is.");
+    }
+    if (m_hwActive) {
+        LOG_INFO("Video Encoder: " + std::to_string(m_framesDirect) + " decoder surfaces encoded in place, " +
+                 std::to_string(m_framesUploaded) + " frames uploaded.");
     }
     m_running.store(false);
 }
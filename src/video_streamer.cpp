@@ -2,20 +2,27 @@
 // Company: Arithaoptix pty Ltd.
 
 #include <video_streamer.hpp>
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
-VideoStreamer::VideoStreamer(BufferQueue<EncodedPacket, 128>& inQueue,
-                             const std::string& outputUrl)
+VideoStreamer::VideoStreamer(BufferQueue<EncodedPacket>& inQueue,
+                             const std::string& outputUrl,
+                             std::shared_ptr<StreamInfo> source)
     : m_inQueue(inQueue)
     , m_outputUrl(outputUrl)
+    , m_source(std::move(source))
 {
     avformat_network_init();
+    if (m_source) {
+        m_sourcePar = avcodec_parameters_alloc();
+    }
 }
 
 VideoStreamer::~VideoStreamer() {
     stop();
     closeOutput();
+    avcodec_parameters_free(&m_sourcePar);
 }
 
 bool VideoStreamer::initOutput() {
@@ -33,8 +40,12 @@ bool VideoStreamer::initOutput() {
         return false;
     }
 
-    // For real usage, copy encoder parameters to m_videoStream->codecpar
-    // so the container has the correct info. Simplified here.
+    if (m_source) {
+        // The camera's or the encoder's parameters, extradata included
+        avcodec_parameters_copy(m_videoStream->codecpar, m_sourcePar);
+        m_videoStream->codecpar->codec_tag = 0; // the input container's tag means nothing to flv
+        m_videoStream->time_base = m_sourceTimeBase;
+    }
 
     if (!(m_fmtCtx->oformat->flags & AVFMT_NOFILE)) {
         if (avio_open(&m_fmtCtx->pb, m_outputUrl.c_str(), AVIO_FLAG_WRITE) < 0) {
@@ -69,7 +80,8 @@ void VideoStreamer::closeOutput() {
 
 void VideoStreamer::start() {
     if (m_running.load()) return;
-    if (!m_initialized) {
+    // With a source the output opens from the streaming thread, once its parameters are known
+    if (!m_initialized && !m_source) {
         if (!initOutput()) {
             LOG_ERROR("Video Streamer: Could not init output. Aborting start.");
             return;
@@ -88,29 +100,115 @@ void VideoStreamer::stop() {
     }
 }
 
-void VideoStreamer::streamingLoop() {
-    while (m_running.load()) {
-        auto maybePkt = m_inQueue.pop();
-        if (!maybePkt.has_value()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            continue;
-        }
+bool VideoStreamer::syncWithSource() {
+    if (m_initialized && m_source->generation() == m_sourceGeneration) {
+        return true;
+    }
+    // Don't hammer an output that just refused us, packets are dropped meanwhile
+    const auto now = std::chrono::steady_clock::now();
+    if (!m_initialized && now - m_lastInitAttempt < std::chrono::seconds(1)) {
+        return false;
+    }
 
-        EncodedPacket ep = std::move(maybePkt.value());
-        AVPacket* pkt = ep.packet;
-        if (!pkt) {
-            continue;
+    if (m_initialized) {
+        // Capture reconnected or failed over. Mostly it's the same stream again:
+        // keep writing to the open output (reopening a file would truncate the
+        // recording) and only start over when the stream really changed.
+        AVCodecParameters* fresh = avcodec_parameters_alloc();
+        AVRational timeBase{0, 1};
+        uint64_t generation = 0;
+        if (!fresh || !m_source->get(fresh, timeBase, generation)) {
+            avcodec_parameters_free(&fresh);
+            return true;
+        }
+        const bool same = sameCodecParameters(m_sourcePar, fresh);
+        avcodec_parameters_free(&fresh);
+        if (same) {
+            m_sourceTimeBase = timeBase;
+            m_sourceGeneration = generation;
+            // New timestamps, and nothing to decode from before the next keyframe
+            m_discontinuity = true;
+            m_needKeyframe = true;
+            LOG_INFO("Video Streamer: Source restarted with the same stream, continuing " + m_outputUrl);
+            return true;
         }
+        LOG_INFO("Video Streamer: Source stream changed, reopening " + m_outputUrl);
+    }
+
+    // First packet, or the stream changed (resolution, profile...)
+    // For an encoder that only happens once, when it opens on the first frame
+    if (!m_source->get(m_sourcePar, m_sourceTimeBase, m_sourceGeneration)) {
+        return false;
+    }
+    m_lastInitAttempt = now;
+    if (!initOutput()) {
+        closeOutput();
+        return false;
+    }
+    // Whatever is in flight may depend on a keyframe the new output never saw
+    m_needKeyframe = true;
+    m_discontinuity = false;
+    m_tsOffset = 0;
+    m_lastDts = AV_NOPTS_VALUE;
+    m_lastDelta = 0;
+    return true;
+}
 
-        // Typically you'd set pkt->stream_index = m_videoStream->index
-        pkt->stream_index = m_videoStream->index;
+void VideoStreamer::keepMonotonic(AVPacket* pkt) {
+    if (pkt->dts == AV_NOPTS_VALUE) {
+        return;
+    }
+    const int64_t dts = pkt->dts + m_tsOffset;
+    if (m_lastDts != AV_NOPTS_VALUE && (m_discontinuity || dts < m_lastDts)) {
+        // Carry on one frame after the last packet written; the outage itself doesn't show
+        m_tsOffset += m_lastDts + std::max<int64_t>(m_lastDelta, 1) - dts;
+    }
+    m_discontinuity = false;
 
-        int ret = av_interleaved_write_frame(m_fmtCtx, pkt);
-        if (ret < 0) {
-            LOG_WARNING("Video Streamer: Error writing packet to " + m_outputUrl);
-        }
+    pkt->dts += m_tsOffset;
+    if (pkt->pts != AV_NOPTS_VALUE) {
+        pkt->pts += m_tsOffset;
+    }
+    if (m_lastDts != AV_NOPTS_VALUE && pkt->dts > m_lastDts) {
+        m_lastDelta = pkt->dts - m_lastDts;
+    }
+    m_lastDts = pkt->dts;
+}
 
-        av_packet_free(&pkt);
+void VideoStreamer::streamingLoop() {
+    // Drain whatever the encoder has queued in one go, a GOP burst costs a single wake-up
+    EncodedPacket batch[16];
+    while (m_running.load()) {
+        size_t count = m_inQueue.popBatchBlocking(batch, 16, kQueueWait);
+
+        for (size_t i = 0; i < count; ++i) {
+            AVPacket* pkt = batch[i].packet;
+            batch[i].packet = nullptr;
+            if (!pkt) {
+                continue;
+            }
+
+            if (m_source) {
+                if (!syncWithSource() || (m_needKeyframe && !(pkt->flags & AV_PKT_FLAG_KEY))) {
+                    av_packet_free(&pkt);
+                    continue;
+                }
+                m_needKeyframe = false;
+                // The muxer may have picked its own time base in write_header (flv: 1/1000)
+                av_packet_rescale_ts(pkt, m_sourceTimeBase, m_videoStream->time_base);
+                keepMonotonic(pkt);
+            }
+
+            // Typically you'd set pkt->stream_index = m_videoStream->index
+            pkt->stream_index = m_videoStream->index;
+
+            int ret = av_interleaved_write_frame(m_fmtCtx, pkt);
+            if (ret < 0) {
+                LOG_WARNING("Video Streamer: Error writing packet to " + m_outputUrl);
+            }
+
+            av_packet_free(&pkt);
+        }
     }
     m_running.store(false);
 }